@@ -36,12 +36,39 @@
 //
 // @@@@@@@@
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <opencv2/video/background_segm.hpp>
+#include <opencv2/imgproc.hpp>
 #include "pcg32.hpp"
+#include "vibeDistances.hpp"
+#include "SampleModel.hpp"
+#include "UpdateTables.hpp"
+#include "ThreadPool.hpp"
+#include "ModelSnapshot.hpp"
+#include "vibeMetrics.hpp"
+#include "CompactMask.hpp"
 
 /// ViBe foreground-background segmentation algorithm (abstract version)
 class BackgroundSubtractorViBe {
 public:
+    /// strategies available to draw the stochastic model update decisions
+    enum class UpdateMode {
+        /// draws every decision from the random stream, per pixel (original formulation)
+        Stochastic,
+        /// reads all decisions from precomputed random tables at a random offset per row (no RNG call or division per pixel)
+        RandomTables,
+        /// deterministic reference: the whole frame is classified against the previous model, then each pixel draws its own decisions
+        /// from a random stream derived from the seed, the frame & its position, and pulls its neighbor's value instead of pushing its
+        /// own; since every pixel only writes its own samples, the results are identical for the serial & parallel paths, any thread
+        /// count, tile width and kernel variant (used as the reference the optimized paths are compared to)
+        Reference,
+    };
+
     /// defines the default value for BackgroundSubtractorViBe::m_nColorDistThreshold
     static const size_t BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD{20};
     /// defines the default value for BackgroundSubtractorViBe::m_nBGSamples
@@ -50,42 +77,344 @@ public:
     static const size_t BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES{2};
     /// defines the default value for the learning rate passed to BackgroundSubtractorViBe::apply (the 'subsampling' factor in the original ViBe paper)
     static const size_t BGSVIBE_DEFAULT_LEARNING_RATE{10};
-    /// defines the internal threshold adjustment factor to use when determining if the variation of a single channel is enough to declare the pixel as foreground
-    #define BGSVIBE_SINGLECHANNEL_THRESHOLD_DIFF_FACTOR (1.60f)
     /// defines whether we should use single channel variation checks for fg/bg segmentation validation or not
     static const bool BGSVIBE_USE_SC_THRS_VALIDATION{0};
     /// defines whether we should use L1 distance or L2 distance for change detection
     static const bool BGSVIBE_USE_L1_DISTANCE_CHECK{0};
+    /// defines the default memory layout of the background sample model
+    static const SampleModel::Layout BGSVIBE_DEFAULT_MODEL_LAYOUT{SampleModel::Layout::Planar};
+    /// defines the default strategy used to draw the model update decisions
+    static const UpdateMode BGSVIBE_DEFAULT_UPDATE_MODE{UpdateMode::Stochastic};
+    /// defines the height (in rows) of the stripes processed by parallel tasks; results only depend on this value, not on the thread count
+    static constexpr int BGSVIBE_PARALLEL_STRIPE_HEIGHT{16};
+    /// tile width value requesting an automatic choice from the L2 cache size (see setTileWidth)
+    static constexpr int BGSVIBE_AUTO_TILE_WIDTH{-1};
 
     /// full constructor
     BackgroundSubtractorViBe(size_t nColorDistThreshold = BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD,
         size_t nBGSamples = BGSVIBE_DEFAULT_NB_BG_SAMPLES,
         size_t nRequiredBGSamples = BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES,
-        size_t learningRate = BGSVIBE_DEFAULT_LEARNING_RATE);
+        size_t learningRate = BGSVIBE_DEFAULT_LEARNING_RATE,
+        SampleModel::Layout eModelLayout = BGSVIBE_DEFAULT_MODEL_LAYOUT,
+        UpdateMode eUpdateMode = BGSVIBE_DEFAULT_UPDATE_MODE,
+        lv::SampleEncoding eSampleEncoding = lv::SampleEncoding::Raw);
     /// default destructor
     virtual ~BackgroundSubtractorViBe();
     /// (re)initiaization method; needs to be called before starting background subtraction
     virtual void initialize(const cv::Mat& oInitImg) = 0;
     /// primary model update function
     virtual void apply(const cv::Mat& image, cv::Mat& fgmask) = 0;
-    /// returns a copy of the latest reconstructed background image
+    /// (re)initialization method using the worker pool; creates a private pool of numProcesses threads if none was configured
+    virtual void initializeParallel(const cv::Mat& oInitImg, const int numProcesses) = 0;
+    /// model update function using the worker pool; processes stripes of the single shared model (no seams between them)
+    virtual void applyParallel(const cv::Mat& image, cv::Mat& fgmask) = 0;
+    /// primary model update function writing the compact formats requested in oMask.nFormats instead of a 0/255 mask (same results);
+    /// the optional filtering & blob labeling of oMask are fused with the classification pass
+    virtual void apply(const cv::Mat& image, CompactMask& oMask) = 0;
+    /// model update function using the worker pool and writing the compact formats requested in oMask.nFormats (same results)
+    virtual void applyParallel(const cv::Mat& image, CompactMask& oMask) = 0;
+    /// returns a copy of the latest background image (mean of the samples of each pixel, at full input resolution); O(pixels)
     void getBackgroundImage(cv::Mat& backgroundImage) const;
+    /// returns the background image maintained by the model (zero copy, model type & size); only valid until the next apply call
+    inline const cv::Mat& getBackgroundImageView() const {return m_oBGMeanImg;}
+    /// returns the storage format of the background samples (see vibeEncodings.hpp)
+    inline lv::SampleEncoding getSampleEncoding() const {return m_eSampleEncoding;}
+    /// returns the size of the sample buffer, in bytes (0 before initialization)
+    inline size_t getModelBytes() const {return m_oBGModel.totalBytes();}
+    /// sets the seed from which all random streams are derived (takes effect on the next (re)initialization)
+    void setRandomSeed(uint64_t nSeed);
+    /// sets the worker pool used by the parallel paths (may be shared between several subtractors)
+    void setThreadPool(std::shared_ptr<ThreadPool> pThreadPool);
+    /// creates a private worker pool with the given number of threads for the parallel paths (can be changed between frames)
+    void setNumThreads(size_t nThreads);
+    /// sets the downscaling factor of the model (1, 2 or 4); frames are area-averaged down before segmentation and the mask is
+    /// upsampled back to full size with nearest-neighbor replication (takes effect on the next (re)initialization)
+    void setProcessingScale(int nScale);
+    /// sets the first channel read from each element of the input frames (0 by default), so that a strided view can start on an element
+    /// boundary and still skip its leading channels (e.g. 1 for the luma of a packed UYVY view); the elements must hold at least that
+    /// many channels plus those of the model (can be changed between frames)
+    void setInputChannelOffset(size_t nChannelOffset);
+    /// sets a static full-resolution CV_8UC1 mask of the pixels to process (0 = excluded, empty = all); excluded pixels are neither
+    /// classified nor updated, stay at 0 in the output mask, and the model only stores the bounding box of the included ones
+    /// (takes effect on the next (re)initialization)
+    void setROIMask(const cv::Mat& oROIMask);
+    /// enables the tiled traversal of the model (0 = row by row over the whole width, the default): each stripe is processed in column
+    /// tiles of nTileWidth model pixels (or of a width chosen so that one tile's samples, sums, input & mask fit in half the L2 cache with
+    /// BGSVIBE_AUTO_TILE_WIDTH); this changes the pixel visiting order, hence the results, except with UpdateMode::Reference (takes effect
+    /// on the next (re)initialization)
+    void setTileWidth(int nTileWidth);
+    /// returns the tile width in use (0 if the traversal is not tiled)
+    inline int getTileWidth() const {return m_nTileWidth;}
+    /// enables change gating over square tiles of nTileSize model pixels (a divisor of BGSVIBE_PARALLEL_STRIPE_HEIGHT; 0 = disabled): a tile
+    /// that was fully background when last classified, and whose pixels all stayed within nMaxDiff (per channel) of their values at that
+    /// time, keeps its background mask and only receives the model update, for at most nMaxSkippedFrames consecutive frames (takes effect
+    /// on the next (re)initialization)
+    void setChangeGating(int nTileSize, size_t nMaxDiff, size_t nMaxSkippedFrames);
+    /// enables the adaptive sample ordering: each pixel's matching samples are moved to the front of its list as it is classified, so that
+    /// the samples which keep matching are tested first and the early exit comes sooner; the masks are unchanged for the same model, but
+    /// the classification goes through the scalar per-pixel path (best with the Interleaved layout), and since updates replace samples at
+    /// random indices, the reordering changes which samples get replaced (hence later results) but not the model statistics; the average
+    /// number of samples tested per pixel is reported by the metrics (can be changed between frames)
+    void setSampleReordering(bool bEnabled);
+    /// returns whether the adaptive sample ordering is enabled
+    inline bool getSampleReordering() const {return m_bReorderSamples;}
+    /// sets the color distance threshold ('R'); thread-safe, takes effect at the start of the next apply call (the model is kept)
+    void setColorDistThreshold(size_t nColorDistThreshold);
+    /// sets the number of matching samples needed to classify a pixel as background; thread-safe, takes effect at the start of the
+    /// next apply call (values above the sample count classify every pixel as foreground)
+    void setRequiredBGSamples(size_t nRequiredBGSamples);
+    /// sets the learning rate (> 0); thread-safe, takes effect at the start of the next apply call (with UpdateMode::RandomTables, the
+    /// update tables are then redrawn from the serial random stream)
+    void setLearningRate(size_t nLearningRate);
+    /// returns the color distance threshold, as last set (i.e. the value used from the next apply call on)
+    size_t getColorDistThreshold() const;
+    /// returns the required number of matching samples, as last set (i.e. the value used from the next apply call on)
+    size_t getRequiredBGSamples() const;
+    /// returns the learning rate, as last set (i.e. the value used from the next apply call on)
+    size_t getLearningRate() const;
+    /// returns the number of samples per pixel of the model
+    inline size_t getBGSamples() const {return m_nBGSamples;}
+    /// resamples the current model to a new input size and/or sample count instead of discarding it: each pixel takes the samples
+    /// of the nearest pixel of the previous model (at the same processing scale; an ROI mask that does not match the new size is
+    /// rescaled), keeping its first nBGSamples samples when shrinking, and drawing the extra ones from its own samples when growing;
+    /// the tiled traversal & change gating settings are applied as on (re)initialization (same threading contract as initialize)
+    void resizeModel(const cv::Size& oInputSize, size_t nBGSamples);
+    /// writes the current model (samples, geometry, parameters & random stream states) to a snapshot file; blocks until it is written
+    void saveModel(const std::string& sPath) const;
+    /// restores a model written by saveModel (or by the periodic snapshots) instead of (re)initializing from a frame; the sample buffer
+    /// is mapped from the file, so loading only costs the recomputation of the background image; the model type, layout, update mode &
+    /// sample encoding must match, while the sample count & tunable parameters are taken from the snapshot
+    void loadModel(const std::string& sPath);
+    /// enables periodic snapshots to the given file every nFrameInterval frames (0 = disabled); the model is copied nCopySteps slices
+    /// at a time over as many frames, then written by a background thread, so apply never waits on the disk
+    void setSnapshotPolicy(const std::string& sPath, size_t nFrameInterval, size_t nCopySteps = 8);
+    /// returns a copy of the metrics accumulated since the last reset (thread-safe; all zero unless built with BGSVIBE_ENABLE_METRICS)
+    ViBeMetrics getMetrics() const;
+    /// clears the accumulated metrics
+    void resetMetrics();
+    /// sets a function receiving the accumulated metrics every nFrameInterval frames (0 = never), called at the end of apply
+    void setMetricsCallback(std::function<void(const ViBeMetrics&)> lCallback, size_t nFrameInterval);
 
 protected:
     /// number of different samples per pixel/block to be taken from input frames to build the background model ('N' in the original ViBe paper)
-    const size_t m_nBGSamples;
+    size_t m_nBGSamples;
     /// number of similar samples needed to consider the current pixel/block as 'background' ('#_min' in the original ViBe paper)
-    const size_t m_nRequiredBGSamples;
-    /// background model pixel intensity samples
-    std::vector<cv::Mat> m_voBGImg;
-    /// input image size
+    size_t m_nRequiredBGSamples;
+    /// background model pixel intensity samples (single contiguous buffer)
+    SampleModel m_oBGModel;
+    /// storage format of the samples (the sums & background image always hold decoded pixel values)
+    const lv::SampleEncoding m_eSampleEncoding;
+    /// per-pixel & per-channel sums of the model samples (CV_32S), updated on every sample replacement
+    cv::Mat m_oSampleSums;
+    /// per-pixel rounded mean of the model samples (model type), updated along with the sums
+    cv::Mat m_oBGMeanImg;
+    /// model size (i.e. the size of the region of the frames that is actually processed, after downscaling & cropping)
     cv::Size m_oImgSize;
+    /// full-resolution input image size
+    cv::Size m_oInputSize;
+    /// model downscaling factor
+    int m_nProcessingScale;
+    /// first channel read from each element of the input frames
+    size_t m_nInputChannelOffset;
+    /// full-resolution mask of the pixels to process (empty = all)
+    cv::Mat m_oROIMask;
+    /// bounding box of the processed pixels in the downscaled frames (the model covers this region only)
+    cv::Rect m_oModelROI;
+    /// included column ranges of each model row (concatenated); empty if no ROI mask is used
+    std::vector<cv::Range> m_voRowSpans;
+    /// index of the first span of each model row in m_voRowSpans (plus a final end index)
+    std::vector<size_t> m_vnRowSpanOffsets;
+    /// downscaled frame & mask buffers (only used when m_nProcessingScale > 1)
+    cv::Mat m_oScaledInput, m_oScaledFGMask;
     /// absolute color distance threshold ('R' or 'radius' in the original ViBe paper)
-    const size_t m_nColorDistThreshold;
+    size_t m_nColorDistThreshold;
     /// should be > 0 (smaller values == faster adaptation)
-    const size_t m_learningRate;
+    size_t m_learningRate;
+    /// runtime-tunable parameters as last set, guarded by m_oParamsMutex; copied to the members above by latchParams when m_bParamsPending is set
+    struct TunableParams {
+        size_t nColorDistThreshold;
+        size_t nRequiredBGSamples;
+        size_t nLearningRate;
+    };
+    TunableParams m_oParams;
+    std::atomic<bool> m_bParamsPending;
+    mutable std::mutex m_oParamsMutex;
     /// defines whether or not the subtractor is fully initialized
     bool m_bInitialized;
+    /// seed from which all random streams are derived
+    uint64_t m_nRandomSeed;
+    /// random stream used by the serial (non-parallel) paths
+    Pcg32 m_oRNG;
+    /// strategy used to draw the model update decisions
+    const UpdateMode m_eUpdateMode;
+    /// precomputed update decisions (only used with UpdateMode::RandomTables)
+    UpdateTables m_oUpdateTables;
+    /// classification of the whole model region, kept until the update pass (only used with UpdateMode::Reference)
+    cv::Mat m_oReferenceMask;
+    /// worker pool used by the parallel paths (null if none was configured)
+    std::shared_ptr<ThreadPool> m_pThreadPool;
+    /// horizontal stripes of BGSVIBE_PARALLEL_STRIPE_HEIGHT rows covering the image, used as parallel work units
+    std::vector<cv::Rect> m_voStripes;
+    /// one random stream per stripe, so that parallel runs are race-free & reproducible for any thread count
+    std::vector<Pcg32> m_voRNGParallel;
+    /// periodic snapshot file & interval (in frames; 0 = disabled)
+    std::string m_sSnapshotPath;
+    size_t m_nSnapshotInterval;
+    /// number of slices in which the model is copied to the staging snapshot
+    size_t m_nSnapshotCopySteps;
+    /// frames processed since the last snapshot was started, and number of model slices already copied for the next one
+    size_t m_nFramesSinceSnapshot, m_nSnapshotCopiedSlices;
+    /// staging snapshot, owned by the writer thread while m_bSnapshotWriting is set
+    ModelSnapshot m_oSnapshotStaging;
+    std::thread m_oSnapshotWriter;
+    std::atomic<bool> m_bSnapshotWriting;
+    /// error raised by the last snapshot writer (rethrown by the next apply call)
+    std::exception_ptr m_pSnapshotException;
+    /// per-frame metrics of each stripe, plus a last entry for the serial path (only filled with BGSVIBE_ENABLE_METRICS)
+    std::vector<ViBeStripeMetrics> m_voStripeMetrics;
+    /// accumulated metrics & periodic dump settings, guarded by m_oMetricsMutex
+    ViBeMetrics m_oMetrics;
+    std::function<void(const ViBeMetrics&)> m_lMetricsCallback;
+    size_t m_nMetricsInterval;
+    mutable std::mutex m_oMetricsMutex;
+    /// row buffers used to produce compact masks, one per stripe plus a last one for the serial path
+    struct CompactScratch {
+        /// classified rows at processing resolution (pixels outside the model region stay at 0); model row y is stored in row y%nRows,
+        /// so that all rows of a stripe stay available until committed in the tiled traversal
+        std::vector<uchar> vnRow;
+        int nRows{1};
+        /// packed row (only used when the packed mask itself is not requested)
+        std::vector<uint64_t> vnWords;
+        /// runs found in the rows of the stripe, in row order
+        std::vector<cv::Range> voRuns;
+
+        /// returns the classified row of model row y (at frame column 0)
+        inline uchar* row(int y) {return vnRow.data() + (vnRow.size() / nRows) * (size_t)(y % nRows);}
+    };
+    std::vector<CompactScratch> m_voCompactScratch;
+    /// number of runs of each row of the compact mask being produced
+    std::vector<size_t> m_vnCompactRowRunCounts;
+    /// packed rows before filtering, plus a final zero row (only used when the compact mask is filtered)
+    std::vector<uint64_t> m_vnCompactRawBits;
+    /// requested & effective tile widths of the tiled traversal (0 = row by row)
+    int m_nRequestedTileWidth, m_nTileWidth;
+    /// change gating tile size (0 = disabled), per-channel difference bound & maximum number of consecutive skipped frames
+    int m_nGatingTileSize;
+    size_t m_nGatingMaxDiff, m_nGatingMaxSkippedFrames;
+    /// model region pixels as they were when each tile was last classified (model type)
+    cv::Mat m_oGatingRefImg;
+    /// per-tile gating state in row-major order: whether the tile is skipped in the current frame, whether it held foreground when last
+    /// classified, and its number of consecutive skipped frames (only written by the task processing the stripe that holds the tile)
+    int m_nGatingTilesX;
+    std::vector<uint8_t> m_vnTileGated, m_vnTileForeground;
+    std::vector<uint32_t> m_vnTileSkippedFrames;
+    /// defines whether matching samples are moved to the front of their pixel's list when classified
+    bool m_bReorderSamples;
+
+    /// fills the model samples of all pixels inside the given region by drawing from their 7x7 neighborhood (clamped to the image), along
+    /// with their sample sums & mean
+    void initializeModel(const cv::Mat& oInitImg, const cv::Rect& oROI, Pcg32& oRNG);
+    /// typed implementation of initializeModel; positions are read from the direct-map sampling table, each model row is gathered in a
+    /// contiguous buffer (from which the sums are accumulated) and then written once, with streaming stores for large planar models
+    template<size_t nChannels, typename TSample, typename TEncoding>
+    void initializeModelRegion(const cv::Mat& oInitImg, const cv::Rect& oROI, Pcg32& oRNG);
+    /// allocates the model (for pixels of the given type) for the given frame, seeds all random streams, splits the image into stripes and fills
+    /// the model (stripe by stripe using the worker pool if one is configured, or in a single pass otherwise)
+    void initializeCommon(const cv::Mat& oInitImg, int nModelType);
+    /// computes the model region, row spans & stripes for the given input size, and allocates the sample sums & background image
+    void initializeGeometry(const cv::Size& oInputSize, int nModelType);
+    /// copies the parameters set since the last frame (if any) to the members used by the frame; called by the thread running apply before
+    /// the stripes are dispatched, so that all of them use the same values
+    void latchParams();
+    /// returns the opencv type of the model's pixels (i.e. of the decoded samples)
+    virtual int getModelType() const = 0;
+    /// fills the parameters, geometry & random stream states of a snapshot (not the samples)
+    void fillSnapshot(ModelSnapshot& oSnapshot) const;
+    /// advances the periodic snapshot policy by one frame (copies one model slice, or hands a complete snapshot to the writer)
+    void updateSnapshot();
+    /// merges the stripe metrics of the frame that started at nFrameStartNs into the accumulated metrics (no-op if compiled out)
+    inline void collectFrameMetrics(uint64_t nFrameStartNs, bool bParallel) {
+        if constexpr (ViBeMetrics::s_bEnabled)
+            accumulateFrameMetrics(nFrameStartNs, bParallel);
+    }
+    /// implementation of collectFrameMetrics
+    void accumulateFrameMetrics(uint64_t nFrameStartNs, bool bParallel);
+    /// recomputes the sample sums & mean of all pixels inside the given region from the model
+    void initializeSums(const cv::Rect& oROI);
+    /// replaces a model sample by the given pixel, and updates the sample sums & mean of that pixel accordingly
+    template<size_t nChannels, typename TSample, typename TEncoding>
+    inline void replaceSample(size_t nSampleIdx, int y, int x, const uchar* pInput) {
+        int32_t* const pSums = m_oSampleSums.ptr<int32_t>(y) + x * nChannels;
+        TSample* const pMean = m_oBGMeanImg.ptr<TSample>(y) + x * nChannels;
+        if constexpr (TEncoding::s_bRaw) {
+            TSample* const pSample = (TSample*)m_oBGModel.ptr(nSampleIdx, y, x);
+            const TSample* const pNewSample = (const TSample*)pInput;
+            for (size_t c = 0; c < nChannels; ++c) {
+                pSums[c] += int32_t(pNewSample[c]) - int32_t(pSample[c]);
+                pSample[c] = pNewSample[c];
+                pMean[c] = (TSample)((pSums[c] + m_nBGSamples / 2) / m_nBGSamples);
+            }
+        }
+        else {
+            // the sums track the decoded samples, which differ from the input pixels by the quantization error
+            typename TEncoding::TCode* const pCode = (typename TEncoding::TCode*)m_oBGModel.ptr(nSampleIdx, y, x);
+            TSample anOldSample[nChannels], anNewSample[nChannels];
+            TEncoding::decode(*pCode, anOldSample);
+            *pCode = TEncoding::encode((const TSample*)pInput);
+            TEncoding::decode(*pCode, anNewSample);
+            for (size_t c = 0; c < nChannels; ++c) {
+                pSums[c] += int32_t(anNewSample[c]) - int32_t(anOldSample[c]);
+                pMean[c] = (TSample)((pSums[c] + m_nBGSamples / 2) / m_nBGSamples);
+            }
+        }
+    }
+    /// returns the size of the frames after downscaling
+    cv::Size getScaledSize() const;
+    /// returns the region of the frame that maps onto the model (downscaled if needed, then cropped; no copy when neither applies)
+    cv::Mat prepareInput(const cv::Mat& oImage);
+    /// returns row y of a prepared input, starting at the first channel read from its first element
+    inline const uchar* getInputRow(const cv::Mat& oInput, int y) const {return oInput.ptr(y) + m_nInputChannelOffset * oInput.elemSize1();}
+    /// (re)allocates the full-resolution output mask and returns the region of it (or of the downscaled buffer) that maps onto the model
+    cv::Mat prepareFGMask(cv::Mat& oFGMask);
+    /// upsamples the downscaled mask to the full-resolution output (no-op at full scale)
+    void finalizeFGMask(cv::Mat& oFGMask);
+    /// decides which tiles of the band of model rows [nBandY,nBandEnd) are skipped in the current frame
+    template<size_t nChannels, typename TSample>
+    void beginGatingBand(const cv::Mat& oInput, int nBandY, int nBandEnd);
+    /// flags the tiles of the band of model row y that hold foreground pixels in the given mask row (which starts at the model's first column)
+    void accumulateGatingRow(const uchar* pFGMaskRow, int y);
+    /// stores the pixels of the classified tiles of the band of model rows [nBandY,nBandEnd) as their new references
+    template<size_t nChannels, typename TSample>
+    void endGatingBand(const cv::Mat& oInput, int nBandY, int nBandEnd);
+    /// sizes & clears the outputs of a compact mask, along with the scratch rows used to produce it
+    void prepareCompactMask(CompactMask& oMask);
+    /// encodes the classified scratch row of the given stripe (model row y) into the packed mask and/or the stripe's runs; with a
+    /// filter, the row is packed & the previous one filtered while still in cache
+    void encodeCompactRow(CompactMask& oMask, size_t nScratchIdx, int y);
+    /// filters model row y of the packed mask from the unfiltered rows
+    void filterCompactRow(CompactMask& oMask, int y);
+    /// filters the stripe border rows (parallel path only), gathers the runs of all stripes, then computes the tile counts & blobs
+    void finalizeCompactMask(CompactMask& oMask, bool bParallel);
+    /// runs lStripeFunc(stripe index) over all stripes in two phases (even stripes, then odd ones); since stripes are at least two rows
+    /// high, stripes running concurrently never touch the same model rows, even with neighbor propagation across their borders
+    void forEachStripe(const std::function<void(size_t)>& lStripeFunc);
+    /// runs the model update pass over one classified row of the given region (y is an image row, the row pointers start at the region's
+    /// first column, and input pixels are nInputPixelStride bytes apart); when a neighbor update lands on the next pixel of the same row,
+    /// that pixel is re-classified on the fly via lReclassify(x)
+    template<size_t nChannels, typename TSample, typename TEncoding, typename TReclassifyFunc>
+    void updateRow(const uchar* pInputRow, size_t nInputPixelStride, uchar* pFGMaskRow, int y, const cv::Rect& oROI, Pcg32& oRNG,
+        ViBeStripeMetrics& oMetrics, TReclassifyFunc&& lReclassify);
+    /// returns the key from which the per-pixel random streams of the next frame are derived (UpdateMode::Reference); drawn from the
+    /// serial random stream by the thread running apply, so it is saved along with the snapshots
+    inline uint64_t nextReferenceFrameKey() {
+        const uint64_t nHigh = m_oRNG();
+        return (nHigh << 32) | m_oRNG();
+    }
+    /// runs the update pass of UpdateMode::Reference over the model rows of the given region, from the classification stored in
+    /// m_oReferenceMask (which must cover the rows around it); each row's mask is then copied to lMaskRow(y) & handed to lCommitRow(y)
+    template<size_t nChannels, typename TSample, typename TEncoding, typename TMaskRowFunc, typename TCommitRowFunc>
+    void updateReference(const cv::Mat& oInput, const cv::Rect& oROI, uint64_t nFrameKey, ViBeStripeMetrics& oMetrics,
+        TMaskRowFunc&& lMaskRow, TCommitRowFunc&& lCommitRow);
 
     // Second version, not doing square root
     static inline size_t L2dist3Squared(const cv::Vec<uchar, 3>& a, const cv::Vec<uchar, 3>& b) {
@@ -96,14 +425,14 @@ protected:
     }
 
     	/// returns the neighbor location for the specified random index & original pixel location; also guards against out-of-bounds values via image/border size check
-	static inline void getNeighborPosition_3x3(int& nNeighborCoord_X, int& nNeighborCoord_Y, const int nOrigCoord_X, const int nOrigCoord_Y, const cv::Size& oImageSize) {
+	static inline void getNeighborPosition_3x3(const uint32_t nRandIdx, int& nNeighborCoord_X, int& nNeighborCoord_Y, const int nOrigCoord_X, const int nOrigCoord_Y, const cv::Size& oImageSize) {
 		typedef std::array<int, 2> Nb;
 		static const std::array<std::array<int, 2>, 8> s_anNeighborPattern = {
 				Nb{-1, 1},Nb{0, 1},Nb{1, 1},
 				Nb{-1, 0},         Nb{1, 0},
 				Nb{-1,-1},Nb{0,-1},Nb{1,-1},
 		};
-		const uint32_t r{Pcg32::fast() % 8};
+		const uint32_t r{nRandIdx % 8};
 		nNeighborCoord_X = nOrigCoord_X + s_anNeighborPattern[r][0];
 		nNeighborCoord_Y = nOrigCoord_Y + s_anNeighborPattern[r][1];
 
@@ -118,50 +447,479 @@ protected:
 	}
 };
 
-/// ViBe foreground-background segmentation algorithm (1ch/grayscale version)
-class BackgroundSubtractorViBe_1ch : public BackgroundSubtractorViBe {
+/// ViBe foreground-background segmentation algorithm (header-only engine); the channel count (1-4), sample type (8/16-bit), distance
+/// policy (see vibeDistances.hpp) and sample encoding (see vibeEncodings.hpp) are all resolved at compile time, so the per-pixel loops
+/// hold no virtual call or '.at<>'
+template<size_t nChannels, typename TSample, typename TDistance, typename TEncoding = lv::RawEncoding>
+class BackgroundSubtractorViBeEngine : public BackgroundSubtractorViBe {
+    static_assert(nChannels >= 1 && nChannels <= 4, "ViBe engine only supports 1 to 4 channels");
+    static_assert(std::is_same_v<TSample, uint8_t> || std::is_same_v<TSample, uint16_t>, "ViBe engine only supports 8 or 16-bit samples");
+    static_assert(TEncoding::s_bRaw || (nChannels == 3 && std::is_same_v<TSample, uint8_t>), "compressed sample encodings only support 8-bit 3ch pixels");
 public:
+    /// opencv type of the model's pixels (and of contiguous input frames)
+    static constexpr int s_nSampleType = CV_MAKETYPE(cv::DataType<TSample>::depth, (int)nChannels);
+
+    /// returns whether frames of the given type can be processed; besides s_nSampleType, strided views whose elements hold a multiple of
+    /// nChannels channels are accepted (only the first nChannels channels of each element are used, e.g. the luma of a packed YUYV view)
+    static bool isSupportedInput(const cv::Mat& oImage) {
+        return oImage.depth() == cv::DataType<TSample>::depth && (oImage.channels() % (int)nChannels) == 0;
+    }
+
     /// full constructor
-    BackgroundSubtractorViBe_1ch(size_t nColorDistThreshold = BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD,
+    BackgroundSubtractorViBeEngine(size_t nColorDistThreshold = BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD,
         size_t nBGSamples = BGSVIBE_DEFAULT_NB_BG_SAMPLES,
         size_t nRequiredBGSamples = BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES,
-        size_t learningRate = BGSVIBE_DEFAULT_LEARNING_RATE);
-    /// default destructor
-    virtual ~BackgroundSubtractorViBe_1ch();
+        size_t learningRate = BGSVIBE_DEFAULT_LEARNING_RATE,
+        SampleModel::Layout eModelLayout = BGSVIBE_DEFAULT_MODEL_LAYOUT,
+        UpdateMode eUpdateMode = BGSVIBE_DEFAULT_UPDATE_MODE) :
+        BackgroundSubtractorViBe(nColorDistThreshold, nBGSamples, nRequiredBGSamples, learningRate, eModelLayout, eUpdateMode, TEncoding::s_eEncoding),
+        m_oDistParams(TDistance::makeParams(nColorDistThreshold, nChannels)),
+        m_nDistParamsThreshold(nColorDistThreshold) {}
     /// (re)initiaization method; needs to be called before starting background subtraction
-    virtual void initialize(const cv::Mat& oInitImg);
-    /// primary model update function; the learning param is reinterpreted as an integer and should be > 0 (smaller values == faster adaptation)
-    virtual void apply(const cv::Mat& image, cv::Mat& fgmask);
+    virtual void initialize(const cv::Mat& oInitImg) override {
+        CV_Assert(isSupportedInput(oInitImg));
+        initializeCommon(oInitImg, s_nSampleType);
+        m_bInitialized = true;
+    }
+    /// primary model update function; processes the whole frame in raster order with the serial random stream
+    virtual void apply(const cv::Mat& image, cv::Mat& fgmask) override {
+        const uint64_t nFrameStartNs = lv::metricsNow();
+        beginFrame();
+        const cv::Mat oInput = prepareInput(image);
+        cv::Mat oFGMask = prepareFGMask(fgmask);
+        const cv::Rect oRegion(0, 0, m_oImgSize.width, m_oImgSize.height);
+        if (m_eUpdateMode == UpdateMode::Reference) {
+            const uint64_t nFrameKey = nextReferenceFrameKey();
+            classifyReference(oInput, oRegion, m_oRNG, m_voStripeMetrics.back());
+            updateReference<nChannels, TSample, TEncoding>(oInput, oRegion, nFrameKey, m_voStripeMetrics.back(),
+                [&](int y) {return oFGMask.ptr<uchar>(y);}, [](int) {});
+        }
+        else
+            applyCmp(oInput, oRegion, m_oRNG, m_voStripeMetrics.back(), [&](int y) {return oFGMask.ptr<uchar>(y);}, [](int) {});
+        finalizeFGMask(fgmask);
+        collectFrameMetrics(nFrameStartNs, false);
+        updateSnapshot();
+    }
+    /// (re)initialization method using the worker pool; creates a private pool of numProcesses threads if none was configured
+    virtual void initializeParallel(const cv::Mat& oInitImg, const int numProcesses) override {
+        CV_Assert(isSupportedInput(oInitImg) && numProcesses > 0);
+        if (!m_pThreadPool)
+            setNumThreads((size_t)numProcesses);
+        initializeCommon(oInitImg, s_nSampleType);
+        m_bInitialized = true;
+    }
+    /// model update function using the worker pool; processes stripes of the single shared model (no seams between them)
+    virtual void applyParallel(const cv::Mat& image, cv::Mat& fgmask) override {
+        const uint64_t nFrameStartNs = lv::metricsNow();
+        beginFrame();
+        const cv::Mat oInput = prepareInput(image);
+        cv::Mat oFGMask = prepareFGMask(fgmask);
+        if (m_eUpdateMode == UpdateMode::Reference) {
+            // all stripes are classified before any is updated, as the serial path does for the whole frame
+            const uint64_t nFrameKey = nextReferenceFrameKey();
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                classifyReference(oInput, m_voStripes[i], m_voRNGParallel[i], m_voStripeMetrics[i]);
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                updateReference<nChannels, TSample, TEncoding>(oInput, m_voStripes[i], nFrameKey, m_voStripeMetrics[i],
+                    [&](int y) {return oFGMask.ptr<uchar>(y);}, [](int) {});
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+        }
+        else
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                applyCmp(oInput, m_voStripes[i], m_voRNGParallel[i], m_voStripeMetrics[i],
+                    [&](int y) {return oFGMask.ptr<uchar>(y);}, [](int) {});
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+        finalizeFGMask(fgmask);
+        collectFrameMetrics(nFrameStartNs, true);
+        updateSnapshot();
+    }
+    /// primary model update function writing compact mask formats; uses the same random stream as apply(image, fgmask)
+    virtual void apply(const cv::Mat& image, CompactMask& oMask) override {
+        const uint64_t nFrameStartNs = lv::metricsNow();
+        beginFrame();
+        const cv::Mat oInput = prepareInput(image);
+        prepareCompactMask(oMask);
+        const size_t nScratchIdx = m_voStripes.size();
+        CompactScratch& oScratch = m_voCompactScratch[nScratchIdx];
+        const cv::Rect oRegion(0, 0, m_oImgSize.width, m_oImgSize.height);
+        if (m_eUpdateMode == UpdateMode::Reference) {
+            const uint64_t nFrameKey = nextReferenceFrameKey();
+            classifyReference(oInput, oRegion, m_oRNG, m_voStripeMetrics.back());
+            updateReference<nChannels, TSample, TEncoding>(oInput, oRegion, nFrameKey, m_voStripeMetrics.back(),
+                [&](int y) {return oScratch.row(y) + m_oModelROI.x;}, [&](int y) {encodeCompactRow(oMask, nScratchIdx, y);});
+        }
+        else
+            applyCmp(oInput, oRegion, m_oRNG, m_voStripeMetrics.back(),
+                [&](int y) {return oScratch.row(y) + m_oModelROI.x;}, [&](int y) {encodeCompactRow(oMask, nScratchIdx, y);});
+        finalizeCompactMask(oMask, false);
+        collectFrameMetrics(nFrameStartNs, false);
+        updateSnapshot();
+    }
+    /// model update function using the worker pool and writing compact mask formats; uses the same random streams as applyParallel(image, fgmask)
+    virtual void applyParallel(const cv::Mat& image, CompactMask& oMask) override {
+        const uint64_t nFrameStartNs = lv::metricsNow();
+        beginFrame();
+        const cv::Mat oInput = prepareInput(image);
+        prepareCompactMask(oMask);
+        if (m_eUpdateMode == UpdateMode::Reference) {
+            const uint64_t nFrameKey = nextReferenceFrameKey();
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                classifyReference(oInput, m_voStripes[i], m_voRNGParallel[i], m_voStripeMetrics[i]);
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                CompactScratch& oScratch = m_voCompactScratch[i];
+                updateReference<nChannels, TSample, TEncoding>(oInput, m_voStripes[i], nFrameKey, m_voStripeMetrics[i],
+                    [&](int y) {return oScratch.row(y) + m_oModelROI.x;}, [&](int y) {encodeCompactRow(oMask, i, y);});
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+        }
+        else
+            forEachStripe([&](size_t i) {
+                const uint64_t nStripeStartNs = lv::metricsNow();
+                CompactScratch& oScratch = m_voCompactScratch[i];
+                applyCmp(oInput, m_voStripes[i], m_voRNGParallel[i], m_voStripeMetrics[i],
+                    [&](int y) {return oScratch.row(y) + m_oModelROI.x;}, [&](int y) {encodeCompactRow(oMask, i, y);});
+                m_voStripeMetrics[i].addTime(ViBeStripeMetrics::Phase::Stripe, nStripeStartNs);
+            });
+        finalizeCompactMask(oMask, true);
+        collectFrameMetrics(nFrameStartNs, true);
+        updateSnapshot();
+    }
+
+protected:
+    /// thresholds derived from the color distance threshold by the distance policy
+    typename TDistance::Params m_oDistParams;
+    /// color distance threshold from which m_oDistParams was derived
+    size_t m_nDistParamsThreshold;
+
+    /// returns the opencv type of the model's pixels (i.e. of the decoded samples)
+    virtual int getModelType() const override {
+        return s_nSampleType;
+    }
+
+    /// applies the parameters set since the last frame, and rederives the distance thresholds if needed
+    inline void beginFrame() {
+        latchParams();
+        if (m_nDistParamsThreshold != m_nColorDistThreshold) {
+            m_oDistParams = TDistance::makeParams(m_nColorDistThreshold, nChannels);
+            m_nDistParamsThreshold = m_nColorDistThreshold;
+        }
+    }
+
+    /// classifies the pixels inside the given region into m_oReferenceMask without updating the model (first pass of UpdateMode::Reference)
+    void classifyReference(const cv::Mat& image, const cv::Rect& roi, Pcg32& rng, ViBeStripeMetrics& metrics) {
+        applyCmp(image, roi, rng, metrics, [&](int y) {return m_oReferenceMask.ptr<uchar>(y);}, [](int) {});
+    }
+
+    /// classifies & updates the pixels inside the given region of the shared model; neighbor propagation may cross the region's borders;
+    /// the mask of model row y is written at lMaskRow(y) (which points at the row's first model column), then handed to lCommitRow(y)
+    /// once final (neighbor updates never re-classify pixels of another row)
+    template<typename TMaskRowFunc, typename TCommitRowFunc>
+    void applyCmp(const cv::Mat& image, const cv::Rect& roi, Pcg32& rng, ViBeStripeMetrics& metrics, TMaskRowFunc&& lMaskRow, TCommitRowFunc&& lCommitRow) {
+        const int nRegionEnd = roi.y + roi.height;
+        if (m_nTileWidth == 0) {
+            int nBandY = roi.y, nBandEnd = roi.y;
+            for (int y = roi.y; y < nRegionEnd; ++y) {
+                if (m_nGatingTileSize > 0 && y == nBandEnd) {
+                    // stripes start on tile boundaries, so each band of tile rows is processed by a single task
+                    nBandY = y;
+                    nBandEnd = std::min(y + m_nGatingTileSize, nRegionEnd);
+                    beginGatingBand<nChannels, TSample>(image, y, nBandEnd);
+                }
+                uchar* const pFGMaskRow = lMaskRow(y);
+                applyRowRange(image, y, roi.x, roi.x + roi.width, pFGMaskRow, rng, metrics);
+                if (m_nGatingTileSize > 0) {
+                    accumulateGatingRow(pFGMaskRow, y);
+                    if (y + 1 == nBandEnd)
+                        endGatingBand<nChannels, TSample>(image, nBandY, nBandEnd);
+                }
+                lCommitRow(y);
+            }
+            return;
+        }
+        // tiled traversal: blocks of rows matching the stripes (so the serial path visits pixels in the same order as the parallel one),
+        // each processed one column tile at a time; rows are only committed once all tiles of their block are done
+        for (int nBlockY = roi.y; nBlockY < nRegionEnd;) {
+            int nBlockEnd = std::min(nRegionEnd, nBlockY + BGSVIBE_PARALLEL_STRIPE_HEIGHT);
+            if (nRegionEnd - nBlockEnd < 2)
+                nBlockEnd = nRegionEnd;
+            const int nBandHeight = (m_nGatingTileSize > 0) ? m_nGatingTileSize : (nBlockEnd - nBlockY);
+            if (m_nGatingTileSize > 0)
+                for (int nBandY = nBlockY; nBandY < nBlockEnd; nBandY += nBandHeight)
+                    beginGatingBand<nChannels, TSample>(image, nBandY, std::min(nBandY + nBandHeight, nBlockEnd));
+            for (int nTileX = roi.x; nTileX < roi.x + roi.width; nTileX += m_nTileWidth) {
+                const int nTileEnd = std::min(nTileX + m_nTileWidth, roi.x + roi.width);
+                for (int y = nBlockY; y < nBlockEnd; ++y)
+                    applyRowRange(image, y, nTileX, nTileEnd, lMaskRow(y), rng, metrics);
+            }
+            for (int nBandY = nBlockY; nBandY < nBlockEnd; nBandY += nBandHeight) {
+                const int nBandEnd = std::min(nBandY + nBandHeight, nBlockEnd);
+                for (int y = nBandY; y < nBandEnd; ++y) {
+                    if (m_nGatingTileSize > 0)
+                        accumulateGatingRow(lMaskRow(y), y);
+                    lCommitRow(y);
+                }
+                if (m_nGatingTileSize > 0)
+                    endGatingBand<nChannels, TSample>(image, nBandY, nBandEnd);
+            }
+            nBlockY = nBlockEnd;
+        }
+    }
+
+    /// classifies & updates the included pixels of model row y in columns [nBegin,nEnd) (pFGMaskRow points at the row's first model column)
+    void applyRowRange(const cv::Mat& image, int y, int nBegin, int nEnd, uchar* const pFGMaskRow, Pcg32& rng, ViBeStripeMetrics& metrics) {
+        if (m_voRowSpans.empty()) {
+            applySpan(image, y, nBegin, nEnd - nBegin, pFGMaskRow + nBegin, rng, metrics);
+            return;
+        }
+        // excluded pixels are never visited, only their mask values are reset
+        memset(pFGMaskRow + nBegin, 0, nEnd - nBegin);
+        for (size_t i = m_vnRowSpanOffsets[y]; i < m_vnRowSpanOffsets[y + 1]; ++i) {
+            const int nStart = std::max(nBegin, m_voRowSpans[i].start);
+            const int nStop = std::min(nEnd, m_voRowSpans[i].end);
+            if (nStart < nStop)
+                applySpan(image, y, nStart, nStop - nStart, pFGMaskRow + nStart, rng, metrics);
+        }
+    }
+
+    /// classifies & updates nWidth consecutive pixels of a model row (pFGMaskRow points at the mask value of pixel nX); pixels of gated
+    /// tiles are not classified and stay background, but are still updated
+    void applySpan(const cv::Mat& image, int y, int nX, int nWidth, uchar* const pFGMaskRow, Pcg32& rng, ViBeStripeMetrics& metrics) {
+        const size_t nSampleStride = m_oBGModel.sampleStride();
+        const size_t nPixelStride = m_oBGModel.pixelStride();
+        // input frames may be strided views (e.g. the luma of packed YUYV), of which only the first nChannels channels are used
+        const size_t nInputStep = image.elemSize() / sizeof(TSample);
+        const TSample* const pInputRow = (const TSample*)getInputRow(image, y) + nX * nInputStep;
+        uchar* const pModelRow = m_oBGModel.ptr(0, y, nX);
+        const uint8_t* const pTileGated = (m_nGatingTileSize > 0) ? m_vnTileGated.data() + (size_t)(y / m_nGatingTileSize) * m_nGatingTilesX : nullptr;
+        const bool bReorder = m_bReorderSamples;
+        const auto lClassifyPixel = [&](int x, size_t& nTests) {
+            if (bReorder)
+                return lv::classifyPixelReordering<nChannels, TSample, TDistance, TEncoding>(pInputRow + x * nInputStep, pModelRow + x * nPixelStride, nSampleStride, m_oBGModel.elemSize(), m_nBGSamples, m_nRequiredBGSamples, m_oDistParams, nTests);
+            return lv::classifyPixel<nChannels, TSample, TDistance, TEncoding>(pInputRow + x * nInputStep, pModelRow + x * nPixelStride, nSampleStride, m_nBGSamples, m_nRequiredBGSamples, m_oDistParams, nTests);
+        };
+        // classifies the pixels [nBegin,nEnd) of the span (relative to nX)
+        const auto lClassifyRange = [&](int nBegin, int nEnd) {
+            size_t nTests = 0;
+            if (bReorder)
+                for (int x = nBegin; x < nEnd; ++x)
+                    pFGMaskRow[x] = lClassifyPixel(x, nTests);
+            else
+                nTests = lv::classifyRow<nChannels, TSample, TDistance, TEncoding>(pInputRow + nBegin * nInputStep, nInputStep, pModelRow + nBegin * nPixelStride, nSampleStride, nPixelStride, m_nBGSamples, m_nRequiredBGSamples, m_oDistParams, nEnd - nBegin, pFGMaskRow + nBegin);
+            metrics.add(ViBeStripeMetrics::Counter::ClassifiedPixels, (uint64_t)(nEnd - nBegin));
+            metrics.add(ViBeStripeMetrics::Counter::SampleTests, (uint64_t)nTests);
+        };
+        const uint64_t nClassifyStartNs = lv::metricsNow();
+        if (!pTileGated)
+            lClassifyRange(0, nWidth);
+        else {
+            // the span is classified piecewise, skipping the gated tiles
+            for (int x = nX; x < nX + nWidth;) {
+                const int nEnd = std::min(nX + nWidth, (x / m_nGatingTileSize + 1) * m_nGatingTileSize);
+                if (pTileGated[x / m_nGatingTileSize]) {
+                    memset(pFGMaskRow + (x - nX), 0, nEnd - x);
+                    metrics.add(ViBeStripeMetrics::Counter::GatedPixels, (uint64_t)(nEnd - x));
+                }
+                else
+                    lClassifyRange(x - nX, nEnd - nX);
+                x = nEnd;
+            }
+        }
+        metrics.addTime(ViBeStripeMetrics::Phase::Classify, nClassifyStartNs);
+        if (m_eUpdateMode == UpdateMode::Reference) {
+            // updated in a separate pass, once the whole frame is classified
+            metrics.addForeground(pFGMaskRow, nWidth);
+            return;
+        }
+        const uint64_t nUpdateStartNs = lv::metricsNow();
+        updateRow<nChannels, TSample, TEncoding>((const uchar*)pInputRow, image.elemSize(), pFGMaskRow, y, cv::Rect(nX, y, nWidth, 1), rng, metrics, [&](int x) {
+            if (pTileGated && pTileGated[(nX + x) / m_nGatingTileSize])
+                return (uchar)0;
+            size_t nTests = 0;
+            const uchar nValue = (uchar)lClassifyPixel(x, nTests);
+            metrics.add(ViBeStripeMetrics::Counter::SampleTests, (uint64_t)nTests);
+            return nValue;
+        });
+        metrics.addTime(ViBeStripeMetrics::Phase::Update, nUpdateStartNs);
+        metrics.addForeground(pFGMaskRow, nWidth);
+    }
 };
 
+/// distance policy used by BackgroundSubtractorViBe_3ch, as selected by the BGSVIBE_USE_L1_DISTANCE_CHECK & BGSVIBE_USE_SC_THRS_VALIDATION switches
+using BackgroundSubtractorViBe_3chDistance = std::conditional_t<BackgroundSubtractorViBe::BGSVIBE_USE_SC_THRS_VALIDATION,
+    lv::SCValidatedDistance<std::conditional_t<BackgroundSubtractorViBe::BGSVIBE_USE_L1_DISTANCE_CHECK, lv::L1Distance, lv::L2SqrDistance>>,
+    std::conditional_t<BackgroundSubtractorViBe::BGSVIBE_USE_L1_DISTANCE_CHECK, lv::L1Distance, lv::L2SqrDistance>>;
+
+/// ViBe foreground-background segmentation algorithm (1ch/grayscale version)
+using BackgroundSubtractorViBe_1ch = BackgroundSubtractorViBeEngine<1, uint8_t, lv::L1Distance>;
+
 /// ViBe foreground-background segmentation algorithm (3ch/RGB version)
-class BackgroundSubtractorViBe_3ch : public BackgroundSubtractorViBe {
-public:
-    /// full constructor
-    BackgroundSubtractorViBe_3ch(size_t nColorDistThreshold = BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD,
-        size_t nBGSamples = BGSVIBE_DEFAULT_NB_BG_SAMPLES,
-        size_t nRequiredBGSamples = BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES,
-        size_t learningRate = BGSVIBE_DEFAULT_LEARNING_RATE);
-    /// default destructor
-    virtual ~BackgroundSubtractorViBe_3ch();
-    /// (re)initiaization method; needs to be called before starting background subtraction
-    virtual void initialize(const cv::Mat& oInitImg);
-    /// primary model update function; the learning param is reinterpreted as an integer and should be > 0 (smaller values == faster adaptation)
-    virtual void apply(const cv::Mat& image, cv::Mat& fgmask);
+using BackgroundSubtractorViBe_3ch = BackgroundSubtractorViBeEngine<3, uint8_t, BackgroundSubtractorViBe_3chDistance>;
 
-    void initializeParallel(const cv::Mat& oInitImg, const int numProcesses);
-    void applyParallel(const cv::Mat& image, cv::Mat& fgmask);
+/// ViBe foreground-background segmentation algorithm (3ch/RGB version, with samples stored as BGR565; see vibeEncodings.hpp for the trade-offs)
+using BackgroundSubtractorViBe_3chBGR565 = BackgroundSubtractorViBeEngine<3, uint8_t, BackgroundSubtractorViBe_3chDistance, lv::BGR565Encoding>;
 
-private:
-    const size_t m_nColorDistThresholdSquared;
+/// ViBe foreground-background segmentation algorithm (3ch/RGB version, with samples stored as luma + coarse chroma)
+using BackgroundSubtractorViBe_3chYUV844 = BackgroundSubtractorViBeEngine<3, uint8_t, BackgroundSubtractorViBe_3chDistance, lv::YUV844Encoding>;
 
-    int m_numProcessesParallel;
-    std::vector<std::vector<cv::Mat>> m_voBGImgParallel;
-    std::vector<int> m_processSeq;
-    std::vector<cv::Rect> m_rectImgs;
-    std::vector<cv::Mat> m_outSplit;
+/// ViBe foreground-background segmentation algorithm (3ch/RGB version, with samples stored as BGR332)
+using BackgroundSubtractorViBe_3chBGR332 = BackgroundSubtractorViBeEngine<3, uint8_t, BackgroundSubtractorViBe_3chDistance, lv::BGR332Encoding>;
 
-    void splitImages(const cv::Mat& inputImg, std::vector<cv::Mat>& outputImages);
-    void joinImages(const std::vector<cv::Mat>& outputImages, cv::Mat& outputImg);
-    void applyCmp(const cv::Mat& _image, std::vector<cv::Mat>& _bg, cv::Mat& _fgmask);
-};
+template<size_t nChannels, typename TSample, typename TEncoding, typename TReclassifyFunc>
+void BackgroundSubtractorViBe::updateRow(const uchar* pInputRow, size_t nInputPixelStride, uchar* pFGMaskRow, int y, const cv::Rect& oROI, Pcg32& oRNG,
+        ViBeStripeMetrics& oMetrics, TReclassifyFunc&& lReclassify) {
+    if (m_eUpdateMode == UpdateMode::Stochastic) {
+        for (int x = 0; x < oROI.width; ++x) {
+            if (pFGMaskRow[x])
+                continue;
+            const uchar* const pInput = pInputRow + x * nInputPixelStride;
+            if ((oRNG() % m_learningRate) == 0) {
+                replaceSample<nChannels, TSample, TEncoding>(oRNG() % m_nBGSamples, y, oROI.x + x, pInput);
+                oMetrics.add(ViBeStripeMetrics::Counter::SelfUpdates);
+            }
+            if ((oRNG() % m_learningRate) == 0) {
+                int x_rand, y_rand;
+                getNeighborPosition_3x3(oRNG(), x_rand, y_rand, oROI.x + x, y, m_oImgSize);
+                replaceSample<nChannels, TSample, TEncoding>(oRNG() % m_nBGSamples, y_rand, x_rand, pInput);
+                oMetrics.add(ViBeStripeMetrics::Counter::NeighborUpdates);
+                if (y_rand == y && x_rand > oROI.x + x && x_rand < oROI.x + oROI.width) { // the next pixel's samples changed after the row was classified
+                    pFGMaskRow[x_rand - oROI.x] = lReclassify(x_rand - oROI.x);
+                    oMetrics.add(ViBeStripeMetrics::Counter::ReclassifiedPixels);
+                }
+            }
+        }
+    }
+    else {
+        // only the pixels picked by the jump tables are visited; each row starts at a random table offset
+        const UpdateTables& oTables = m_oUpdateTables;
+        size_t nSelfIdx = oRNG() & UpdateTables::s_nTableMask;
+        size_t nNeighborIdx = oRNG() & UpdateTables::s_nTableMask;
+        int nNextSelfX = oTables.vnJumps[nSelfIdx] - 1;
+        int nNextNeighborX = oTables.vnJumps[nNeighborIdx] - 1;
+        while (true) {
+            const int x = std::min(nNextSelfX, nNextNeighborX);
+            if (x >= oROI.width)
+                break;
+            const uchar* const pInput = pInputRow + x * nInputPixelStride;
+            if (x == nNextSelfX) {
+                if (!pFGMaskRow[x]) {
+                    replaceSample<nChannels, TSample, TEncoding>(oTables.vnSampleIdxs[nSelfIdx], y, oROI.x + x, pInput);
+                    oMetrics.add(ViBeStripeMetrics::Counter::SelfUpdates);
+                }
+                nSelfIdx = (nSelfIdx + 1) & UpdateTables::s_nTableMask;
+                nNextSelfX += oTables.vnJumps[nSelfIdx];
+            }
+            if (x == nNextNeighborX) {
+                if (!pFGMaskRow[x]) {
+                    int x_rand, y_rand;
+                    getNeighborPosition_3x3(oTables.vnNeighborIdxs[nNeighborIdx], x_rand, y_rand, oROI.x + x, y, m_oImgSize);
+                    replaceSample<nChannels, TSample, TEncoding>(oTables.vnSampleIdxs[nNeighborIdx], y_rand, x_rand, pInput);
+                    oMetrics.add(ViBeStripeMetrics::Counter::NeighborUpdates);
+                    if (y_rand == y && x_rand > oROI.x + x && x_rand < oROI.x + oROI.width) { // the next pixel's samples changed after the row was classified
+                        pFGMaskRow[x_rand - oROI.x] = lReclassify(x_rand - oROI.x);
+                        oMetrics.add(ViBeStripeMetrics::Counter::ReclassifiedPixels);
+                    }
+                }
+                nNeighborIdx = (nNeighborIdx + 1) & UpdateTables::s_nTableMask;
+                nNextNeighborX += oTables.vnJumps[nNeighborIdx];
+            }
+        }
+    }
+}
+
+template<size_t nChannels, typename TSample, typename TEncoding, typename TMaskRowFunc, typename TCommitRowFunc>
+void BackgroundSubtractorViBe::updateReference(const cv::Mat& oInput, const cv::Rect& oROI, uint64_t nFrameKey, ViBeStripeMetrics& oMetrics,
+        TMaskRowFunc&& lMaskRow, TCommitRowFunc&& lCommitRow) {
+    const size_t nInputPixelStride = oInput.elemSize();
+    // excluded pixels read as background in the mask, but must not propagate their values
+    const auto lIsIncluded = [&](int x, int y) {
+        if (m_voRowSpans.empty())
+            return true;
+        for (size_t i = m_vnRowSpanOffsets[y]; i < m_vnRowSpanOffsets[y + 1]; ++i)
+            if (x >= m_voRowSpans[i].start && x < m_voRowSpans[i].end)
+                return true;
+        return false;
+    };
+    for (int y = oROI.y; y < oROI.y + oROI.height; ++y) {
+        const uint64_t nUpdateStartNs = lv::metricsNow();
+        const uchar* const pMaskRow = m_oReferenceMask.ptr<uchar>(y);
+        const uchar* const pInputRow = getInputRow(oInput, y);
+        const auto lUpdatePixel = [&](int x) {
+            Pcg32 oRNG = Pcg32::derive(nFrameKey, (uint64_t)y * m_oImgSize.width + x);
+            if (!pMaskRow[x] && (oRNG() % m_learningRate) == 0) {
+                replaceSample<nChannels, TSample, TEncoding>(oRNG() % m_nBGSamples, y, x, pInputRow + x * nInputPixelStride);
+                oMetrics.add(ViBeStripeMetrics::Counter::SelfUpdates);
+            }
+            if ((oRNG() % m_learningRate) == 0) {
+                int x_rand, y_rand;
+                getNeighborPosition_3x3(oRNG(), x_rand, y_rand, x, y, m_oImgSize);
+                if (!m_oReferenceMask.ptr<uchar>(y_rand)[x_rand] && lIsIncluded(x_rand, y_rand)) {
+                    replaceSample<nChannels, TSample, TEncoding>(oRNG() % m_nBGSamples, y, x, getInputRow(oInput, y_rand) + x_rand * nInputPixelStride);
+                    oMetrics.add(ViBeStripeMetrics::Counter::NeighborUpdates);
+                }
+            }
+        };
+        if (m_voRowSpans.empty())
+            for (int x = oROI.x; x < oROI.x + oROI.width; ++x)
+                lUpdatePixel(x);
+        else
+            for (size_t i = m_vnRowSpanOffsets[y]; i < m_vnRowSpanOffsets[y + 1]; ++i)
+                for (int x = std::max(oROI.x, m_voRowSpans[i].start); x < std::min(oROI.x + oROI.width, m_voRowSpans[i].end); ++x)
+                    lUpdatePixel(x);
+        oMetrics.addTime(ViBeStripeMetrics::Phase::Update, nUpdateStartNs);
+        memcpy(lMaskRow(y) + oROI.x, pMaskRow + oROI.x, oROI.width);
+        lCommitRow(y);
+    }
+}
+
+template<size_t nChannels, typename TSample>
+void BackgroundSubtractorViBe::beginGatingBand(const cv::Mat& oInput, int nBandY, int nBandEnd) {
+    const size_t nInputStep = oInput.elemSize() / sizeof(TSample);
+    const size_t nTileRowIdx = (size_t)(nBandY / m_nGatingTileSize) * m_nGatingTilesX;
+    for (int nTile = 0; nTile < m_nGatingTilesX; ++nTile) {
+        const size_t nTileIdx = nTileRowIdx + nTile;
+        bool bGated = !m_vnTileForeground[nTileIdx] && m_vnTileSkippedFrames[nTileIdx] < m_nGatingMaxSkippedFrames;
+        // max-diff against the reference, with an early exit on the first pixel out of bounds
+        const int nBegin = nTile * m_nGatingTileSize, nEnd = std::min(m_oImgSize.width, nBegin + m_nGatingTileSize);
+        for (int y = nBandY; y < nBandEnd && bGated; ++y) {
+            const TSample* const pInputRow = (const TSample*)getInputRow(oInput, y);
+            const TSample* const pRefRow = m_oGatingRefImg.ptr<TSample>(y);
+            size_t nMaxDiff = 0;
+            for (int x = nBegin; x < nEnd; ++x)
+                for (size_t c = 0; c < nChannels; ++c)
+                    nMaxDiff = std::max(nMaxDiff, (size_t)std::abs(int(pInputRow[x * nInputStep + c]) - int(pRefRow[x * nChannels + c])));
+            bGated = (nMaxDiff <= m_nGatingMaxDiff);
+        }
+        m_vnTileGated[nTileIdx] = bGated;
+        m_vnTileSkippedFrames[nTileIdx] = bGated ? m_vnTileSkippedFrames[nTileIdx] + 1 : 0;
+        m_vnTileForeground[nTileIdx] = 0; // accumulated over the rows of the band
+    }
+}
+
+template<size_t nChannels, typename TSample>
+void BackgroundSubtractorViBe::endGatingBand(const cv::Mat& oInput, int nBandY, int nBandEnd) {
+    const size_t nInputStep = oInput.elemSize() / sizeof(TSample);
+    const size_t nTileRowIdx = (size_t)(nBandY / m_nGatingTileSize) * m_nGatingTilesX;
+    for (int nTile = 0; nTile < m_nGatingTilesX; ++nTile) {
+        if (m_vnTileGated[nTileRowIdx + nTile])
+            continue;
+        const int nBegin = nTile * m_nGatingTileSize, nEnd = std::min(m_oImgSize.width, nBegin + m_nGatingTileSize);
+        for (int y = nBandY; y < nBandEnd; ++y) {
+            const TSample* const pInputRow = (const TSample*)getInputRow(oInput, y);
+            TSample* const pRefRow = m_oGatingRefImg.ptr<TSample>(y);
+            for (int x = nBegin; x < nEnd; ++x)
+                for (size_t c = 0; c < nChannels; ++c)
+                    pRefRow[x * nChannels + c] = pInputRow[x * nInputStep + c];
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BackgroundSubtractorViBe.hpp"
+
+/// raw camera pixel formats accepted by BackgroundSubtractorViBeYUV (Bayer patterns are named after their top-left 2x2 cell)
+enum class PixelFormat {
+    NV12, NV21, I420, YV12, YUYV, UYVY,
+    BayerBGGR, BayerRGGB, BayerGBRG, BayerGRBG,
+};
+
+/// stride-aware description of a raw camera frame (no ownership); planes are always ordered as Y, U, V for planar formats,
+/// Y, interleaved chroma for semi-planar ones, and a single plane for packed YUV & Bayer mosaics
+struct YUVFrame {
+    PixelFormat eFormat;
+    /// luma (or mosaic) size
+    cv::Size oSize;
+    const uchar* apPlanes[3]{};
+    size_t anStrides[3]{};
+
+    /// wraps a buffer laid out like OpenCV's raw captures: (h*3/2)xw CV_8UC1 for 4:2:0 formats (chroma planes right after the luma
+    /// rows), hxw CV_8UC2 for packed 4:2:2 formats, and hxw CV_8UC1 for Bayer mosaics
+    static YUVFrame wrap(PixelFormat eFormat, const cv::Mat& oBuffer);
+};
+
+/// ViBe foreground-background segmentation on raw camera frames, without color conversion; each plane (or Bayer site) is processed
+/// by its own model through a zero-copy strided view, and the full-resolution mask is the union of the plane masks
+class BackgroundSubtractorViBeYUV {
+public:
+    /// planes used by the segmentation
+    enum class ChromaMode {
+        /// full-resolution luma only (for Bayer mosaics, one green site at half resolution)
+        LumaOnly,
+        /// full-resolution luma plus the subsampled chroma (for Bayer mosaics, all four sites at half resolution)
+        LumaChroma,
+    };
+
+    /// full constructor
+    BackgroundSubtractorViBeYUV(PixelFormat eFormat, ChromaMode eChromaMode,
+        size_t nColorDistThreshold = BackgroundSubtractorViBe::BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD,
+        size_t nBGSamples = BackgroundSubtractorViBe::BGSVIBE_DEFAULT_NB_BG_SAMPLES,
+        size_t nRequiredBGSamples = BackgroundSubtractorViBe::BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES,
+        size_t learningRate = BackgroundSubtractorViBe::BGSVIBE_DEFAULT_LEARNING_RATE);
+    /// (re)initiaization method; needs to be called before starting background subtraction
+    void initialize(const YUVFrame& oInitFrame);
+    /// primary model update function
+    void apply(const YUVFrame& oFrame, cv::Mat& fgmask);
+    /// (re)initialization method using the worker pool shared by all plane models; if none was configured, a single pool of numProcesses
+    /// threads is created for all of them (the planes are processed one after the other, each spread over the whole pool)
+    void initializeParallel(const YUVFrame& oInitFrame, const int numProcesses);
+    /// model update function using the worker pool
+    void applyParallel(const YUVFrame& oFrame, cv::Mat& fgmask);
+    /// sets the seed from which the random streams of all plane models are derived (takes effect on the next (re)initialization)
+    void setRandomSeed(uint64_t nSeed);
+    /// sets the worker pool used by the parallel paths of all plane models
+    void setThreadPool(std::shared_ptr<ThreadPool> pThreadPool);
+    /// returns the number of plane models
+    inline size_t getPlaneCount() const {return m_voPlanes.size();}
+
+private:
+    /// model of one plane, along with where its view lives in the raw frame
+    struct PlaneModel {
+        std::unique_ptr<BackgroundSubtractorViBe> pModel;
+        int nPlaneIdx;
+        /// offset of the view's first row in its plane (views always start on the plane's first byte)
+        int nRowOffset;
+        /// type of the view's elements (may hold more channels than the model reads, which start at its input channel offset)
+        int nViewType;
+        /// number of plane rows per view row (2 for Bayer sites)
+        int nRowStep;
+        /// subsampling factors w.r.t. the luma/mosaic size
+        int nScaleX, nScaleY;
+        /// mask of the plane (unused for full-resolution planes, which write straight into the output)
+        cv::Mat oFGMask;
+    };
+
+    /// returns the zero-copy view of a plane in the given frame
+    cv::Mat getView(const PlaneModel& oPlane, const YUVFrame& oFrame) const;
+    /// segments all planes & merges their masks into the full-resolution output
+    void applyPlanes(const YUVFrame& oFrame, cv::Mat& fgmask, bool bParallel);
+
+    const PixelFormat m_eFormat;
+    std::vector<PlaneModel> m_voPlanes;
+    /// worker pool shared by the plane models (null if none was configured)
+    std::shared_ptr<ThreadPool> m_pThreadPool;
+    cv::Size m_oFrameSize;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/// foreground mask in compact formats, filled by BackgroundSubtractorViBe::apply/applyParallel straight from the classified rows (no
+/// full-resolution 0/255 mask is ever written); all formats are at processing resolution (i.e. the frame size divided by nScale), and
+/// all of them describe the post-processed mask if a filter is enabled
+struct CompactMask {
+    /// output formats (may be combined)
+    enum Format {
+        /// 1 bit per pixel, 64 pixels per word
+        Bits = 1,
+        /// per-row runs of foreground pixels
+        Runs = 2,
+        /// foreground pixel count of each nTileSize x nTileSize tile
+        Tiles = 4,
+        /// 8-connected foreground components with their statistics (implies Runs)
+        Blobs = 8,
+    };
+    /// noise removal applied to the classified rows before any output is produced
+    enum class Filter {
+        None,
+        /// 3x3 median (i.e. majority of the 9 neighbors, with replicated frame borders), same as cv::medianBlur(mask,mask,3)
+        Median3x3,
+    };
+    /// 8-connected foreground component
+    struct Blob {
+        cv::Rect oBBox;
+        int nArea;
+        cv::Point2f oCentroid;
+    };
+
+    /// formats to produce (combination of Format flags)
+    int nFormats{Bits};
+    /// side of the occupancy tiles, in pixels
+    int nTileSize{16};
+    /// noise removal filter
+    Filter eFilter{Filter::None};
+    /// components smaller than this (in pixels) are dropped from the blob list (their pixels stay in the other formats)
+    int nMinBlobArea{1};
+
+    /// size of the mask (processing resolution) & downscaling factor w.r.t. the input frames
+    cv::Size oSize;
+    int nScale{1};
+    /// packed mask: pixel (x,y) is bit x%64 of vnBits[y*nWordsPerRow+x/64] (padding bits are 0); also filled when Tiles is requested or
+    /// a filter is enabled
+    size_t nWordsPerRow{0};
+    std::vector<uint64_t> vnBits;
+    /// foreground runs [start,end) of all rows (concatenated in row order), and index of the first run of each row (plus a final end index)
+    std::vector<cv::Range> voRuns;
+    std::vector<size_t> vnRowRunOffsets;
+    /// foreground pixel count of each tile (CV_32SC1, ceil(height/nTileSize) x ceil(width/nTileSize))
+    cv::Mat oTileCounts;
+    /// components in raster order of their first pixel (as labeled by cv::connectedComponents), and blob index of each run (-1 if dropped)
+    std::vector<Blob> voBlobs;
+    std::vector<int32_t> vnRunLabels;
+
+    /// returns whether the given format was produced
+    inline bool has(Format eFormat) const {return (nFormats & eFormat) != 0;}
+    /// returns whether the packed mask is produced for the requested formats & filter
+    inline bool needsBits() const {return has(Bits) || has(Tiles) || eFilter != Filter::None;}
+    /// returns whether runs are produced for the requested formats
+    inline bool needsRuns() const {return has(Runs) || has(Blobs);}
+    /// returns the packed words of a row (only valid if Bits or Tiles were produced)
+    inline const uint64_t* row(int y) const {return vnBits.data() + (size_t)y * nWordsPerRow;}
+    /// returns whether pixel (x,y) is foreground (only valid if Bits or Tiles were produced)
+    inline bool test(int x, int y) const {return (row(y)[x / 64] >> (x % 64)) & 1;}
+    /// expands the mask to a CV_8UC1 0/255 image at processing resolution (from the packed bits, or from the runs)
+    void unpack(cv::Mat& oMask) const;
+    /// appends the runs of foreground pixels of a packed row of nWidth pixels; returns the number of runs found
+    static size_t appendRowRuns(const uint64_t* pWords, int nWidth, std::vector<cv::Range>& voRuns);
+    /// recomputes the runs of all rows from the packed bits
+    void computeRuns();
+    /// recomputes the tile counts from the packed bits
+    void computeTileCounts();
+    /// labels the 8-connected components of the runs (union-find over overlapping runs of consecutive rows) & fills the blob list
+    void computeBlobs();
+    /// computes the 3x3 median of a packed row of nWidth pixels from the row & its upper/lower neighbors (64 pixels at a time, with
+    /// bit-sliced neighbor counts)
+    static void medianRow3x3(const uint64_t* pUpperRow, const uint64_t* pRow, const uint64_t* pLowerRow, int nWidth, uint64_t* pOutput);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/// fixed-size header at the start of ViBe model snapshot files; every section starts on a page boundary so that the sample buffer
+/// can be mapped straight from the file (the sample sums & background image are cheap to rebuild, and are not stored)
+struct ModelSnapshotHeader {
+    /// current version of the file format; files written with another version are rejected
+    static constexpr uint32_t s_nVersion = 2;
+    /// alignment of all sections, in bytes (a multiple of the page size on all supported platforms)
+    static constexpr uint64_t s_nSectionAlign = 4096;
+
+    char acMagic[8];
+    uint32_t nVersion;
+    uint32_t nHeaderBytes;
+    /// model parameters, which must match those of the subtractor that restores the snapshot (the model type is the type of the
+    /// pixels, the samples are stored with the given lv::SampleEncoding)
+    int32_t nModelType, nLayout, nUpdateMode, nSampleEncoding;
+    uint64_t nSamples, nRequiredSamples, nColorDistThreshold, nLearningRate;
+    /// frame geometry (full-resolution input size & downscaling factor; the ROI mask has its own section)
+    int32_t nInputWidth, nInputHeight, nProcessingScale;
+    /// random streams: seed (the update tables are rebuilt from it), serial stream state, and per-stripe states
+    uint64_t nRandomSeed;
+    uint64_t anRNGState[2];
+    uint64_t nStripeCount;
+    /// sections (offsets from the start of the file, in bytes)
+    uint64_t nStripeRNGOffset, nStripeRNGBytes;
+    uint64_t nROIMaskOffset, nROIMaskBytes;
+    uint64_t nModelOffset, nModelBytes;
+    uint64_t nFileBytes;
+
+    /// fills the magic & version fields and assigns the section offsets (the section sizes must already be set)
+    void layoutSections();
+    /// returns whether the magic, version & section fields are consistent with a file of the given size
+    bool isValid(uint64_t nActualFileBytes) const;
+};
+
+/// snapshot content staged in memory, written to disk by ModelSnapshot::write
+struct ModelSnapshot {
+    ModelSnapshotHeader oHeader;
+    /// state & increment of each stripe stream
+    std::vector<uint64_t> vnStripeRNGStates;
+    /// full-resolution ROI mask (empty if none)
+    cv::Mat oROIMask;
+    /// copy of the sample buffer
+    std::vector<uchar> vnModelData;
+
+    /// writes the snapshot to a temporary file, then renames it over sPath (so readers never see a partial file)
+    void write(const std::string& sPath);
+};
+
+/// snapshot file mapped in memory (copy-on-write, so the sample buffer may be used & modified in place without touching the file)
+struct MappedModelSnapshot {
+    const ModelSnapshotHeader* pHeader{nullptr};
+    uchar* pData{nullptr};
+    /// keeps the mapping alive
+    std::shared_ptr<void> pMapping;
+
+    /// maps & validates the given snapshot file
+    static MappedModelSnapshot open(const std::string& sPath);
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "BackgroundSubtractorViBe.hpp"
+#include "ThreadPool.hpp"
+
+/// runs many ViBe streams (one per camera) on a single shared worker pool; frames are queued asynchronously, the stripes of all
+/// in-flight frames share the pool's queues, and masks are returned through per-stream callbacks (invoked on a pool worker)
+class MultiStreamEngine {
+public:
+    using StreamId = size_t;
+    /// result of one processed frame; the mask is only valid for the duration of the callback
+    struct FrameResult {
+        /// index of the frame in the order it was pushed to its stream (dropped frames leave gaps)
+        size_t nFrameIdx;
+        const cv::Mat& oFGMask;
+        /// time between pushFrame and the end of the segmentation, in seconds
+        double dLatency;
+        /// whether the frame finished after its stream's deadline
+        bool bDeadlineMissed;
+    };
+    using ResultCallback = std::function<void(StreamId, const FrameResult&)>;
+    /// per-stream counters
+    struct StreamStats {
+        size_t nProcessed{0};
+        /// frames discarded before processing (queue overflow, or stale frames superseded by a newer one past their deadline)
+        size_t nDropped{0};
+        size_t nDeadlineMisses{0};
+        double dMaxLatency{0};
+    };
+
+    /// full constructor; creates a pool using all hardware threads if none is provided
+    explicit MultiStreamEngine(std::shared_ptr<ThreadPool> pThreadPool = nullptr);
+    /// default destructor; waits for the in-flight frames (pending ones are discarded)
+    ~MultiStreamEngine();
+    MultiStreamEngine(const MultiStreamEngine&) = delete;
+    MultiStreamEngine& operator=(const MultiStreamEngine&) = delete;
+
+    /// registers a stream and initializes its model with the given frame; dDeadline is the maximum latency (in seconds) allowed
+    /// per frame (0 = none), and nQueueDepth is the number of frames that may wait for processing before the oldest ones are dropped
+    StreamId addStream(std::unique_ptr<BackgroundSubtractorViBe> pSubtractor, const cv::Mat& oInitFrame, ResultCallback lCallback,
+                       double dDeadline = 0, size_t nQueueDepth = 2);
+    /// unregisters a stream; discards its pending frames and waits for its in-flight frame (must not be called from its callback)
+    void removeStream(StreamId nStreamId);
+    /// queues a copy of the frame and returns immediately; returns false if an older pending frame had to be dropped to make room
+    bool pushFrame(StreamId nStreamId, const cv::Mat& oFrame);
+    /// blocks until all queued frames have been processed (must not be called from a callback, whose own frame counts as in flight);
+    /// rethrows the first exception thrown while processing a frame
+    void flush();
+    /// returns the counters of the given stream
+    StreamStats getStats(StreamId nStreamId) const;
+    /// returns the number of registered streams
+    size_t getStreamCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct PendingFrame {
+        size_t nSlotIdx;
+        size_t nFrameIdx;
+        Clock::time_point tArrival;
+        Clock::time_point tDeadline;
+    };
+    struct Stream {
+        StreamId nId;
+        std::unique_ptr<BackgroundSubtractorViBe> pSubtractor;
+        ResultCallback lCallback;
+        Clock::duration oDeadline;
+        /// preallocated frame buffers (queue depth + the one being processed)
+        std::vector<cv::Mat> voFrames;
+        std::vector<size_t> vnFreeSlots;
+        std::deque<PendingFrame> voPending;
+        cv::Mat oFGMask;
+        size_t nNextFrameIdx{0};
+        /// number of slots reserved by pushFrame calls still copying their frame
+        size_t nCopying{0};
+        bool bBusy{false};
+        bool bRemoved{false};
+        StreamStats oStats;
+    };
+
+    /// starts frames on idle streams while the pool has room, earliest deadline first (ties go to the oldest frame); requires m_oMutex
+    void schedule();
+    /// segments one frame & invokes the stream callback (runs on a pool worker)
+    void process(const std::shared_ptr<Stream>& pStream, const PendingFrame& oFrame);
+    /// returns the stream with the given id (requires m_oMutex)
+    const std::shared_ptr<Stream>& getStream(StreamId nStreamId) const;
+
+    std::shared_ptr<ThreadPool> m_pThreadPool;
+    mutable std::mutex m_oMutex;
+    std::condition_variable m_oIdleCond;
+    std::map<StreamId, std::shared_ptr<Stream>> m_mpStreams;
+    StreamId m_nNextStreamId;
+    /// number of frames currently being processed; bounded by the pool size so that every worker can drive one stream
+    size_t m_nInFlight;
+    std::exception_ptr m_pException;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <memory>
+
+#include <opencv2/core.hpp>
+
+/// background sample model storage; all N samples of all pixels live in a single aligned buffer
+class SampleModel {
+public:
+    /// memory layouts available for the sample buffer (fixed at construction time)
+    enum class Layout {
+        /// sample-major: each sample is a full image plane (best for row-wise vectorized classification)
+        Planar,
+        /// pixel-major: all the samples of a pixel are contiguous (best for scalar early-exit classification)
+        Interleaved,
+    };
+
+    /// default constructor; the buffer is only allocated via SampleModel::create
+    explicit SampleModel(Layout eLayout = Layout::Planar);
+    /// default destructor
+    ~SampleModel();
+    SampleModel(const SampleModel&) = delete;
+    SampleModel& operator=(const SampleModel&) = delete;
+
+    /// (re)allocates the buffer for the given image size, sample count and sample type (e.g. CV_8UC3); the previous content is lost
+    void create(const cv::Size& oSize, size_t nSamples, int nType);
+    /// uses an external buffer laid out exactly as SampleModel::create would (e.g. a memory-mapped snapshot) instead of allocating one;
+    /// pOwner keeps the buffer alive until the model is released or re-created
+    void attach(uchar* pData, size_t nBytes, const cv::Size& oSize, size_t nSamples, int nType, std::shared_ptr<void> pOwner);
+    /// releases the buffer
+    void release();
+    /// exchanges the buffers & geometries of two models of the same layout
+    void swap(SampleModel& oOther);
+
+    /// returns the memory layout of the buffer
+    inline Layout layout() const {return m_eLayout;}
+    /// returns the image size covered by the model
+    inline const cv::Size& size() const {return m_oSize;}
+    /// returns the number of samples stored per pixel
+    inline size_t samples() const {return m_nSamples;}
+    /// returns the opencv type of a single sample (e.g. CV_8UC3)
+    inline int type() const {return m_nType;}
+    /// returns the size of a single sample, in bytes
+    inline size_t elemSize() const {return m_nElemSize;}
+    /// returns the number of bytes between two consecutive samples of the same pixel
+    inline size_t sampleStride() const {return m_nSampleStride;}
+    /// returns the number of bytes between the same sample of two horizontally adjacent pixels
+    inline size_t pixelStride() const {return m_nPixelStride;}
+    /// returns the number of bytes between the same sample of two vertically adjacent pixels
+    inline size_t rowStride() const {return m_nRowStride;}
+    /// returns the total size of the buffer, in bytes
+    inline size_t totalBytes() const {return m_nTotalBytes;}
+    /// returns whether the buffer is allocated or not
+    inline bool empty() const {return m_pData == nullptr;}
+
+    /// returns a pointer to the given sample of pixel (x,y)
+    inline uchar* ptr(size_t nSampleIdx, int y, int x = 0) {
+        return m_pData + nSampleIdx * m_nSampleStride + (size_t)y * m_nRowStride + (size_t)x * m_nPixelStride;
+    }
+    /// returns a pointer to the given sample of pixel (x,y)
+    inline const uchar* ptr(size_t nSampleIdx, int y, int x = 0) const {
+        return m_pData + nSampleIdx * m_nSampleStride + (size_t)y * m_nRowStride + (size_t)x * m_nPixelStride;
+    }
+    /// returns a matrix header over a single sample plane without copying it (planar layout only)
+    cv::Mat plane(size_t nSampleIdx) const;
+
+private:
+    /// computes the strides & total size of the buffer for the given geometry
+    void setGeometry(const cv::Size& oSize, size_t nSamples, int nType);
+
+    /// memory layout of the buffer
+    const Layout m_eLayout;
+    /// image size covered by the model
+    cv::Size m_oSize;
+    /// number of samples stored per pixel
+    size_t m_nSamples;
+    /// opencv type of a single sample
+    int m_nType;
+    /// strides used to address samples (see the accessors above)
+    size_t m_nElemSize, m_nSampleStride, m_nPixelStride, m_nRowStride;
+    /// total size of the buffer, in bytes
+    size_t m_nTotalBytes;
+    /// aligned sample buffer
+    uchar* m_pData;
+    /// owner of the buffer when it was attached instead of allocated (null otherwise)
+    std::shared_ptr<void> m_pOwner;
+};
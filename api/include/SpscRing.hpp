@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+/// bounded lock-free ring for exactly one producer thread and one consumer thread; all slots are allocated up front (the blocking
+/// variants sleep on the indices with std::atomic::wait, and are woken by every push or pop)
+template<typename T>
+class SpscRing {
+public:
+    /// full constructor; the capacity is rounded up to the next power of two
+    explicit SpscRing(size_t nCapacity) :
+        m_voSlots(roundUpPow2(nCapacity)),
+        m_nMask(m_voSlots.size() - 1),
+        m_nHead(0),
+        m_nTail(0) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// returns the number of slots in the ring
+    inline size_t capacity() const {return m_voSlots.size();}
+    /// returns the number of queued elements (only exact when called from the producer or the consumer thread)
+    inline size_t size() const {return m_nTail.load(std::memory_order_acquire) - m_nHead.load(std::memory_order_acquire);}
+    /// queues an element; returns false if the ring is full (producer thread only)
+    inline bool tryPush(const T& oValue) {
+        const size_t nTail = m_nTail.load(std::memory_order_relaxed);
+        if (nTail - m_nHead.load(std::memory_order_acquire) == m_voSlots.size())
+            return false;
+        m_voSlots[nTail & m_nMask] = oValue;
+        m_nTail.store(nTail + 1, std::memory_order_release);
+        m_nTail.notify_one();
+        return true;
+    }
+    /// dequeues an element; returns false if the ring is empty (consumer thread only)
+    inline bool tryPop(T& oValue) {
+        const size_t nHead = m_nHead.load(std::memory_order_relaxed);
+        if (nHead == m_nTail.load(std::memory_order_acquire))
+            return false;
+        oValue = m_voSlots[nHead & m_nMask];
+        m_nHead.store(nHead + 1, std::memory_order_release);
+        m_nHead.notify_one();
+        return true;
+    }
+    /// queues an element, sleeping while the ring is full (producer thread only; never waits when the ring can hold all the elements
+    /// in circulation, e.g. recycled slot indices)
+    inline void pushWait(const T& oValue) {
+        // a full ring has its read index one capacity behind the write index, until the consumer moves it
+        while (!tryPush(oValue))
+            m_nHead.wait(m_nTail.load(std::memory_order_relaxed) - m_voSlots.size(), std::memory_order_acquire);
+    }
+    /// dequeues an element, sleeping while the ring is empty (consumer thread only)
+    inline T popWait() {
+        T oValue;
+        // an empty ring has its write index equal to the read index, until the producer moves it
+        while (!tryPop(oValue))
+            m_nTail.wait(m_nHead.load(std::memory_order_relaxed), std::memory_order_acquire);
+        return oValue;
+    }
+
+private:
+    static inline size_t roundUpPow2(size_t n) {
+        size_t nPow2 = 1;
+        while (nPow2 < n)
+            nPow2 <<= 1;
+        return nPow2;
+    }
+
+    std::vector<T> m_voSlots;
+    const size_t m_nMask;
+    /// read index (owned by the consumer); kept on its own cache line to avoid false sharing with the write index
+    alignas(64) std::atomic<size_t> m_nHead;
+    /// write index (owned by the producer)
+    alignas(64) std::atomic<size_t> m_nTail;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// persistent worker pool with one task queue per worker and work stealing; threads are created once and reused across frames
+class ThreadPool {
+public:
+    /// full constructor; a thread count of 0 uses all hardware threads
+    explicit ThreadPool(size_t nThreads = 0);
+    /// default destructor; waits for the queued tasks to finish
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// returns the number of worker threads owned by the pool
+    inline size_t size() const {return m_voThreads.size();}
+    /// queues a task and returns immediately; when called from a worker, the task goes to that worker's own queue
+    void submit(std::function<void()> lTask);
+    /// runs lTask(i) for all i in [0,nTasks) and blocks until every call has returned; the calling thread executes tasks of this call
+    /// as well while waiting (so nested calls from workers cannot deadlock), but never other queued ones (so that e.g. a submitted task
+    /// waiting on its own batch does not end up running another submitted task on its stack), and the first exception thrown by a task
+    /// is rethrown here
+    void parallelFor(size_t nTasks, const std::function<void(size_t)>& lTask);
+
+private:
+    /// queued task, along with the parallelFor call it belongs to (null for submitted tasks)
+    struct Task {
+        const void* pBatch;
+        std::function<void()> lFunc;
+    };
+    /// task queue owned by a single worker (others only steal from its back)
+    struct WorkerQueue {
+        std::mutex oMutex;
+        std::deque<Task> oTasks;
+    };
+
+    /// pushes a task in the given queue and wakes up a worker
+    void push(size_t nQueueIdx, const void* pBatch, std::function<void()>&& lTask);
+    /// pops a task from the given queue, or steals one from the others (only tasks of the given batch, if any); returns false if no
+    /// task was found
+    bool tryRunOne(size_t nQueueIdx, const void* pBatch = nullptr);
+    /// main loop of each worker thread
+    void workerLoop(size_t nWorkerIdx);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_vpQueues;
+    std::vector<std::thread> m_voThreads;
+    std::mutex m_oWakeMutex;
+    std::condition_variable m_oWakeCond;
+    std::atomic<size_t> m_nQueuedTasks;
+    std::atomic<size_t> m_nNextQueueIdx;
+    bool m_bStopping;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include "pcg32.hpp"
+
+/// precomputed random decisions for the ViBe model update ("random tables" variant of the original authors); each row
+/// of a frame starts reading at a random offset, and no modulo is needed in the per-pixel loop
+struct UpdateTables {
+    /// table length; must be a power of two so that indices wrap with a mask
+    static const size_t s_nTableSize{1u << 16};
+    static const size_t s_nTableMask{s_nTableSize - 1};
+
+    /// distance (in pixels) between two consecutive update decisions; uniform in [1,2*learningRate-1] (mean = learningRate)
+    std::vector<uint16_t> vnJumps;
+    /// index of the sample replaced by the update
+    std::vector<uint16_t> vnSampleIdxs;
+    /// index in the 3x3 neighbor pattern used for propagation
+    std::vector<uint8_t> vnNeighborIdxs;
+
+    /// fills all tables for the given learning rate and sample count using the provided random stream
+    inline void initialize(size_t nLearningRate, size_t nSamples, Pcg32& oRNG) {
+        CV_Assert(nLearningRate > 0 && nLearningRate < (UINT16_MAX / 2) && nSamples > 0 && nSamples <= UINT16_MAX);
+        vnJumps.resize(s_nTableSize);
+        vnSampleIdxs.resize(s_nTableSize);
+        vnNeighborIdxs.resize(s_nTableSize);
+        for (size_t i = 0; i < s_nTableSize; ++i) {
+            vnJumps[i] = (uint16_t)(1 + (oRNG() % (2 * nLearningRate - 1)));
+            vnSampleIdxs[i] = (uint16_t)(oRNG() % nSamples);
+            vnNeighborIdxs[i] = (uint8_t)(oRNG() % 8);
+        }
+    }
+
+    /// returns whether the tables have been filled
+    inline bool empty() const {return vnJumps.empty();}
+};
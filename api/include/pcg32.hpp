@@ -1,21 +1,119 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+/// PCG32 random number generator (XSH-RR output over a 64-bit LCG, see https://www.pcg-random.org); every instance owns
+/// its own state and stream, so concurrent workers should each use their own generator instead of sharing one
 class Pcg32 {
 public:
+	/// defines the default seed used by generators that are not explicitly seeded
+	static const uint64_t s_nDefaultSeed = 0xcafef00dd15ea5e5u;
 
-	static inline uint32_t fast(void)
-	{
-		static uint64_t mcg_state{0xcafef00dd15ea5e5u};	// Must be odd
-		uint64_t x = mcg_state;
-		unsigned count = (unsigned)(x >> 61);	// 61 = 64 - 3
+	/// full constructor; generators sharing a seed but using different stream ids produce independent sequences
+	explicit Pcg32(uint64_t nSeed = s_nDefaultSeed, uint64_t nStream = 0) {
+		seed(nSeed, nStream);
+	}
+
+	/// returns a generator for item nIndex (e.g. a pixel) of the work identified by nKey (e.g. a frame); the key & index are hashed into
+	/// the seed, so that items get uncorrelated streams that do not depend on which thread creates them, nor in which order
+	static inline Pcg32 derive(uint64_t nKey, uint64_t nIndex) {
+		return Pcg32(mix(nKey ^ mix(nIndex + s_nGoldenGamma)), nIndex);
+	}
+
+	/// (re)seeds the generator on the given stream
+	inline void seed(uint64_t nSeed, uint64_t nStream = 0) {
+		m_nIncrement = (nStream << 1u) | 1u;
+		m_nState = 0u;
+		(*this)();
+		m_nState += nSeed;
+		(*this)();
+	}
 
-		mcg_state = x * multiplier;
-		x ^= x >> 22;
-		return (uint32_t)(x >> (22 + count));	// 22 = 32 - 3 - 7
+	/// returns the internal state & stream increment (e.g. to save a generator and resume it later via Pcg32::setState)
+	inline void getState(uint64_t& nState, uint64_t& nIncrement) const {
+		nState = m_nState;
+		nIncrement = m_nIncrement;
+	}
+
+	/// restores a state & stream increment returned by Pcg32::getState
+	inline void setState(uint64_t nState, uint64_t nIncrement) {
+		m_nState = nState;
+		m_nIncrement = nIncrement | 1u;
+	}
+
+	/// returns the next 32-bit random value of the stream
+	inline uint32_t operator()() {
+		const uint64_t nOldState = m_nState;
+		m_nState = nOldState * s_nMultiplier + m_nIncrement;
+		return output(nOldState);
+	}
+
+	/// moves the generator nDelta steps forward in O(log(nDelta)), as if nDelta values had been drawn
+	inline void advance(uint64_t nDelta) {
+		uint64_t nMult, nPlus;
+		getJump(nDelta, m_nIncrement, nMult, nPlus);
+		m_nState = nMult * m_nState + nPlus;
+	}
+
+	/// fills the buffer with the next n values of the stream; the result is identical to n successive calls, but the
+	/// values are produced over independent lanes (jumped ahead by the lane count) so the loop has no serial dependency
+	inline void fill(uint32_t* pOut, size_t n) {
+		constexpr size_t nLanes = 8;
+		size_t i = 0;
+		if (n >= nLanes * 2) {
+			uint64_t anLaneStates[nLanes];
+			for (size_t l = 0; l < nLanes; ++l) {
+				anLaneStates[l] = m_nState;
+				m_nState = m_nState * s_nMultiplier + m_nIncrement;
+			}
+			uint64_t nMult, nPlus;
+			getJump(nLanes, m_nIncrement, nMult, nPlus);
+			for (; i + nLanes <= n; i += nLanes) {
+				for (size_t l = 0; l < nLanes; ++l) {
+					pOut[i + l] = output(anLaneStates[l]);
+					anLaneStates[l] = anLaneStates[l] * nMult + nPlus;
+				}
+			}
+			m_nState = anLaneStates[0];
+		}
+		for (; i < n; ++i)
+			pOut[i] = (*this)();
 	}
 
 private:
-	static uint64_t const multiplier = 6364136223846793005u;
-};
\ No newline at end of file
+	/// SplitMix64 finalizer (bijective 64-bit mixing function)
+	static inline uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30u)) * 0xbf58476d1ce4e5b9u;
+		z = (z ^ (z >> 27u)) * 0x94d049bb133111ebu;
+		return z ^ (z >> 31u);
+	}
+
+	/// XSH-RR output permutation
+	static inline uint32_t output(uint64_t nState) {
+		const uint32_t nXorShifted = (uint32_t)(((nState >> 18u) ^ nState) >> 27u);
+		const uint32_t nRot = (uint32_t)(nState >> 59u);
+		return (nXorShifted >> nRot) | (nXorShifted << ((32u - nRot) & 31u));
+	}
+
+	/// computes the affine transform (mult, plus) that moves an LCG state nDelta steps forward
+	static inline void getJump(uint64_t nDelta, uint64_t nIncrement, uint64_t& nMult, uint64_t& nPlus) {
+		uint64_t nCurMult = s_nMultiplier, nCurPlus = nIncrement;
+		nMult = 1u;
+		nPlus = 0u;
+		while (nDelta > 0) {
+			if (nDelta & 1u) {
+				nMult *= nCurMult;
+				nPlus = nPlus * nCurMult + nCurPlus;
+			}
+			nCurPlus = (nCurMult + 1u) * nCurPlus;
+			nCurMult *= nCurMult;
+			nDelta >>= 1u;
+		}
+	}
+
+	static const uint64_t s_nMultiplier = 6364136223846793005u;
+	static const uint64_t s_nGoldenGamma = 0x9e3779b97f4a7c15u;
+	uint64_t m_nState;
+	uint64_t m_nIncrement;
+};
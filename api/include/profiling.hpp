@@ -4,19 +4,20 @@
 
 #include <windows.h>
 
-double clockFrequency;
-
+/// returns the period of the performance counter (in seconds); queried once, so getAbsoluteTime is valid even if this is never called
 inline double initFrequency() {
-    LARGE_INTEGER frequency;
-    QueryPerformanceFrequency(&frequency);
-    clockFrequency = 1.0 / frequency.QuadPart;
-    return clockFrequency;
+    static const double s_dClockPeriod = []() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return 1.0 / frequency.QuadPart;
+    }();
+    return s_dClockPeriod;
 }
 
 inline double getAbsoluteTime() {
     LARGE_INTEGER now;
     QueryPerformanceCounter(&now);
-    return (double)now.QuadPart * clockFrequency;
+    return (double)now.QuadPart * initFrequency();
 }
 
 #else
@@ -0,0 +1,142 @@
+#pragma once
+
+// @@@@@@@@
+//
+// Color distance policies for the ViBe engine. Each policy derives its thresholds from the color
+// distance threshold ('R') once, and exposes a compile-time 'isMatch' test for a pair of pixels;
+// the generic row classifier below forwards the 8-bit combinations that have a vectorized kernel
+// in 'vibeKernels.hpp' to it, and unrolls the scalar test for all the others. Samples of models
+// stored with a compressed encoding (see 'vibeEncodings.hpp') are decoded before the test.
+//
+// @@@@@@@@
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+#include "vibeEncodings.hpp"
+#include "vibeKernels.hpp"
+
+/// defines the internal threshold adjustment factor to use when determining if the variation of a single channel is enough to declare the pixel as foreground
+#define BGSVIBE_SINGLECHANNEL_THRESHOLD_DIFF_FACTOR (1.60f)
+
+namespace lv {
+
+	/// L1 distance policy: sum of absolute channel differences, compared to nChannels x R
+	struct L1Distance {
+		struct Params {
+			size_t nThreshold;
+		};
+		static inline Params makeParams(size_t nColorDistThreshold, size_t nChannels) {
+			return Params{nColorDistThreshold * nChannels};
+		}
+		template<size_t nChannels, typename TSample>
+		static inline bool isMatch(const TSample* a, const TSample* b, const Params& oParams) {
+			size_t nDist = 0;
+			for (size_t c = 0; c < nChannels; ++c)
+				nDist += (size_t)std::abs(int(a[c]) - int(b[c]));
+			return nDist < oParams.nThreshold;
+		}
+	};
+
+	/// squared L2 distance policy: sum of squared channel differences, compared to (nChannels x R)^2 (no square root needed)
+	struct L2SqrDistance {
+		struct Params {
+			size_t nThresholdSq;
+		};
+		static inline Params makeParams(size_t nColorDistThreshold, size_t nChannels) {
+			return Params{(nColorDistThreshold * nChannels) * (nColorDistThreshold * nChannels)};
+		}
+		template<size_t nChannels, typename TSample>
+		static inline bool isMatch(const TSample* a, const TSample* b, const Params& oParams) {
+			uint64_t nDist = 0;
+			for (size_t c = 0; c < nChannels; ++c) {
+				const int64_t r = int64_t(a[c]) - int64_t(b[c]);
+				nDist += (uint64_t)(r * r);
+			}
+			return nDist < oParams.nThresholdSq;
+		}
+	};
+
+	/// single-channel validation policy: rejects any sample for which one channel varies by more than
+	/// (R x BGSVIBE_SINGLECHANNEL_THRESHOLD_DIFF_FACTOR) / nChannels, then applies the base distance policy
+	template<typename TBaseDistance>
+	struct SCValidatedDistance {
+		struct Params : TBaseDistance::Params {
+			size_t nSCThreshold;
+		};
+		static inline Params makeParams(size_t nColorDistThreshold, size_t nChannels) {
+			Params oParams;
+			static_cast<typename TBaseDistance::Params&>(oParams) = TBaseDistance::makeParams(nColorDistThreshold, nChannels);
+			oParams.nSCThreshold = (size_t)(nColorDistThreshold * BGSVIBE_SINGLECHANNEL_THRESHOLD_DIFF_FACTOR) / nChannels;
+			return oParams;
+		}
+		template<size_t nChannels, typename TSample>
+		static inline bool isMatch(const TSample* a, const TSample* b, const Params& oParams) {
+			for (size_t c = 0; c < nChannels; ++c)
+				if ((size_t)std::abs(int(a[c]) - int(b[c])) > oParams.nSCThreshold)
+					return false;
+			return TBaseDistance::template isMatch<nChannels>(a, b, oParams);
+		}
+	};
+
+	/// scalar classification of a single pixel (also the body of the scalar row kernels); pSamples points to the pixel's first sample, and the others follow every nSampleStride bytes
+	/// (the number of samples tested is added to nTests)
+	template<size_t nChannels, typename TSample, typename TDistance, typename TEncoding = RawEncoding>
+	inline uint8_t classifyPixel(const TSample* pInput, const uint8_t* pSamples, size_t nSampleStride,
+		size_t nSamples, size_t nRequired, const typename TDistance::Params& oParams, size_t& nTests) {
+		size_t nGoodSamplesCount{0}, nSampleIdx{0};
+		TSample anDecoded[nChannels];
+		while ((nGoodSamplesCount < nRequired) && (nSampleIdx < nSamples)) {
+			if (TDistance::template isMatch<nChannels>(pInput, readSample<TSample, TEncoding>(pSamples + nSampleIdx * nSampleStride, anDecoded), oParams))
+				++nGoodSamplesCount;
+			++nSampleIdx;
+		}
+		nTests += nSampleIdx;
+		return (nGoodSamplesCount < nRequired) ? UINT8_MAX : 0;
+	}
+
+	/// scalar classification of a single pixel which also moves the matching samples to the front of its list: the k-th match found is
+	/// swapped with the k-th sample, so the samples that keep matching are tested first and the early exit comes sooner on the next frames;
+	/// the decision is identical to classifyPixel's, and since updates replace samples at random indices, the reordering does not change the
+	/// model's statistics (nSampleBytes is the size of one stored sample, and the number of samples tested is added to nTests)
+	template<size_t nChannels, typename TSample, typename TDistance, typename TEncoding = RawEncoding>
+	inline uint8_t classifyPixelReordering(const TSample* pInput, uint8_t* pSamples, size_t nSampleStride, size_t nSampleBytes,
+		size_t nSamples, size_t nRequired, const typename TDistance::Params& oParams, size_t& nTests) {
+		size_t nGoodSamplesCount{0}, nSampleIdx{0};
+		TSample anDecoded[nChannels];
+		while ((nGoodSamplesCount < nRequired) && (nSampleIdx < nSamples)) {
+			uint8_t* const pSample = pSamples + nSampleIdx * nSampleStride;
+			if (TDistance::template isMatch<nChannels>(pInput, readSample<TSample, TEncoding>(pSample, anDecoded), oParams)) {
+				if (nSampleIdx != nGoodSamplesCount)
+					std::swap_ranges(pSample, pSample + nSampleBytes, pSamples + nGoodSamplesCount * nSampleStride);
+				++nGoodSamplesCount;
+			}
+			++nSampleIdx;
+		}
+		nTests += nSampleIdx;
+		return (nGoodSamplesCount < nRequired) ? UINT8_MAX : 0;
+	}
+
+	/// classifies a full row of pixels; input pixels are nInputStep elements apart (>= nChannels), pSamples points to the first sample
+	/// of the row's first pixel, and pFGMask receives 0/255 flags; returns the number of samples tested (see classifyRow_3ch)
+	template<size_t nChannels, typename TSample, typename TDistance, typename TEncoding = RawEncoding>
+	inline size_t classifyRow(const TSample* pInput, size_t nInputStep, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, const typename TDistance::Params& oParams, size_t nPixels, uint8_t* pFGMask) {
+		constexpr bool bRaw8 = TEncoding::s_bRaw && std::is_same_v<TSample, uint8_t>;
+		size_t nTests = 0;
+		if (nInputStep != nChannels) // strided views always take the scalar path
+			for (size_t x = 0; x < nPixels; ++x)
+				pFGMask[x] = classifyPixel<nChannels, TSample, TDistance, TEncoding>(pInput + x * nInputStep, pSamples + x * nPixelStride, nSampleStride, nSamples, nRequired, oParams, nTests);
+		else if constexpr (bRaw8 && nChannels == 3 && std::is_same_v<TDistance, L2SqrDistance>)
+			nTests = classifyRow_3ch(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, oParams.nThresholdSq, nPixels, pFGMask);
+		else if constexpr (bRaw8 && nChannels == 1 && std::is_same_v<TDistance, L1Distance>)
+			nTests = classifyRow_1ch(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, oParams.nThreshold, nPixels, pFGMask);
+		else if constexpr (std::is_same_v<TEncoding, BGR565Encoding> && std::is_same_v<TDistance, L2SqrDistance>)
+			nTests = classifyRow_565(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, oParams.nThresholdSq, nPixels, pFGMask);
+		else
+			for (size_t x = 0; x < nPixels; ++x)
+				pFGMask[x] = classifyPixel<nChannels, TSample, TDistance, TEncoding>(pInput + x * nChannels, pSamples + x * nPixelStride, nSampleStride, nSamples, nRequired, oParams, nTests);
+		return nTests;
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// @@@@@@@@
+//
+// Sample encodings for the ViBe engine. By default, samples are stored as copies of the input
+// pixels; the compressed encodings below instead store each 8-bit 3ch sample as a single packed
+// code, and decode it before the distance test, so the distance policies & thresholds keep their
+// meaning and only the quantization error of the stored samples changes the results. The sample
+// sums (and thus the background image) accumulate the decoded samples. Trade-offs, per sample:
+//
+//   encoding  bytes  max error per channel (B,G,R)          max L2 error  model at 4K, N=20
+//   Raw       3      0, 0, 0                                0             498 MB
+//   BGR565    2      4, 2, 4                                6             332 MB
+//   YUV844    2      16, 10, 12 (0 for gray pixels)         22            332 MB
+//   BGR332    1      42, 18, 18                             49            166 MB
+//
+// A sample within the L2 threshold of the input may thus be rejected (or one beyond it accepted)
+// if the input lies within the max L2 error of the threshold sphere. BGR565 is the closest to the
+// raw model (its error is a tenth of the default threshold of 3x20) and has vectorized kernels;
+// YUV844 keeps the luma exact and trades chroma resolution for it (best for near-gray scenes,
+// e.g. IR or low-saturation surveillance footage); BGR332 is only viable with large thresholds.
+//
+// @@@@@@@@
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+namespace lv {
+
+	/// storage formats of the background samples (values are persisted in model snapshots)
+	enum class SampleEncoding : int32_t {
+		/// samples are copies of the input pixels (any channel count & depth)
+		Raw = 0,
+		/// 8-bit 3ch samples packed in 16 bits: 5-bit B, 6-bit G, 5-bit R (from the low bits up)
+		BGR565 = 1,
+		/// 8-bit 3ch samples packed in 16 bits: 8-bit luma, 4-bit B-Y & 4-bit R-Y differences (from the low bits up)
+		YUV844 = 2,
+		/// 8-bit 3ch samples packed in 8 bits: 2-bit B, 3-bit G, 3-bit R (from the low bits up)
+		BGR332 = 3,
+	};
+
+	/// returns the opencv type of the stored samples for input pixels of the given type
+	inline int getEncodedSampleType(SampleEncoding eEncoding, int nPixelType) {
+		if (eEncoding == SampleEncoding::Raw)
+			return nPixelType;
+		CV_Assert(nPixelType == CV_8UC3); // compressed encodings only support 8-bit 3ch pixels
+		return (eEncoding == SampleEncoding::BGR332) ? CV_8UC1 : CV_16UC1;
+	}
+
+	namespace impl {
+
+		/// uniform quantization of 8-bit values to nBits: codes expand back to 8 bits by bit replication (as the vector kernels do),
+		/// and each value maps to the code of its nearest expanded level
+		template<int nBits>
+		struct QuantizationTable {
+			uint8_t anLevels[1 << nBits];
+			uint8_t anCodes[256];
+			constexpr QuantizationTable() : anLevels{}, anCodes{} {
+				for (int c = 0; c < (1 << nBits); ++c) {
+					int nLevel = 0;
+					for (int nShift = 8 - nBits; nShift > -nBits; nShift -= nBits)
+						nLevel |= (nShift >= 0) ? (c << nShift) : (c >> -nShift);
+					anLevels[c] = (uint8_t)nLevel;
+				}
+				for (int v = 0, c = 0; v < 256; ++v) {
+					while (c + 1 < (1 << nBits) && anLevels[c + 1] - v < v - anLevels[c])
+						++c;
+					anCodes[v] = (uint8_t)c;
+				}
+			}
+		};
+		inline constexpr QuantizationTable<2> s_oQuantization2{};
+		inline constexpr QuantizationTable<3> s_oQuantization3{};
+		inline constexpr QuantizationTable<5> s_oQuantization5{};
+		inline constexpr QuantizationTable<6> s_oQuantization6{};
+
+		/// quantization steps of the B-Y & R-Y differences of YUV844 (16 levels each, centered on 0 so that gray pixels are exact)
+		static constexpr int s_nYUV844StepB = 30, s_nYUV844StepR = 24;
+
+		/// B, G & R offsets from the luma for each chroma byte of YUV844 (G is derived from the luma definition)
+		struct YUV844Table {
+			int16_t anOffsets[256][3];
+			constexpr YUV844Table() : anOffsets{} {
+				for (int i = 0; i < 256; ++i) {
+					const int nDiffB = ((i & 15) - 8) * s_nYUV844StepB, nDiffR = ((i >> 4) - 8) * s_nYUV844StepR;
+					const int nWeighted = -(29 * nDiffB + 77 * nDiffR);
+					anOffsets[i][0] = (int16_t)nDiffB;
+					anOffsets[i][1] = (int16_t)((nWeighted >= 0) ? (nWeighted + 75) / 150 : -((-nWeighted + 75) / 150));
+					anOffsets[i][2] = (int16_t)nDiffR;
+				}
+			}
+		};
+		inline constexpr YUV844Table s_oYUV844Table{};
+
+		/// returns n/d rounded to the nearest integer (halves away from zero), clamped to the 4-bit signed range
+		inline int quantizeDiff4(int n, int d) {
+			const int q = (n >= 0) ? (n + d / 2) / d : -((-n + d / 2) / d);
+			return std::min(7, std::max(-8, q));
+		}
+
+	} // namespace impl
+
+	/// identity encoding: samples are stored as copies of the input pixels
+	struct RawEncoding {
+		static constexpr SampleEncoding s_eEncoding = SampleEncoding::Raw;
+		static constexpr bool s_bRaw = true;
+	};
+
+	/// 16-bit BGR565 encoding (see the trade-offs above)
+	struct BGR565Encoding {
+		static constexpr SampleEncoding s_eEncoding = SampleEncoding::BGR565;
+		static constexpr bool s_bRaw = false;
+		typedef uint16_t TCode;
+		static inline TCode encode(const uint8_t* pPixel) {
+			return (TCode)(impl::s_oQuantization5.anCodes[pPixel[0]] | (impl::s_oQuantization6.anCodes[pPixel[1]] << 5) | (impl::s_oQuantization5.anCodes[pPixel[2]] << 11));
+		}
+		static inline void decode(TCode nCode, uint8_t* pPixel) {
+			pPixel[0] = impl::s_oQuantization5.anLevels[nCode & 31];
+			pPixel[1] = impl::s_oQuantization6.anLevels[(nCode >> 5) & 63];
+			pPixel[2] = impl::s_oQuantization5.anLevels[nCode >> 11];
+		}
+	};
+
+	/// 16-bit luma + coarse chroma encoding (see the trade-offs above)
+	struct YUV844Encoding {
+		static constexpr SampleEncoding s_eEncoding = SampleEncoding::YUV844;
+		static constexpr bool s_bRaw = false;
+		typedef uint16_t TCode;
+		static inline TCode encode(const uint8_t* pPixel) {
+			// the luma weights sum to 256, so gray pixels keep their exact value
+			const int nLuma = (29 * pPixel[0] + 150 * pPixel[1] + 77 * pPixel[2] + 128) >> 8;
+			const int nDiffB = impl::quantizeDiff4(pPixel[0] - nLuma, impl::s_nYUV844StepB);
+			const int nDiffR = impl::quantizeDiff4(pPixel[2] - nLuma, impl::s_nYUV844StepR);
+			return (TCode)(nLuma | ((nDiffB + 8) << 8) | ((nDiffR + 8) << 12));
+		}
+		static inline void decode(TCode nCode, uint8_t* pPixel) {
+			const int nLuma = nCode & 255;
+			const int16_t* const pOffsets = impl::s_oYUV844Table.anOffsets[nCode >> 8];
+			for (int c = 0; c < 3; ++c)
+				pPixel[c] = (uint8_t)std::min(255, std::max(0, nLuma + pOffsets[c]));
+		}
+	};
+
+	/// 8-bit BGR332 encoding (see the trade-offs above)
+	struct BGR332Encoding {
+		static constexpr SampleEncoding s_eEncoding = SampleEncoding::BGR332;
+		static constexpr bool s_bRaw = false;
+		typedef uint8_t TCode;
+		static inline TCode encode(const uint8_t* pPixel) {
+			return (TCode)(impl::s_oQuantization2.anCodes[pPixel[0]] | (impl::s_oQuantization3.anCodes[pPixel[1]] << 2) | (impl::s_oQuantization3.anCodes[pPixel[2]] << 5));
+		}
+		static inline void decode(TCode nCode, uint8_t* pPixel) {
+			pPixel[0] = impl::s_oQuantization2.anLevels[nCode & 3];
+			pPixel[1] = impl::s_oQuantization3.anLevels[(nCode >> 2) & 7];
+			pPixel[2] = impl::s_oQuantization3.anLevels[nCode >> 5];
+		}
+	};
+
+	/// returns the pixel values of the sample stored at pSample: raw samples are returned in place, encoded ones are decoded into pBuffer
+	template<typename TSample, typename TEncoding>
+	inline const TSample* readSample(const uint8_t* pSample, TSample* pBuffer) {
+		if constexpr (TEncoding::s_bRaw)
+			return (const TSample*)pSample;
+		else {
+			TEncoding::decode(*(const typename TEncoding::TCode*)pSample, pBuffer);
+			return pBuffer;
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// @@@@@@@@
+//
+// Row-wise ViBe classification kernels; these compare a row of input pixels against the
+// corresponding rows of every background sample and write the resulting 0/255 foreground flags.
+// The row kernels are built in several instruction set variants (scalar, SSE2, SSE4.2, AVX2,
+// AVX-512 & NEON, as supported by the compiler; see 'vibeKernelsImpl.hpp'), and the best one the
+// CPU supports is picked from CPUID on first use, so that a single binary runs on any CPU of its
+// target architecture. All variants produce the exact same masks as the scalar early-exit loop,
+// since the early exit only changes which samples are visited, not whether the required sample
+// count is reached; only the number of samples tested differs, as vector blocks visit samples
+// until all of their pixels are decided.
+//
+// @@@@@@@@
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lv {
+
+	/// instruction set variants of the row kernels
+	enum class KernelIsa {
+		Scalar,
+		SSE2,
+		SSE4_2,
+		AVX2,
+		AVX512,
+		NEON,
+		Count,
+	};
+
+	/// signature of the row classifiers (see classifyRow_3ch)
+	typedef size_t (*ClassifyRowFunc)(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThreshold, size_t nPixels, uint8_t* pFGMask);
+
+	/// row kernels of one instruction set variant
+	struct KernelTable {
+		KernelIsa eIsa;
+		ClassifyRowFunc classifyRow_3ch;
+		ClassifyRowFunc classifyRow_565;
+		ClassifyRowFunc classifyRow_1ch;
+		void (*packMaskRow)(const uint8_t* pFGMask, size_t nPixels, uint64_t* pWords);
+	};
+
+	namespace impl {
+		/// kernel tables of the variants (defined in 'api/src/vibeKernels_*.cpp'; only the scalar one & those the compiler supports are built)
+		extern const KernelTable g_oKernelTable_Scalar, g_oKernelTable_SSE2, g_oKernelTable_SSE4_2, g_oKernelTable_AVX2, g_oKernelTable_AVX512, g_oKernelTable_NEON;
+	}
+
+	/// returns the kernels in use; on first use, the best variant supported by the CPU is picked, unless the BGSVIBE_KERNEL_ISA
+	/// environment variable names another available one (e.g. 'sse2', see getKernelIsaName)
+	const KernelTable& getKernelTable();
+	/// returns the instruction set variant of the kernels in use
+	KernelIsa getKernelIsa();
+	/// returns whether the given variant was built into this binary and is supported by the CPU
+	bool isKernelIsaAvailable(KernelIsa eIsa);
+	/// switches the kernels to the given variant if it is available (all variants produce the same masks, so this can be done at any time);
+	/// returns whether the switch happened
+	bool setKernelIsa(KernelIsa eIsa);
+	/// returns the name of the given variant ('scalar', 'sse2', 'sse4.2', 'avx2', 'avx512' or 'neon')
+	const char* getKernelIsaName(KernelIsa eIsa);
+
+	/// returns the name of the instruction set used by the classification kernels
+	inline const char* getClassificationKernelName() {
+		return getKernelIsaName(getKernelIsa());
+	}
+
+	/// classifies a full row of 8-bit 3ch pixels using squared L2 distances; pSamples points to the first sample of the row's first pixel, pFGMask receives 0/255 flags
+	/// (only rows where the samples of each plane are packed, i.e. nPixelStride == 3, can use the vectorized path); returns the number of
+	/// samples tested, where each vector block counts all its pixels for every sample it visits
+	inline size_t classifyRow_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThresholdSq, size_t nPixels, uint8_t* pFGMask) {
+		return getKernelTable().classifyRow_3ch(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, nThresholdSq, nPixels, pFGMask);
+	}
+
+	/// classifies a full row of 8-bit 3ch pixels against BGR565 samples using squared L2 distances; pSamples points to the first sample
+	/// of the row's first pixel, pFGMask receives 0/255 flags (only rows where the samples of each plane are packed, i.e. nPixelStride == 2,
+	/// can use the vectorized path, which expands the codes to the same planar vectors as raw samples); returns the number of samples tested, as classifyRow_3ch
+	inline size_t classifyRow_565(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThresholdSq, size_t nPixels, uint8_t* pFGMask) {
+		return getKernelTable().classifyRow_565(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, nThresholdSq, nPixels, pFGMask);
+	}
+
+	/// classifies a full row of 8-bit 1ch pixels using L1 distances; pSamples points to the first sample of the row's first pixel, pFGMask receives 0/255 flags
+	/// (only rows where the samples of each plane are packed, i.e. nPixelStride == 1, can use the vectorized path); returns the number of
+	/// samples tested, as classifyRow_3ch
+	inline size_t classifyRow_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThreshold, size_t nPixels, uint8_t* pFGMask) {
+		return getKernelTable().classifyRow_1ch(pInput, pSamples, nSampleStride, nPixelStride, nSamples, nRequired, nThreshold, nPixels, pFGMask);
+	}
+
+	/// packs a row of 0/255 mask flags into bits (bit x%64 of pWords[x/64] is set for foreground pixels; the last word is zero-padded)
+	inline void packMaskRow(const uint8_t* pFGMask, size_t nPixels, uint64_t* pWords) {
+		getKernelTable().packMaskRow(pFGMask, nPixels, pWords);
+	}
+}
@@ -0,0 +1,599 @@
+#pragma once
+
+// @@@@@@@@
+//
+// Bodies of the row kernels declared in 'vibeKernels.hpp'. This header is compiled once per
+// instruction set variant, by a translation unit that defines the matching BGSVIBE_KERNEL_* flag
+// (none for the scalar variant) and is built with that instruction set's compiler flags (see the
+// dispatch variants of 'cmake/checks/simd'); it then defines the variant's kernel table. All the
+// code below has internal linkage, and only the scalar variant calls the inline functions of the
+// public headers (its pixels go through the generic classifier of 'vibeDistances.hpp', and the
+// scalar tail of each vectorized row goes through the scalar variant), so that no copy of a shared
+// function compiled for a newer instruction set can be picked by the linker for the other
+// translation units.
+//
+// @@@@@@@@
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vibeKernels.hpp"
+
+#if defined(BGSVIBE_KERNEL_AVX512) || defined(BGSVIBE_KERNEL_AVX2)
+#include <immintrin.h>
+#elif defined(BGSVIBE_KERNEL_SSE4_2)
+#include <smmintrin.h>
+#elif defined(BGSVIBE_KERNEL_SSE2)
+#include <emmintrin.h>
+#elif defined(BGSVIBE_KERNEL_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(BGSVIBE_KERNEL_AVX512) || defined(BGSVIBE_KERNEL_AVX2) || defined(BGSVIBE_KERNEL_SSE4_2) || defined(BGSVIBE_KERNEL_SSE2) || defined(BGSVIBE_KERNEL_NEON)
+#define BGSVIBE_KERNEL_VECTOR 1
+#else
+#include "vibeDistances.hpp"
+#endif
+
+namespace {
+
+	namespace impl {
+
+#if defined(BGSVIBE_KERNEL_AVX512) || defined(BGSVIBE_KERNEL_AVX2) || defined(BGSVIBE_KERNEL_SSE4_2)
+		/// pshufb masks used to deinterleave 16 packed 3ch pixels, indexed by [output channel][input 16-byte chunk]
+		struct Deinterleave3Masks {
+			alignas(16) int8_t aMasks[3][3][16];
+			constexpr Deinterleave3Masks() : aMasks{} {
+				for (int c = 0; c < 3; ++c)
+					for (int k = 0; k < 3; ++k)
+						for (int i = 0; i < 16; ++i)
+							aMasks[c][k][i] = ((3 * i + c) / 16 == k) ? (int8_t)((3 * i + c) % 16) : (int8_t)-128;
+			}
+		};
+		constexpr Deinterleave3Masks s_oDeinterleave3Masks{};
+#endif
+
+#if defined(BGSVIBE_KERNEL_AVX512)
+
+		/// number of pixels classified per vector iteration
+		static constexpr size_t s_nVecPixels = 64;
+
+		/// deinterleaving masks replicated over the four 128-bit lanes (the masked & zeroing forms of the intrinsics below avoid the
+		/// undefined pass-through operands of their plain forms, which some compilers flag as uninitialized)
+		struct Deinterleave3Masks512 {
+			alignas(64) int8_t aMasks[3][3][64];
+			constexpr Deinterleave3Masks512() : aMasks{} {
+				for (int c = 0; c < 3; ++c)
+					for (int k = 0; k < 3; ++k)
+						for (int i = 0; i < 64; ++i)
+							aMasks[c][k][i] = s_oDeinterleave3Masks.aMasks[c][k][i % 16];
+			}
+		};
+		constexpr Deinterleave3Masks512 s_oDeinterleave3Masks512{};
+
+		/// loads 64 packed 3ch pixels as three planar vectors (lane k holds pixels 16k to 16k+15)
+		inline void loadDeinterleave3(const uint8_t* p, __m512i& c0, __m512i& c1, __m512i& c2) {
+			const auto lGather = [p](size_t nOffset) {
+				const __m256i lo = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(p + nOffset + 48)), _mm_loadu_si128((const __m128i*)(p + nOffset)));
+				const __m256i hi = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(p + nOffset + 144)), _mm_loadu_si128((const __m128i*)(p + nOffset + 96)));
+				return _mm512_mask_broadcast_i64x4(_mm512_castsi256_si512(lo), 0xF0, hi);
+			};
+			const __m512i a0 = lGather(0), a1 = lGather(16), a2 = lGather(32);
+			const auto& m = s_oDeinterleave3Masks512.aMasks;
+			__m512i* const apOut[3] = {&c0, &c1, &c2};
+			for (int c = 0; c < 3; ++c) {
+				*apOut[c] = _mm512_ternarylogic_epi32( // a | b | c
+					_mm512_shuffle_epi8(a0, _mm512_load_si512((const void*)m[c][0])),
+					_mm512_shuffle_epi8(a1, _mm512_load_si512((const void*)m[c][1])),
+					_mm512_shuffle_epi8(a2, _mm512_load_si512((const void*)m[c][2])), 0xFE);
+			}
+		}
+
+		inline __m512i absdiff_u8(__m512i a, __m512i b) {
+			return _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a));
+		}
+
+		/// loads 64 BGR565 codes as three planar vectors of expanded 8-bit values (same lane order as loadDeinterleave3)
+		inline void loadUnpack565(const uint8_t* p, __m512i& c0, __m512i& c1, __m512i& c2) {
+			const __m512i lo = _mm512_loadu_si512((const void*)p), hi = _mm512_loadu_si512((const void*)(p + 64));
+			// packus interleaves the two inputs per 128-bit lane, so qword 2k holds codes 8k to 8k+7 & qword 2k+1 holds codes 32+8k to 39+8k
+			const __m512i vOrder = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+			const auto lExpand = [&]<int nShift, int nBits>() {
+				// bit replication, i.e. (f << (8 - nBits)) | (f >> (2 * nBits - 8)) on each field f
+				const __m512i vMask = _mm512_set1_epi16((1 << nBits) - 1);
+				const __m512i fLo = _mm512_and_si512(_mm512_srli_epi16(lo, nShift), vMask);
+				const __m512i fHi = _mm512_and_si512(_mm512_srli_epi16(hi, nShift), vMask);
+				const __m512i eLo = _mm512_or_si512(_mm512_slli_epi16(fLo, 8 - nBits), _mm512_srli_epi16(fLo, 2 * nBits - 8));
+				const __m512i eHi = _mm512_or_si512(_mm512_slli_epi16(fHi, 8 - nBits), _mm512_srli_epi16(fHi, 2 * nBits - 8));
+				return _mm512_maskz_permutexvar_epi64(0xFF, vOrder, _mm512_packus_epi16(eLo, eHi));
+			};
+			c0 = lExpand.template operator()<0, 5>();
+			c1 = lExpand.template operator()<5, 6>();
+			c2 = lExpand.template operator()<11, 5>();
+		}
+
+		/// returns the lanes where the squared L2 distance between the two planar pixel sets is below the threshold (passed as thr-1)
+		inline __mmask64 matchMask_3ch(const __m512i (&in)[3], const __m512i (&bg)[3], __m512i vThresholdSqM1) {
+			const __m512i zero = _mm512_setzero_si512();
+			__m512i sumLo = zero, sumHi = zero;
+			for (int c = 0; c < 3; ++c) {
+				const __m512i d = absdiff_u8(in[c], bg[c]);
+				const __m512i dLo = _mm512_unpacklo_epi8(d, zero);
+				const __m512i dHi = _mm512_unpackhi_epi8(d, zero);
+				sumLo = _mm512_adds_epu16(sumLo, _mm512_mullo_epi16(dLo, dLo));
+				sumHi = _mm512_adds_epu16(sumHi, _mm512_mullo_epi16(dHi, dHi));
+			}
+			const __m512i mLo = _mm512_movm_epi16(_mm512_cmple_epu16_mask(sumLo, vThresholdSqM1));
+			const __m512i mHi = _mm512_movm_epi16(_mm512_cmple_epu16_mask(sumHi, vThresholdSqM1));
+			return _mm512_movepi8_mask(_mm512_packs_epi16(mLo, mHi));
+		}
+
+		/// classifies 64 consecutive 3ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride); samples are loaded by
+		/// lLoadSamples(pointer, c0, c1, c2) as planar vectors, and the number of samples visited by the block is returned
+		template<typename TLoadFunc>
+		inline size_t classifyBlock_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m512i vRequired, __m512i vRequiredM1, __m512i vThresholdSqM1, uint8_t* pFGMask, TLoadFunc&& lLoadSamples) {
+			__m512i in[3];
+			loadDeinterleave3(pInput, in[0], in[1], in[2]);
+			const __m512i one = _mm512_set1_epi8(1);
+			__m512i vCount = _mm512_setzero_si512();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				__m512i bg[3];
+				lLoadSamples(pSamples + s * nSampleStride, bg[0], bg[1], bg[2]);
+				vCount = _mm512_mask_adds_epu8(vCount, matchMask_3ch(in, bg, vThresholdSqM1), vCount, one);
+				if (_mm512_cmpge_epu8_mask(vCount, vRequired) == ~__mmask64(0))
+					break;
+			}
+			_mm512_storeu_si512((void*)pFGMask, _mm512_movm_epi8(_mm512_cmple_epu8_mask(vCount, vRequiredM1)));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		/// classifies 64 consecutive 1ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride) and returns the number of samples visited
+		inline size_t classifyBlock_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m512i vRequired, __m512i vRequiredM1, __m512i vThresholdM1, uint8_t* pFGMask) {
+			const __m512i in = _mm512_loadu_si512((const void*)pInput);
+			const __m512i one = _mm512_set1_epi8(1);
+			__m512i vCount = _mm512_setzero_si512();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				const __m512i d = absdiff_u8(in, _mm512_loadu_si512((const void*)(pSamples + s * nSampleStride)));
+				vCount = _mm512_mask_adds_epu8(vCount, _mm512_cmple_epu8_mask(d, vThresholdM1), vCount, one);
+				if (_mm512_cmpge_epu8_mask(vCount, vRequired) == ~__mmask64(0))
+					break;
+			}
+			_mm512_storeu_si512((void*)pFGMask, _mm512_movm_epi8(_mm512_cmple_epu8_mask(vCount, vRequiredM1)));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		typedef __m512i VecU8;
+		inline VecU8 setU8(uint8_t v) {return _mm512_set1_epi8((char)v);}
+		inline VecU8 setU16(uint16_t v) {return _mm512_set1_epi16((short)v);}
+
+#elif defined(BGSVIBE_KERNEL_AVX2)
+
+		/// number of pixels classified per vector iteration
+		static constexpr size_t s_nVecPixels = 32;
+
+		/// loads 32 packed 3ch pixels as three planar vectors (lane 0 holds pixels 0-15, lane 1 holds pixels 16-31)
+		inline void loadDeinterleave3(const uint8_t* p, __m256i& c0, __m256i& c1, __m256i& c2) {
+			const __m256i a0 = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(p + 48)), _mm_loadu_si128((const __m128i*)(p)));
+			const __m256i a1 = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(p + 64)), _mm_loadu_si128((const __m128i*)(p + 16)));
+			const __m256i a2 = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)(p + 80)), _mm_loadu_si128((const __m128i*)(p + 32)));
+			const auto& m = s_oDeinterleave3Masks.aMasks;
+			__m256i* const apOut[3] = {&c0, &c1, &c2};
+			for (int c = 0; c < 3; ++c) {
+				*apOut[c] = _mm256_or_si256(_mm256_or_si256(
+					_mm256_shuffle_epi8(a0, _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m[c][0]))),
+					_mm256_shuffle_epi8(a1, _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m[c][1])))),
+					_mm256_shuffle_epi8(a2, _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m[c][2]))));
+			}
+		}
+
+		inline __m256i absdiff_u8(__m256i a, __m256i b) {
+			return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+		}
+
+		/// loads 32 BGR565 codes as three planar vectors of expanded 8-bit values (same lane order as loadDeinterleave3)
+		inline void loadUnpack565(const uint8_t* p, __m256i& c0, __m256i& c1, __m256i& c2) {
+			const __m256i lo = _mm256_loadu_si256((const __m256i*)p), hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+			const auto lExpand = [&]<int nShift, int nBits>() {
+				// bit replication, i.e. (f << (8 - nBits)) | (f >> (2 * nBits - 8)) on each field f
+				const __m256i vMask = _mm256_set1_epi16((1 << nBits) - 1);
+				const __m256i fLo = _mm256_and_si256(_mm256_srli_epi16(lo, nShift), vMask);
+				const __m256i fHi = _mm256_and_si256(_mm256_srli_epi16(hi, nShift), vMask);
+				const __m256i eLo = _mm256_or_si256(_mm256_slli_epi16(fLo, 8 - nBits), _mm256_srli_epi16(fLo, 2 * nBits - 8));
+				const __m256i eHi = _mm256_or_si256(_mm256_slli_epi16(fHi, 8 - nBits), _mm256_srli_epi16(fHi, 2 * nBits - 8));
+				return _mm256_permute4x64_epi64(_mm256_packus_epi16(eLo, eHi), 0xD8);
+			};
+			c0 = lExpand.template operator()<0, 5>();
+			c1 = lExpand.template operator()<5, 6>();
+			c2 = lExpand.template operator()<11, 5>();
+		}
+
+		/// returns 0xFF in every lane where the squared L2 distance between the two planar pixel sets is below the threshold (passed as thr-1)
+		inline __m256i matchMask_3ch(const __m256i (&in)[3], const __m256i (&bg)[3], __m256i vThresholdSqM1) {
+			const __m256i zero = _mm256_setzero_si256();
+			__m256i sumLo = zero, sumHi = zero;
+			for (int c = 0; c < 3; ++c) {
+				const __m256i d = absdiff_u8(in[c], bg[c]);
+				const __m256i dLo = _mm256_unpacklo_epi8(d, zero);
+				const __m256i dHi = _mm256_unpackhi_epi8(d, zero);
+				sumLo = _mm256_adds_epu16(sumLo, _mm256_mullo_epi16(dLo, dLo));
+				sumHi = _mm256_adds_epu16(sumHi, _mm256_mullo_epi16(dHi, dHi));
+			}
+			const __m256i mLo = _mm256_cmpeq_epi16(_mm256_min_epu16(sumLo, vThresholdSqM1), sumLo);
+			const __m256i mHi = _mm256_cmpeq_epi16(_mm256_min_epu16(sumHi, vThresholdSqM1), sumHi);
+			return _mm256_packs_epi16(mLo, mHi);
+		}
+
+		/// classifies 32 consecutive 3ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride); samples are loaded by
+		/// lLoadSamples(pointer, c0, c1, c2) as planar vectors, and the number of samples visited by the block is returned
+		template<typename TLoadFunc>
+		inline size_t classifyBlock_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m256i vRequired, __m256i vRequiredM1, __m256i vThresholdSqM1, uint8_t* pFGMask, TLoadFunc&& lLoadSamples) {
+			__m256i in[3];
+			loadDeinterleave3(pInput, in[0], in[1], in[2]);
+			const __m256i one = _mm256_set1_epi8(1);
+			__m256i vCount = _mm256_setzero_si256();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				__m256i bg[3];
+				lLoadSamples(pSamples + s * nSampleStride, bg[0], bg[1], bg[2]);
+				vCount = _mm256_adds_epu8(vCount, _mm256_and_si256(matchMask_3ch(in, bg, vThresholdSqM1), one));
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(vCount, vRequired), vCount)) == -1)
+					break;
+			}
+			_mm256_storeu_si256((__m256i*)pFGMask, _mm256_cmpeq_epi8(_mm256_min_epu8(vCount, vRequiredM1), vCount));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		/// classifies 32 consecutive 1ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride) and returns the number of samples visited
+		inline size_t classifyBlock_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m256i vRequired, __m256i vRequiredM1, __m256i vThresholdM1, uint8_t* pFGMask) {
+			const __m256i in = _mm256_loadu_si256((const __m256i*)pInput);
+			const __m256i one = _mm256_set1_epi8(1);
+			__m256i vCount = _mm256_setzero_si256();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				const __m256i d = absdiff_u8(in, _mm256_loadu_si256((const __m256i*)(pSamples + s * nSampleStride)));
+				const __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(d, vThresholdM1), d);
+				vCount = _mm256_adds_epu8(vCount, _mm256_and_si256(m, one));
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(vCount, vRequired), vCount)) == -1)
+					break;
+			}
+			_mm256_storeu_si256((__m256i*)pFGMask, _mm256_cmpeq_epi8(_mm256_min_epu8(vCount, vRequiredM1), vCount));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		typedef __m256i VecU8;
+		inline VecU8 setU8(uint8_t v) {return _mm256_set1_epi8((char)v);}
+		inline VecU8 setU16(uint16_t v) {return _mm256_set1_epi16((short)v);}
+
+#elif defined(BGSVIBE_KERNEL_SSE4_2) || defined(BGSVIBE_KERNEL_SSE2)
+
+		/// number of pixels classified per vector iteration
+		static constexpr size_t s_nVecPixels = 16;
+
+		/// loads 16 packed 3ch pixels as three planar vectors
+		inline void loadDeinterleave3(const uint8_t* p, __m128i& c0, __m128i& c1, __m128i& c2) {
+			const __m128i a0 = _mm_loadu_si128((const __m128i*)(p));
+			const __m128i a1 = _mm_loadu_si128((const __m128i*)(p + 16));
+			const __m128i a2 = _mm_loadu_si128((const __m128i*)(p + 32));
+#if defined(BGSVIBE_KERNEL_SSE4_2)
+			const auto& m = s_oDeinterleave3Masks.aMasks;
+			__m128i* const apOut[3] = {&c0, &c1, &c2};
+			for (int c = 0; c < 3; ++c) {
+				*apOut[c] = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(a0, _mm_load_si128((const __m128i*)m[c][0])),
+					_mm_shuffle_epi8(a1, _mm_load_si128((const __m128i*)m[c][1]))),
+					_mm_shuffle_epi8(a2, _mm_load_si128((const __m128i*)m[c][2])));
+			}
+#else
+			// without pshufb, four rounds of byte interleaving between the low half of one vector & the high half of the next one sort the bytes by channel
+			__m128i t0 = a0, t1 = a1, t2 = a2;
+			for (int r = 0; r < 4; ++r) {
+				const __m128i u0 = _mm_unpacklo_epi8(t0, _mm_unpackhi_epi64(t1, t1));
+				const __m128i u1 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t0, t0), t2);
+				const __m128i u2 = _mm_unpacklo_epi8(t1, _mm_unpackhi_epi64(t2, t2));
+				t0 = u0;
+				t1 = u1;
+				t2 = u2;
+			}
+			c0 = t0;
+			c1 = t1;
+			c2 = t2;
+#endif
+		}
+
+		inline __m128i absdiff_u8(__m128i a, __m128i b) {
+			return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+		}
+
+		/// loads 16 BGR565 codes as three planar vectors of expanded 8-bit values
+		inline void loadUnpack565(const uint8_t* p, __m128i& c0, __m128i& c1, __m128i& c2) {
+			const __m128i lo = _mm_loadu_si128((const __m128i*)p), hi = _mm_loadu_si128((const __m128i*)(p + 16));
+			const auto lExpand = [&]<int nShift, int nBits>() {
+				// bit replication, i.e. (f << (8 - nBits)) | (f >> (2 * nBits - 8)) on each field f
+				const __m128i vMask = _mm_set1_epi16((1 << nBits) - 1);
+				const __m128i fLo = _mm_and_si128(_mm_srli_epi16(lo, nShift), vMask);
+				const __m128i fHi = _mm_and_si128(_mm_srli_epi16(hi, nShift), vMask);
+				const __m128i eLo = _mm_or_si128(_mm_slli_epi16(fLo, 8 - nBits), _mm_srli_epi16(fLo, 2 * nBits - 8));
+				const __m128i eHi = _mm_or_si128(_mm_slli_epi16(fHi, 8 - nBits), _mm_srli_epi16(fHi, 2 * nBits - 8));
+				return _mm_packus_epi16(eLo, eHi);
+			};
+			c0 = lExpand.template operator()<0, 5>();
+			c1 = lExpand.template operator()<5, 6>();
+			c2 = lExpand.template operator()<11, 5>();
+		}
+
+		/// returns 0xFF in every lane where the squared L2 distance between the two planar pixel sets is below the threshold (passed as thr-1)
+		inline __m128i matchMask_3ch(const __m128i (&in)[3], const __m128i (&bg)[3], __m128i vThresholdSqM1) {
+			const __m128i zero = _mm_setzero_si128();
+			__m128i sumLo = zero, sumHi = zero;
+			for (int c = 0; c < 3; ++c) {
+				const __m128i d = absdiff_u8(in[c], bg[c]);
+				const __m128i dLo = _mm_unpacklo_epi8(d, zero);
+				const __m128i dHi = _mm_unpackhi_epi8(d, zero);
+				sumLo = _mm_adds_epu16(sumLo, _mm_mullo_epi16(dLo, dLo));
+				sumHi = _mm_adds_epu16(sumHi, _mm_mullo_epi16(dHi, dHi));
+			}
+			// sum <= thr-1 iff the saturated difference is zero (SSE2 has no unsigned 16-bit min)
+			const __m128i mLo = _mm_cmpeq_epi16(_mm_subs_epu16(sumLo, vThresholdSqM1), zero);
+			const __m128i mHi = _mm_cmpeq_epi16(_mm_subs_epu16(sumHi, vThresholdSqM1), zero);
+			return _mm_packs_epi16(mLo, mHi);
+		}
+
+		/// classifies 16 consecutive 3ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride); samples are loaded by
+		/// lLoadSamples(pointer, c0, c1, c2) as planar vectors, and the number of samples visited by the block is returned
+		template<typename TLoadFunc>
+		inline size_t classifyBlock_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m128i vRequired, __m128i vRequiredM1, __m128i vThresholdSqM1, uint8_t* pFGMask, TLoadFunc&& lLoadSamples) {
+			__m128i in[3];
+			loadDeinterleave3(pInput, in[0], in[1], in[2]);
+			const __m128i one = _mm_set1_epi8(1);
+			__m128i vCount = _mm_setzero_si128();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				__m128i bg[3];
+				lLoadSamples(pSamples + s * nSampleStride, bg[0], bg[1], bg[2]);
+				vCount = _mm_adds_epu8(vCount, _mm_and_si128(matchMask_3ch(in, bg, vThresholdSqM1), one));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(vCount, vRequired), vCount)) == 0xFFFF)
+					break;
+			}
+			_mm_storeu_si128((__m128i*)pFGMask, _mm_cmpeq_epi8(_mm_min_epu8(vCount, vRequiredM1), vCount));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		/// classifies 16 consecutive 1ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride) and returns the number of samples visited
+		inline size_t classifyBlock_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, __m128i vRequired, __m128i vRequiredM1, __m128i vThresholdM1, uint8_t* pFGMask) {
+			const __m128i in = _mm_loadu_si128((const __m128i*)pInput);
+			const __m128i one = _mm_set1_epi8(1);
+			__m128i vCount = _mm_setzero_si128();
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				const __m128i d = absdiff_u8(in, _mm_loadu_si128((const __m128i*)(pSamples + s * nSampleStride)));
+				const __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(d, vThresholdM1), d);
+				vCount = _mm_adds_epu8(vCount, _mm_and_si128(m, one));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(vCount, vRequired), vCount)) == 0xFFFF)
+					break;
+			}
+			_mm_storeu_si128((__m128i*)pFGMask, _mm_cmpeq_epi8(_mm_min_epu8(vCount, vRequiredM1), vCount));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		typedef __m128i VecU8;
+		inline VecU8 setU8(uint8_t v) {return _mm_set1_epi8((char)v);}
+		inline VecU8 setU16(uint16_t v) {return _mm_set1_epi16((short)v);}
+
+#elif defined(BGSVIBE_KERNEL_NEON)
+
+		/// number of pixels classified per vector iteration
+		static constexpr size_t s_nVecPixels = 16;
+
+		/// returns the smallest lane value of the given vector
+		inline uint8_t hmin_u8(uint8x16_t v) {
+#if defined(__aarch64__)
+			return vminvq_u8(v);
+#else
+			uint8x8_t m = vpmin_u8(vget_low_u8(v), vget_high_u8(v));
+			m = vpmin_u8(m, m);
+			m = vpmin_u8(m, m);
+			m = vpmin_u8(m, m);
+			return vget_lane_u8(m, 0);
+#endif
+		}
+
+		/// loads 16 packed 3ch pixels as three planar vectors
+		inline void loadDeinterleave3(const uint8_t* p, uint8x16_t& c0, uint8x16_t& c1, uint8x16_t& c2) {
+			const uint8x16x3_t v = vld3q_u8(p);
+			c0 = v.val[0];
+			c1 = v.val[1];
+			c2 = v.val[2];
+		}
+
+		/// loads 16 BGR565 codes as three planar vectors of expanded 8-bit values
+		inline void loadUnpack565(const uint8_t* p, uint8x16_t& c0, uint8x16_t& c1, uint8x16_t& c2) {
+			const uint16x8_t lo = vld1q_u16((const uint16_t*)p), hi = vld1q_u16((const uint16_t*)(p + 16));
+			const auto lExpand = [&]<int nShift, int nBits>() {
+				// bit replication, i.e. (f << (8 - nBits)) | (f >> (2 * nBits - 8)) on each field f (NEON immediate shifts must be >= 1)
+				const uint16x8_t vMask = vdupq_n_u16((1 << nBits) - 1);
+				uint16x8_t fLo = lo, fHi = hi;
+				if constexpr (nShift > 0) {
+					fLo = vshrq_n_u16(fLo, nShift);
+					fHi = vshrq_n_u16(fHi, nShift);
+				}
+				fLo = vandq_u16(fLo, vMask);
+				fHi = vandq_u16(fHi, vMask);
+				const uint16x8_t eLo = vorrq_u16(vshlq_n_u16(fLo, 8 - nBits), vshrq_n_u16(fLo, 2 * nBits - 8));
+				const uint16x8_t eHi = vorrq_u16(vshlq_n_u16(fHi, 8 - nBits), vshrq_n_u16(fHi, 2 * nBits - 8));
+				return vcombine_u8(vmovn_u16(eLo), vmovn_u16(eHi));
+			};
+			c0 = lExpand.template operator()<0, 5>();
+			c1 = lExpand.template operator()<5, 6>();
+			c2 = lExpand.template operator()<11, 5>();
+		}
+
+		/// returns 0xFF in every lane where the squared L2 distance between the two planar pixel sets is below the threshold (passed as thr-1)
+		inline uint8x16_t matchMask_3ch(const uint8x16x3_t& in, const uint8x16x3_t& bg, uint16x8_t vThresholdSqM1) {
+			uint16x8_t sumLo = vdupq_n_u16(0), sumHi = vdupq_n_u16(0);
+			for (int c = 0; c < 3; ++c) {
+				const uint8x16_t d = vabdq_u8(in.val[c], bg.val[c]);
+				sumLo = vqaddq_u16(sumLo, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+				sumHi = vqaddq_u16(sumHi, vmull_u8(vget_high_u8(d), vget_high_u8(d)));
+			}
+			return vcombine_u8(vmovn_u16(vcleq_u16(sumLo, vThresholdSqM1)), vmovn_u16(vcleq_u16(sumHi, vThresholdSqM1)));
+		}
+
+		/// classifies 16 consecutive 3ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride); samples are loaded by
+		/// lLoadSamples(pointer, c0, c1, c2) as planar vectors, and the number of samples visited by the block is returned
+		template<typename TLoadFunc>
+		inline size_t classifyBlock_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, uint8x16_t vRequired, uint8x16_t vRequiredM1, uint16x8_t vThresholdSqM1, uint8_t* pFGMask, TLoadFunc&& lLoadSamples) {
+			const uint8x16x3_t in = vld3q_u8(pInput);
+			const uint8x16_t one = vdupq_n_u8(1);
+			const uint8_t nRequired = vgetq_lane_u8(vRequired, 0);
+			uint8x16_t vCount = vdupq_n_u8(0);
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				uint8x16x3_t bg;
+				lLoadSamples(pSamples + s * nSampleStride, bg.val[0], bg.val[1], bg.val[2]);
+				vCount = vqaddq_u8(vCount, vandq_u8(matchMask_3ch(in, bg, vThresholdSqM1), one));
+				if (hmin_u8(vCount) >= nRequired)
+					break;
+			}
+			vst1q_u8(pFGMask, vcleq_u8(vCount, vRequiredM1));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		/// classifies 16 consecutive 1ch pixels (sample s of the first pixel is at pSamples + s * nSampleStride) and returns the number of samples visited
+		inline size_t classifyBlock_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride,
+			size_t nSamples, uint8x16_t vRequired, uint8x16_t vRequiredM1, uint8x16_t vThresholdM1, uint8_t* pFGMask) {
+			const uint8x16_t in = vld1q_u8(pInput);
+			const uint8x16_t one = vdupq_n_u8(1);
+			const uint8_t nRequired = vgetq_lane_u8(vRequired, 0);
+			uint8x16_t vCount = vdupq_n_u8(0);
+			size_t s = 0;
+			for (; s < nSamples; ++s) {
+				const uint8x16_t d = vabdq_u8(in, vld1q_u8(pSamples + s * nSampleStride));
+				vCount = vqaddq_u8(vCount, vandq_u8(vcleq_u8(d, vThresholdM1), one));
+				if (hmin_u8(vCount) >= nRequired)
+					break;
+			}
+			vst1q_u8(pFGMask, vcleq_u8(vCount, vRequiredM1));
+			return (s < nSamples) ? s + 1 : nSamples;
+		}
+
+		typedef uint8x16_t VecU8;
+		inline VecU8 setU8(uint8_t v) {return vdupq_n_u8(v);}
+		inline uint16x8_t setU16(uint16_t v) {return vdupq_n_u16(v);}
+
+#endif
+
+	} // namespace impl
+
+	size_t classifyRow_3ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThresholdSq, size_t nPixels, uint8_t* pFGMask) {
+#if defined(BGSVIBE_KERNEL_VECTOR)
+		size_t x = 0, nTests = 0;
+		// saturated 16-bit distance sums and 8-bit match counters bound the cases the vector path can reproduce exactly
+		if (nPixelStride == 3 && nRequired > 0 && nRequired <= UINT8_MAX && nThresholdSq > 0 && nThresholdSq <= UINT16_MAX) {
+			const auto vRequired = impl::setU8((uint8_t)nRequired);
+			const auto vRequiredM1 = impl::setU8((uint8_t)(nRequired - 1));
+			const auto vThresholdSqM1 = impl::setU16((uint16_t)(nThresholdSq - 1));
+			for (; x + impl::s_nVecPixels <= nPixels; x += impl::s_nVecPixels)
+				nTests += impl::s_nVecPixels * impl::classifyBlock_3ch(pInput + x * 3, pSamples + x * 3, nSampleStride, nSamples, vRequired, vRequiredM1, vThresholdSqM1, pFGMask + x,
+					[](const uint8_t* p, auto& c0, auto& c1, auto& c2) {impl::loadDeinterleave3(p, c0, c1, c2);});
+		}
+		if (x < nPixels)
+			nTests += lv::impl::g_oKernelTable_Scalar.classifyRow_3ch(pInput + x * 3, pSamples + x * nPixelStride, nSampleStride, nPixelStride, nSamples, nRequired, nThresholdSq, nPixels - x, pFGMask + x);
+		return nTests;
+#else
+		const lv::L2SqrDistance::Params oParams{nThresholdSq};
+		size_t nTests = 0;
+		for (size_t x = 0; x < nPixels; ++x)
+			pFGMask[x] = lv::classifyPixel<3, uint8_t, lv::L2SqrDistance>(pInput + x * 3, pSamples + x * nPixelStride, nSampleStride, nSamples, nRequired, oParams, nTests);
+		return nTests;
+#endif
+	}
+
+	size_t classifyRow_565(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThresholdSq, size_t nPixels, uint8_t* pFGMask) {
+#if defined(BGSVIBE_KERNEL_VECTOR)
+		size_t x = 0, nTests = 0;
+		if (nPixelStride == 2 && nRequired > 0 && nRequired <= UINT8_MAX && nThresholdSq > 0 && nThresholdSq <= UINT16_MAX) {
+			const auto vRequired = impl::setU8((uint8_t)nRequired);
+			const auto vRequiredM1 = impl::setU8((uint8_t)(nRequired - 1));
+			const auto vThresholdSqM1 = impl::setU16((uint16_t)(nThresholdSq - 1));
+			for (; x + impl::s_nVecPixels <= nPixels; x += impl::s_nVecPixels)
+				nTests += impl::s_nVecPixels * impl::classifyBlock_3ch(pInput + x * 3, pSamples + x * 2, nSampleStride, nSamples, vRequired, vRequiredM1, vThresholdSqM1, pFGMask + x,
+					[](const uint8_t* p, auto& c0, auto& c1, auto& c2) {impl::loadUnpack565(p, c0, c1, c2);});
+		}
+		if (x < nPixels)
+			nTests += lv::impl::g_oKernelTable_Scalar.classifyRow_565(pInput + x * 3, pSamples + x * nPixelStride, nSampleStride, nPixelStride, nSamples, nRequired, nThresholdSq, nPixels - x, pFGMask + x);
+		return nTests;
+#else
+		const lv::L2SqrDistance::Params oParams{nThresholdSq};
+		size_t nTests = 0;
+		for (size_t x = 0; x < nPixels; ++x)
+			pFGMask[x] = lv::classifyPixel<3, uint8_t, lv::L2SqrDistance, lv::BGR565Encoding>(pInput + x * 3, pSamples + x * nPixelStride, nSampleStride, nSamples, nRequired, oParams, nTests);
+		return nTests;
+#endif
+	}
+
+	size_t classifyRow_1ch(const uint8_t* pInput, const uint8_t* pSamples, size_t nSampleStride, size_t nPixelStride,
+		size_t nSamples, size_t nRequired, size_t nThreshold, size_t nPixels, uint8_t* pFGMask) {
+#if defined(BGSVIBE_KERNEL_VECTOR)
+		size_t x = 0, nTests = 0;
+		if (nPixelStride == 1 && nRequired > 0 && nRequired <= UINT8_MAX && nThreshold > 0 && nThreshold <= UINT8_MAX) {
+			const auto vRequired = impl::setU8((uint8_t)nRequired);
+			const auto vRequiredM1 = impl::setU8((uint8_t)(nRequired - 1));
+			const auto vThresholdM1 = impl::setU8((uint8_t)(nThreshold - 1));
+			for (; x + impl::s_nVecPixels <= nPixels; x += impl::s_nVecPixels)
+				nTests += impl::s_nVecPixels * impl::classifyBlock_1ch(pInput + x, pSamples + x, nSampleStride, nSamples, vRequired, vRequiredM1, vThresholdM1, pFGMask + x);
+		}
+		if (x < nPixels)
+			nTests += lv::impl::g_oKernelTable_Scalar.classifyRow_1ch(pInput + x, pSamples + x * nPixelStride, nSampleStride, nPixelStride, nSamples, nRequired, nThreshold, nPixels - x, pFGMask + x);
+		return nTests;
+#else
+		const lv::L1Distance::Params oParams{nThreshold};
+		size_t nTests = 0;
+		for (size_t x = 0; x < nPixels; ++x)
+			pFGMask[x] = lv::classifyPixel<1, uint8_t, lv::L1Distance>(pInput + x, pSamples + x * nPixelStride, nSampleStride, nSamples, nRequired, oParams, nTests);
+		return nTests;
+#endif
+	}
+
+	void packMaskRow(const uint8_t* pFGMask, size_t nPixels, uint64_t* pWords) {
+		size_t x = 0;
+#if defined(BGSVIBE_KERNEL_AVX512)
+		for (; x + 64 <= nPixels; x += 64)
+			pWords[x / 64] = (uint64_t)_mm512_movepi8_mask(_mm512_loadu_si512((const void*)(pFGMask + x)));
+#elif defined(BGSVIBE_KERNEL_AVX2)
+		for (; x + 64 <= nPixels; x += 64) {
+			const uint32_t nLow = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(pFGMask + x)));
+			const uint32_t nHigh = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(pFGMask + x + 32)));
+			pWords[x / 64] = nLow | ((uint64_t)nHigh << 32);
+		}
+#elif defined(BGSVIBE_KERNEL_SSE4_2) || defined(BGSVIBE_KERNEL_SSE2)
+		for (; x + 64 <= nPixels; x += 64) {
+			uint64_t nWord = 0;
+			for (size_t k = 0; k < 4; ++k)
+				nWord |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(pFGMask + x + k * 16))) << (k * 16);
+			pWords[x / 64] = nWord;
+		}
+#endif
+		for (; x < nPixels; x += 64) {
+			uint64_t nWord = 0;
+			for (size_t i = 0; i < 64 && x + i < nPixels; ++i)
+				nWord |= (uint64_t)(pFGMask[x + i] >> 7) << i;
+			pWords[x / 64] = nWord;
+		}
+	}
+
+	/// returns the kernel table of this variant
+	constexpr lv::KernelTable makeKernelTable(lv::KernelIsa eIsa) {
+		return lv::KernelTable{eIsa, &classifyRow_3ch, &classifyRow_565, &classifyRow_1ch, &packMaskRow};
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+// @@@@@@@@
+//
+// Hot-path instrumentation of the ViBe subtractor. The hooks are compiled in by defining
+// BGSVIBE_ENABLE_METRICS (exported by the USE_METRICS option of the root CMakeLists); without it,
+// they are empty inline functions and the per-pixel loops are exactly the uninstrumented ones.
+// Counters are kept per stripe (the parallel work unit), so they are only ever written by the
+// single task processing that stripe, and are merged by the thread that called apply once the
+// frame is done; the instrumentation therefore needs no atomic operation nor lock per pixel.
+//
+// @@@@@@@@
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#if defined(BGSVIBE_ENABLE_METRICS)
+#define BGSVIBE_METRICS_ENABLED 1
+#else
+#define BGSVIBE_METRICS_ENABLED 0
+#endif
+
+namespace lv {
+
+	/// returns a monotonic timestamp in nanoseconds when metrics are compiled in, and 0 otherwise
+	inline uint64_t metricsNow() {
+		if constexpr (BGSVIBE_METRICS_ENABLED)
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		else
+			return 0;
+	}
+
+	/// latency histogram with power-of-two buckets (bucket b holds durations in [2^b,2^(b+1)) ns)
+	struct LatencyHistogram {
+		static constexpr size_t s_nBuckets{40};
+
+		std::array<uint64_t, s_nBuckets> anCounts{};
+		uint64_t nCount{0};
+		uint64_t nTotalNs{0};
+		uint64_t nMaxNs{0};
+
+		inline void add(uint64_t nNs) {
+			++anCounts[std::min<size_t>(s_nBuckets - 1, (size_t)std::max(1, (int)std::bit_width(nNs)) - 1)];
+			++nCount;
+			nTotalNs += nNs;
+			nMaxNs = std::max(nMaxNs, nNs);
+		}
+		inline void merge(const LatencyHistogram& oOther) {
+			for (size_t b = 0; b < s_nBuckets; ++b)
+				anCounts[b] += oOther.anCounts[b];
+			nCount += oOther.nCount;
+			nTotalNs += oOther.nTotalNs;
+			nMaxNs = std::max(nMaxNs, oOther.nMaxNs);
+		}
+		inline double meanNs() const {return nCount ? (double)nTotalNs / nCount : 0;}
+		/// returns an upper bound of the given percentile (in [0,1]), i.e. the end of the bucket that contains it
+		inline uint64_t percentileNs(double dPercentile) const {
+			const uint64_t nTarget = (uint64_t)(dPercentile * nCount);
+			uint64_t nSeen = 0;
+			for (size_t b = 0; b < s_nBuckets; ++b) {
+				nSeen += anCounts[b];
+				if (nSeen > nTarget)
+					return std::min(nMaxNs, (uint64_t(2) << b) - 1);
+			}
+			return nMaxNs;
+		}
+	};
+}
+
+/// counters & timings of one stripe for the current frame; only the task processing the stripe writes them
+struct ViBeStripeMetrics {
+    enum class Counter {
+        /// pixels classified by the row kernels
+        ClassifiedPixels,
+        /// pixels left as foreground in the final mask
+        ForegroundPixels,
+        /// samples replaced by the pixel itself
+        SelfUpdates,
+        /// samples replaced in a neighbor of the pixel (propagation)
+        NeighborUpdates,
+        /// pixels re-classified because a propagation changed their samples after their row was classified
+        ReclassifiedPixels,
+        /// pixels whose classification was skipped by the change gating (unchanged background tiles)
+        GatedPixels,
+        /// samples tested by the classification of the classified & re-classified pixels (vector blocks count all their pixels for every
+        /// sample they visit)
+        SampleTests,
+        Count,
+    };
+    enum class Phase {
+        /// row classification kernels
+        Classify,
+        /// model update pass (including neighbor propagation)
+        Update,
+        /// whole stripe
+        Stripe,
+        Count,
+    };
+
+    std::array<uint64_t, (size_t)Counter::Count> anCounters{};
+    std::array<uint64_t, (size_t)Phase::Count> anPhaseNs{};
+
+    inline void add(Counter eCounter, uint64_t nValue = 1) {
+        if constexpr (BGSVIBE_METRICS_ENABLED)
+            anCounters[(size_t)eCounter] += nValue;
+    }
+    inline void addTime(Phase ePhase, uint64_t nStartNs) {
+        if constexpr (BGSVIBE_METRICS_ENABLED)
+            anPhaseNs[(size_t)ePhase] += lv::metricsNow() - nStartNs;
+    }
+    /// counts the foreground pixels of a mask row
+    inline void addForeground(const uint8_t* pFGMaskRow, int nWidth) {
+        if constexpr (BGSVIBE_METRICS_ENABLED) {
+            uint64_t nForeground = 0;
+            for (int x = 0; x < nWidth; ++x)
+                nForeground += (pFGMaskRow[x] != 0);
+            anCounters[(size_t)Counter::ForegroundPixels] += nForeground;
+        }
+    }
+};
+
+/// accumulated metrics of a subtractor, as returned by BackgroundSubtractorViBe::getMetrics (all zero if compiled out)
+struct ViBeMetrics {
+    /// defines whether the hot-path hooks were compiled in
+    static constexpr bool s_bEnabled{BGSVIBE_METRICS_ENABLED};
+
+    uint64_t nFrames{0};
+    /// totals of each ViBeStripeMetrics::Counter
+    std::array<uint64_t, (size_t)ViBeStripeMetrics::Counter::Count> anCounters{};
+    /// duration of whole apply/applyParallel calls
+    lv::LatencyHistogram oFrameLatency;
+    /// classification & update time per frame, summed over all stripes (i.e. cpu time)
+    lv::LatencyHistogram oClassifyTime, oUpdateTime;
+    /// duration of each stripe task (parallel path only)
+    lv::LatencyHistogram oStripeLatency;
+    /// ratio of the slowest stripe to the mean stripe duration, for the last frame & at worst (parallel path only; 1 = balanced)
+    double dLastStripeImbalance{0};
+    double dMaxStripeImbalance{0};
+    /// foreground pixels over classified pixels, for the last frame
+    double dLastForegroundRatio{0};
+
+    /// returns the total of the given counter
+    inline uint64_t get(ViBeStripeMetrics::Counter eCounter) const {return anCounters[(size_t)eCounter];}
+    /// returns the average number of samples tested per classified (or re-classified) pixel
+    inline double samplesTestedPerPixel() const {
+        const uint64_t nPixels = get(ViBeStripeMetrics::Counter::ClassifiedPixels) + get(ViBeStripeMetrics::Counter::ReclassifiedPixels);
+        return nPixels ? (double)get(ViBeStripeMetrics::Counter::SampleTests) / nPixels : 0;
+    }
+    /// prints a human-readable summary
+    void print(std::ostream& os) const;
+};
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <array>
+#include <cstring>
 #include <iostream>
 #include <typeinfo>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -35,9 +41,10 @@ namespace lv {
 	/// returns the sampling location for the specified random index & original pixel location, given a predefined kernel; also guards against out-of-bounds values via image/border size check
 	template<int nKernelHeight, int nKernelWidth>
 	inline void getSamplePosition(const std::array<std::array<int, nKernelWidth>, nKernelHeight>& anSamplesInitPattern,
-		const int nSamplesInitPatternTot, const int nRandIdx, int& nSampleCoord_X, int& nSampleCoord_Y,
+		const int nSamplesInitPatternTot, const uint32_t nRandIdx, int& nSampleCoord_X, int& nSampleCoord_Y,
 		const int nOrigCoord_X, const int nOrigCoord_Y, const cv::Size& oImageSize) {
-		int r = 1 + (nRandIdx % nSamplesInitPatternTot);
+		// the index must wrap as an unsigned value; a negative remainder would always select the kernel's top-left cell
+		int r = 1 + (int)(nRandIdx % (uint32_t)nSamplesInitPatternTot);
 		for (nSampleCoord_Y = 0; nSampleCoord_Y < nKernelHeight; ++nSampleCoord_Y) {
 			for (nSampleCoord_X = 0; nSampleCoord_X < nKernelWidth; ++nSampleCoord_X) {
 				r -= anSamplesInitPattern[nSampleCoord_Y][nSampleCoord_X];
@@ -51,22 +58,58 @@ namespace lv {
 		clampImageCoords(nSampleCoord_X, nSampleCoord_Y, oImageSize);
 	}
 
+	/// based on 'floor(fspecial('gaussian',7,2)*512)'; the weights sum to 512
+	static const std::array<std::array<int, 7>, 7> s_anSamplesInitPattern_7x7_std2 = {
+			std::array<int,7>{ 2, 4, 6, 7, 6, 4, 2,},
+			std::array<int,7>{ 4, 8,12,14,12, 8, 4,},
+			std::array<int,7>{ 6,12,21,25,21,12, 6,},
+			std::array<int,7>{ 7,14,25,28,25,14, 7,},
+			std::array<int,7>{ 6,12,21,25,21,12, 6,},
+			std::array<int,7>{ 4, 8,12,14,12, 8, 4,},
+			std::array<int,7>{ 2, 4, 6, 7, 6, 4, 2,},
+	};
+
 	/// returns the sampling location for the specified random index & original pixel location; also guards against out-of-bounds values via image/border size check
-	inline void getSamplePosition_7x7_std2(const int nRandIdx, int& nSampleCoord_X, int& nSampleCoord_Y,
+	inline void getSamplePosition_7x7_std2(const uint32_t nRandIdx, int& nSampleCoord_X, int& nSampleCoord_Y,
 		const int nOrigCoord_X, const int nOrigCoord_Y,
 		const int nBorderSize, const cv::Size& oImageSize) {
-		// based on 'floor(fspecial('gaussian',7,2)*512)'
-		static const int s_nSamplesInitPatternTot = 512;
-		static const std::array<std::array<int, 7>, 7> s_anSamplesInitPattern = {
-				std::array<int,7>{ 2, 4, 6, 7, 6, 4, 2,},
-				std::array<int,7>{ 4, 8,12,14,12, 8, 4,},
-				std::array<int,7>{ 6,12,21,25,21,12, 6,},
-				std::array<int,7>{ 7,14,25,28,25,14, 7,},
-				std::array<int,7>{ 6,12,21,25,21,12, 6,},
-				std::array<int,7>{ 4, 8,12,14,12, 8, 4,},
-				std::array<int,7>{ 2, 4, 6, 7, 6, 4, 2,},
-		};
-		getSamplePosition<7, 7>(s_anSamplesInitPattern, s_nSamplesInitPatternTot, nRandIdx, nSampleCoord_X, nSampleCoord_Y, nOrigCoord_X, nOrigCoord_Y, oImageSize);
+		getSamplePosition<7, 7>(s_anSamplesInitPattern_7x7_std2, 512, nRandIdx, nSampleCoord_X, nSampleCoord_Y, nOrigCoord_X, nOrigCoord_Y, oImageSize);
+	}
+
+	/// direct-map version of the 7x7 sampling pattern: entry (nRandIdx & 511) holds the (x,y) offset that getSamplePosition_7x7_std2
+	/// would select for nRandIdx, so the pattern does not need to be scanned per sample
+	inline const std::array<std::array<int8_t, 2>, 512>& getSampleOffsetTable_7x7_std2() {
+		static const std::array<std::array<int8_t, 2>, 512> s_anOffsets = []() {
+			std::array<std::array<int8_t, 2>, 512> anOffsets;
+			size_t nIdx = 0;
+			for (int y = 0; y < 7; ++y)
+				for (int x = 0; x < 7; ++x)
+					for (int n = 0; n < s_anSamplesInitPattern_7x7_std2[y][x]; ++n)
+						anOffsets[nIdx++] = {(int8_t)(x - 3), (int8_t)(y - 3)};
+			return anOffsets;
+		}();
+		return s_anOffsets;
+	}
+
+	/// copies nBytes from pSrc to pDst with non-temporal stores where possible (for buffers written once & read much later, so they
+	/// do not evict the working set nor get read for ownership); call streamFence before other threads read the destination
+	inline void copyNonTemporal(uchar* pDst, const uchar* pSrc, size_t nBytes) {
+#if defined(__SSE2__)
+		size_t i = std::min(nBytes, (size_t)((16 - ((uintptr_t)pDst & 15)) & 15));
+		memcpy(pDst, pSrc, i);
+		for (; i + 16 <= nBytes; i += 16)
+			_mm_stream_si128((__m128i*)(pDst + i), _mm_loadu_si128((const __m128i*)(pSrc + i)));
+		memcpy(pDst + i, pSrc + i, nBytes - i);
+#else
+		memcpy(pDst, pSrc, nBytes);
+#endif
+	}
+
+	/// orders all previous non-temporal stores before the following stores
+	inline void streamFence() {
+#if defined(__SSE2__)
+		_mm_sfence();
+#endif
 	}
 
 	// /// returns the neighbor location for the specified random index & original pixel location, given a predefined neighborhood; also guards against out-of-bounds values via image/border size check
@@ -18,272 +18,812 @@
 #include "BackgroundSubtractorViBe.hpp"
 #include "vibeUtils.hpp"
 
-#include <execution>
+#include <algorithm>
+#include <fstream>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+	/// model size above which the initialization writes the samples with streaming stores (smaller models stay cached for the first frame)
+	constexpr size_t s_nStreamingInitMinBytes = size_t(32) << 20;
+
+	/// returns the size of the L2 cache (per core) in bytes, or a conservative default if it cannot be queried
+	size_t getL2CacheSize() {
+		static const size_t s_nL2CacheSize = []() -> size_t {
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+			const long nSysconfSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+			if (nSysconfSize > 0)
+				return (size_t)nSysconfSize;
+#endif
+#if defined(__linux__)
+			// some libcs do not report cache sizes through sysconf
+			std::ifstream oFile("/sys/devices/system/cpu/cpu0/cache/index2/size");
+			size_t nSize = 0;
+			char cUnit = 0;
+			if (oFile >> nSize && nSize > 0) {
+				if (oFile >> cUnit)
+					nSize <<= (cUnit == 'K') ? 10 : (cUnit == 'M') ? 20 : 0;
+				return nSize;
+			}
+#endif
+			return size_t(256) << 10;
+		}();
+		return s_nL2CacheSize;
+	}
+}
+
 
 BackgroundSubtractorViBe::BackgroundSubtractorViBe(size_t nColorDistThreshold, 
 		size_t nBGSamples, 
 		size_t nRequiredBGSamples,
-        size_t learningRate) :
+        size_t learningRate,
+		SampleModel::Layout eModelLayout,
+		UpdateMode eUpdateMode,
+		lv::SampleEncoding eSampleEncoding) :
 	m_nBGSamples(nBGSamples),
 	m_nRequiredBGSamples(nRequiredBGSamples),
-	m_voBGImg(nBGSamples),
+	m_oBGModel(eModelLayout),
+	m_eSampleEncoding(eSampleEncoding),
+	m_nProcessingScale(1),
+	m_nInputChannelOffset(0),
 	m_nColorDistThreshold(nColorDistThreshold),
 	m_learningRate(learningRate),
-	m_bInitialized(false) {}
-
-BackgroundSubtractorViBe::~BackgroundSubtractorViBe() {}
+	m_oParams{nColorDistThreshold, nRequiredBGSamples, learningRate},
+	m_bParamsPending(false),
+	m_bInitialized(false),
+	m_nRandomSeed(Pcg32::s_nDefaultSeed),
+	m_oRNG(m_nRandomSeed),
+	m_eUpdateMode(eUpdateMode),
+	m_nSnapshotInterval(0),
+	m_nSnapshotCopySteps(8),
+	m_nFramesSinceSnapshot(0),
+	m_nSnapshotCopiedSlices(0),
+	m_bSnapshotWriting(false),
+	m_nMetricsInterval(0),
+	m_nRequestedTileWidth(0),
+	m_nTileWidth(0),
+	m_nGatingTileSize(0),
+	m_nGatingMaxDiff(0),
+	m_nGatingMaxSkippedFrames(0),
+	m_nGatingTilesX(0),
+	m_bReorderSamples(false) {}
+
+BackgroundSubtractorViBe::~BackgroundSubtractorViBe() {
+	if (m_oSnapshotWriter.joinable())
+		m_oSnapshotWriter.join();
+}
 
 void BackgroundSubtractorViBe::getBackgroundImage(cv::Mat& backgroundImage) const {
-	cv::Mat oAvgBGImg = cv::Mat::zeros(m_oImgSize, CV_32FC(m_voBGImg[0].channels()));
-	for (size_t n = 0; n < m_nBGSamples; ++n) {
-		for (int y = 0; y < m_oImgSize.height; ++y) {
-			for (int x = 0; x < m_oImgSize.width; ++x) {
-				const size_t idx_uchar = m_voBGImg[n].step.p[0] * y + m_voBGImg[n].step.p[1] * x;
-				const size_t idx_flt32 = idx_uchar * 4;
-				float* oAvgBgImgPtr = (float*)(oAvgBGImg.data + idx_flt32);
-				const uchar* const oBGImgPtr = m_voBGImg[n].data + idx_uchar;
-				for (size_t c = 0; c < (size_t)m_voBGImg[n].channels(); ++c)
-					oAvgBgImgPtr[c] += ((float)oBGImgPtr[c]) / m_nBGSamples;
-			}
-		}
+	CV_Assert(!m_oBGMeanImg.empty());
+	if (m_oModelROI.size() == m_oInputSize) {
+		m_oBGMeanImg.copyTo(backgroundImage);
+		return;
 	}
-	oAvgBGImg.convertTo(backgroundImage, CV_8U);
+	// the model only covers part of the (downscaled) frame; everything else is left black
+	cv::Mat oScaledBGImg = cv::Mat::zeros(getScaledSize(), m_oBGMeanImg.type());
+	m_oBGMeanImg.copyTo(cv::Mat(oScaledBGImg, m_oModelROI));
+	if (m_nProcessingScale > 1)
+		cv::resize(oScaledBGImg, backgroundImage, m_oInputSize, 0, 0, cv::INTER_LINEAR);
+	else
+		backgroundImage = oScaledBGImg;
 }
 
-BackgroundSubtractorViBe_1ch::BackgroundSubtractorViBe_1ch(size_t nColorDistThreshold, size_t nBGSamples, size_t nRequiredBGSamples, size_t learningRate) :
-	BackgroundSubtractorViBe(nColorDistThreshold, nBGSamples, nRequiredBGSamples, learningRate) {}
+void BackgroundSubtractorViBe::setRandomSeed(uint64_t nSeed) {
+	m_nRandomSeed = nSeed;
+}
 
-BackgroundSubtractorViBe_1ch::~BackgroundSubtractorViBe_1ch() {}
+void BackgroundSubtractorViBe::setThreadPool(std::shared_ptr<ThreadPool> pThreadPool) {
+	m_pThreadPool = std::move(pThreadPool);
+}
 
-void BackgroundSubtractorViBe_1ch::initialize(const cv::Mat& oInitImg) {
-	m_oImgSize = oInitImg.size();
-	for (size_t s = 0; s < m_nBGSamples; s++) {
-		m_voBGImg[s].create(m_oImgSize, CV_8UC1);
-		m_voBGImg[s] = cv::Scalar(0);
-		for (int y_orig = 0; y_orig < m_oImgSize.height; y_orig++) {
-			for (int x_orig = 0; x_orig < m_oImgSize.width; x_orig++) {
-				int y_sample, x_sample;
-				lv::getSamplePosition_7x7_std2(Pcg32::fast(), x_sample, y_sample, x_orig, y_orig, 0, m_oImgSize);
-				m_voBGImg[s].at<uchar>(y_orig, x_orig) = oInitImg.at<uchar>(y_sample, x_sample);
-			}
-		}
-	}
-	m_bInitialized = true;
+void BackgroundSubtractorViBe::setNumThreads(size_t nThreads) {
+	CV_Assert(nThreads > 0);
+	if (!m_pThreadPool || m_pThreadPool->size() != nThreads)
+		m_pThreadPool = std::make_shared<ThreadPool>(nThreads);
 }
 
-void BackgroundSubtractorViBe_1ch::apply(const cv::Mat& _image, cv::Mat& _fgmask) {
-	_fgmask = cv::Scalar_<uchar>(0);
-	for (int y = 0; y < m_oImgSize.height; y++) {
-		for (int x = 0; x < m_oImgSize.width; x++) {
-			size_t nGoodSamplesCount = 0, nSampleIdx = 0;
-			while (nGoodSamplesCount < m_nRequiredBGSamples && nSampleIdx < m_nBGSamples) {
-				if (lv::L1dist(_image.at<uchar>(y, x), m_voBGImg[nSampleIdx].at<uchar>(y, x)) < m_nColorDistThreshold)
-					nGoodSamplesCount++;
-				nSampleIdx++;
-			}
-			if (nGoodSamplesCount < m_nRequiredBGSamples)
-				_fgmask.at<uchar>(y, x) = UCHAR_MAX;
-			else {
-				if ((Pcg32::fast() % m_learningRate) == 0)
-					m_voBGImg[Pcg32::fast() % m_nBGSamples].at<uchar>(y, x) = _image.at<uchar>(y, x);
-				if ((Pcg32::fast() % m_learningRate) == 0) {
-					int x_rand, y_rand;
-					getNeighborPosition_3x3(x_rand, y_rand, x, y, m_oImgSize);
-					m_voBGImg[Pcg32::fast() % m_nBGSamples].at<uchar>(y_rand, x_rand) = _image.at<uchar>(y, x);
-				}
-			}
-		}
-	}
+void BackgroundSubtractorViBe::setProcessingScale(int nScale) {
+	CV_Assert(nScale == 1 || nScale == 2 || nScale == 4);
+	m_nProcessingScale = nScale;
+}
+
+void BackgroundSubtractorViBe::setInputChannelOffset(size_t nChannelOffset) {
+	m_nInputChannelOffset = nChannelOffset;
 }
 
-BackgroundSubtractorViBe_3ch::BackgroundSubtractorViBe_3ch(size_t nColorDistThreshold, size_t nBGSamples, size_t nRequiredBGSamples, size_t learningRate) :
-	BackgroundSubtractorViBe(nColorDistThreshold, nBGSamples, nRequiredBGSamples, learningRate),
-	m_nColorDistThresholdSquared((nColorDistThreshold * 3) * (nColorDistThreshold * 3)) {}
+void BackgroundSubtractorViBe::setROIMask(const cv::Mat& oROIMask) {
+	CV_Assert(oROIMask.empty() || oROIMask.type() == CV_8UC1);
+	m_oROIMask = oROIMask.clone();
+}
 
-BackgroundSubtractorViBe_3ch::~BackgroundSubtractorViBe_3ch() {}
+void BackgroundSubtractorViBe::setTileWidth(int nTileWidth) {
+	CV_Assert(nTileWidth >= 0 || nTileWidth == BGSVIBE_AUTO_TILE_WIDTH);
+	m_nRequestedTileWidth = nTileWidth;
+}
 
-void BackgroundSubtractorViBe_3ch::initialize(const cv::Mat& oInitImgRGB) {
-	m_oImgSize = oInitImgRGB.size();
-	int y_sample, x_sample;
-	for (size_t s = 0; s < m_nBGSamples; s++) {
-		m_voBGImg[s].create(m_oImgSize, CV_8UC3);
-		m_voBGImg[s] = cv::Scalar(0, 0, 0);
-		for (int y_orig = 0; y_orig < m_oImgSize.height; y_orig++) {
-			for (int x_orig = 0; x_orig < m_oImgSize.width; x_orig++) {
-				lv::getSamplePosition_7x7_std2(Pcg32::fast(), x_sample, y_sample, x_orig, y_orig, 0, m_oImgSize);
-				m_voBGImg[s].at<cv::Vec3b>(y_orig, x_orig) = oInitImgRGB.at<cv::Vec3b>(y_sample, x_sample);
-			}
-		}
+void BackgroundSubtractorViBe::setChangeGating(int nTileSize, size_t nMaxDiff, size_t nMaxSkippedFrames) {
+	// tiles must not straddle stripes, whose tasks own the state of the tiles they cover
+	CV_Assert(nTileSize == 0 || (nTileSize > 0 && BGSVIBE_PARALLEL_STRIPE_HEIGHT % nTileSize == 0));
+	m_nGatingTileSize = nTileSize;
+	m_nGatingMaxDiff = nMaxDiff;
+	m_nGatingMaxSkippedFrames = nMaxSkippedFrames;
+}
+
+void BackgroundSubtractorViBe::setSampleReordering(bool bEnabled) {
+	m_bReorderSamples = bEnabled;
+}
+
+void BackgroundSubtractorViBe::setColorDistThreshold(size_t nColorDistThreshold) {
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	m_oParams.nColorDistThreshold = nColorDistThreshold;
+	m_bParamsPending.store(true, std::memory_order_release);
+}
+
+void BackgroundSubtractorViBe::setRequiredBGSamples(size_t nRequiredBGSamples) {
+	CV_Assert(nRequiredBGSamples > 0);
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	m_oParams.nRequiredBGSamples = nRequiredBGSamples;
+	m_bParamsPending.store(true, std::memory_order_release);
+}
+
+void BackgroundSubtractorViBe::setLearningRate(size_t nLearningRate) {
+	CV_Assert(nLearningRate > 0 && nLearningRate < (UINT16_MAX / 2)); // bounded by the update tables' jump range
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	m_oParams.nLearningRate = nLearningRate;
+	m_bParamsPending.store(true, std::memory_order_release);
+}
+
+size_t BackgroundSubtractorViBe::getColorDistThreshold() const {
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	return m_oParams.nColorDistThreshold;
+}
+
+size_t BackgroundSubtractorViBe::getRequiredBGSamples() const {
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	return m_oParams.nRequiredBGSamples;
+}
+
+size_t BackgroundSubtractorViBe::getLearningRate() const {
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	return m_oParams.nLearningRate;
+}
+
+void BackgroundSubtractorViBe::latchParams() {
+	if (!m_bParamsPending.load(std::memory_order_acquire))
+		return;
+	std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+	m_bParamsPending.store(false, std::memory_order_relaxed);
+	m_nColorDistThreshold = m_oParams.nColorDistThreshold;
+	m_nRequiredBGSamples = m_oParams.nRequiredBGSamples;
+	if (m_learningRate != m_oParams.nLearningRate) {
+		m_learningRate = m_oParams.nLearningRate;
+		// the jumps between update decisions depend on the learning rate
+		if (m_eUpdateMode == UpdateMode::RandomTables && m_bInitialized)
+			m_oUpdateTables.initialize(m_learningRate, m_nBGSamples, m_oRNG);
 	}
-	m_bInitialized = true;
 }
 
-void BackgroundSubtractorViBe_3ch::apply(const cv::Mat& _image, cv::Mat& _fgmask) {
-	applyCmp(_image, m_voBGImg, _fgmask);
+void BackgroundSubtractorViBe::saveModel(const std::string& sPath) const {
+	CV_Assert(m_bInitialized);
+	ModelSnapshot oSnapshot;
+	fillSnapshot(oSnapshot);
+	oSnapshot.vnModelData.assign(m_oBGModel.ptr(0, 0), m_oBGModel.ptr(0, 0) + m_oBGModel.totalBytes());
+	oSnapshot.write(sPath);
 }
 
-void BackgroundSubtractorViBe_3ch::splitImages(const cv::Mat& inputImg, std::vector<cv::Mat>& outputImages) {
-	outputImages.resize(m_numProcessesParallel);
-	int y = 0;
-	int h = m_oImgSize.height / m_numProcessesParallel;
-	for (int i = 0; i < m_numProcessesParallel; ++i) {
-		if (i == (m_numProcessesParallel - 1)) {
-			h = m_oImgSize.height - y;
-		}
-		outputImages[i] = inputImg(cv::Rect(0, y, m_oImgSize.width, h));
-		y += h;
+void BackgroundSubtractorViBe::loadModel(const std::string& sPath) {
+	const MappedModelSnapshot oSnapshot = MappedModelSnapshot::open(sPath);
+	const ModelSnapshotHeader& oHeader = *oSnapshot.pHeader;
+	const int nModelType = getModelType();
+	if (oHeader.nModelType != nModelType || oHeader.nLayout != (int32_t)m_oBGModel.layout() || oHeader.nUpdateMode != (int32_t)m_eUpdateMode ||
+			oHeader.nSampleEncoding != (int32_t)m_eSampleEncoding)
+		CV_Error(cv::Error::StsError, "model snapshot parameters do not match those of the subtractor: " + sPath);
+	const cv::Size oInputSize(oHeader.nInputWidth, oHeader.nInputHeight);
+	CV_Assert(oInputSize.width > 0 && oInputSize.height > 0);
+	CV_Assert(oHeader.nSamples > 0 && oHeader.nRequiredSamples > 0 && oHeader.nLearningRate > 0);
+	{
+		// the sample count & tunable parameters are those the snapshot was taken with (overriding the ones set before the call)
+		std::lock_guard<std::mutex> oLock(m_oParamsMutex);
+		m_nBGSamples = (size_t)oHeader.nSamples;
+		m_oParams = TunableParams{(size_t)oHeader.nColorDistThreshold, (size_t)oHeader.nRequiredSamples, (size_t)oHeader.nLearningRate};
+		m_nColorDistThreshold = m_oParams.nColorDistThreshold;
+		m_nRequiredBGSamples = m_oParams.nRequiredBGSamples;
+		m_learningRate = m_oParams.nLearningRate;
+		m_bParamsPending.store(false, std::memory_order_relaxed);
 	}
+	CV_Assert(oHeader.nROIMaskBytes == 0 || oHeader.nROIMaskBytes == (uint64_t)oInputSize.area());
+	setProcessingScale(oHeader.nProcessingScale);
+	if (oHeader.nROIMaskBytes > 0)
+		setROIMask(cv::Mat(oInputSize, CV_8UC1, oSnapshot.pData + oHeader.nROIMaskOffset));
+	else
+		setROIMask(cv::Mat());
+	m_nRandomSeed = oHeader.nRandomSeed;
+	m_bInitialized = false;
+	initializeGeometry(oInputSize, nModelType);
+	CV_Assert(oHeader.nStripeCount == m_voStripes.size());
+	// the samples are used in place (copy-on-write), the mapping lives as long as the model
+	m_oBGModel.attach(oSnapshot.pData + oHeader.nModelOffset, oHeader.nModelBytes, m_oImgSize, m_nBGSamples,
+		lv::getEncodedSampleType(m_eSampleEncoding, nModelType), oSnapshot.pMapping);
+	m_oRNG.seed(m_nRandomSeed);
+	if (m_eUpdateMode == UpdateMode::RandomTables)
+		m_oUpdateTables.initialize(m_learningRate, m_nBGSamples, m_oRNG);
+	m_oRNG.setState(oHeader.anRNGState[0], oHeader.anRNGState[1]);
+	const uint64_t* pnStripeStates = (const uint64_t*)(oSnapshot.pData + oHeader.nStripeRNGOffset);
+	for (size_t i = 0; i < m_voRNGParallel.size(); ++i)
+		m_voRNGParallel[i].setState(pnStripeStates[i * 2], pnStripeStates[i * 2 + 1]);
+	if (m_pThreadPool)
+		m_pThreadPool->parallelFor(m_voStripes.size(), [&](size_t i) {
+			initializeSums(m_voStripes[i]);
+		});
+	else
+		initializeSums(cv::Rect(0, 0, m_oImgSize.width, m_oImgSize.height));
+	m_bInitialized = true;
 }
 
-void BackgroundSubtractorViBe_3ch::joinImages(const std::vector<cv::Mat>& inputImages, cv::Mat& outputImg) {
-	for (int i = 0; i < inputImages.size(); ++i) {
-		inputImages[i].copyTo(outputImg(m_rectImgs[i]));
+void BackgroundSubtractorViBe::resizeModel(const cv::Size& oInputSize, size_t nBGSamples) {
+	CV_Assert(m_bInitialized && oInputSize.width > 0 && oInputSize.height > 0 && nBGSamples > 0);
+	CV_Assert(m_eUpdateMode != UpdateMode::RandomTables || nBGSamples <= UINT16_MAX); // bounded by the update tables' sample indices
+	const int nModelType = getModelType();
+	// the previous samples are kept aside along with the geometry needed to map the new pixels onto them
+	SampleModel oPrevModel(m_oBGModel.layout());
+	oPrevModel.swap(m_oBGModel);
+	const size_t nPrevSamples = m_nBGSamples, nPrevStripes = m_voStripes.size();
+	const cv::Size oPrevScaledSize = getScaledSize();
+	const cv::Rect oPrevModelROI = m_oModelROI;
+	if (!m_oROIMask.empty() && m_oROIMask.size() != oInputSize) {
+		cv::Mat oROIMask;
+		cv::resize(m_oROIMask, oROIMask, oInputSize, 0, 0, cv::INTER_NEAREST);
+		m_oROIMask = oROIMask;
 	}
+	m_bInitialized = false;
+	m_nBGSamples = nBGSamples;
+	initializeGeometry(oInputSize, nModelType);
+	m_oBGModel.create(m_oImgSize, m_nBGSamples, oPrevModel.type());
+	for (size_t i = nPrevStripes; i < m_voStripes.size(); ++i)
+		m_voRNGParallel[i].seed(m_nRandomSeed, i + 1);
+	// nearest previous model pixel of each new model row & column (pixel centers are matched across the scaled frames, then clamped to the
+	// previous model region)
+	const cv::Size oScaledSize = getScaledSize();
+	std::vector<int> vnPrevX(m_oImgSize.width), vnPrevY(m_oImgSize.height);
+	for (int x = 0; x < m_oImgSize.width; ++x)
+		vnPrevX[x] = std::clamp((int)((x + m_oModelROI.x + 0.5) * oPrevScaledSize.width / oScaledSize.width) - oPrevModelROI.x, 0, oPrevModelROI.width - 1);
+	for (int y = 0; y < m_oImgSize.height; ++y)
+		vnPrevY[y] = std::clamp((int)((y + m_oModelROI.y + 0.5) * oPrevScaledSize.height / oScaledSize.height) - oPrevModelROI.y, 0, oPrevModelROI.height - 1);
+	const size_t nElemSize = m_oBGModel.elemSize();
+	const auto lResample = [&](const cv::Rect& oROI, Pcg32& oRNG) {
+		// samples are copied as stored, so this works for any encoding; extra samples are drawn from the pixel's own samples
+		for (int y = oROI.y; y < oROI.y + oROI.height; ++y)
+			for (size_t s = 0; s < m_nBGSamples; ++s)
+				for (int x = oROI.x; x < oROI.x + oROI.width; ++x)
+					memcpy(m_oBGModel.ptr(s, y, x), oPrevModel.ptr((s < nPrevSamples) ? s : oRNG() % nPrevSamples, vnPrevY[y], vnPrevX[x]), nElemSize);
+		initializeSums(oROI);
+	};
+	if (m_pThreadPool)
+		m_pThreadPool->parallelFor(m_voStripes.size(), [&](size_t i) {
+			lResample(m_voStripes[i], m_voRNGParallel[i]);
+		});
+	else if (m_eUpdateMode == UpdateMode::Reference)
+		for (size_t i = 0; i < m_voStripes.size(); ++i)
+			lResample(m_voStripes[i], m_voRNGParallel[i]);
+	else
+		lResample(cv::Rect(0, 0, m_oImgSize.width, m_oImgSize.height), m_oRNG);
+	if (m_eUpdateMode == UpdateMode::RandomTables && m_nBGSamples != nPrevSamples)
+		m_oUpdateTables.initialize(m_learningRate, m_nBGSamples, m_oRNG);
+	m_bInitialized = true;
 }
 
-void BackgroundSubtractorViBe_3ch::initializeParallel(const cv::Mat& initImgRGB, const int numProcesses) {
-	m_numProcessesParallel = numProcesses;
-	m_oImgSize = initImgRGB.size();
+void BackgroundSubtractorViBe::setSnapshotPolicy(const std::string& sPath, size_t nFrameInterval, size_t nCopySteps) {
+	CV_Assert(nFrameInterval == 0 || (!sPath.empty() && nCopySteps > 0 && nCopySteps <= nFrameInterval));
+	m_sSnapshotPath = sPath;
+	m_nSnapshotInterval = nFrameInterval;
+	m_nSnapshotCopySteps = nCopySteps;
+	m_nFramesSinceSnapshot = 0;
+	m_nSnapshotCopiedSlices = 0;
+}
 
-	m_processSeq.resize(numProcesses);
+ViBeMetrics BackgroundSubtractorViBe::getMetrics() const {
+	std::lock_guard<std::mutex> oLock(m_oMetricsMutex);
+	return m_oMetrics;
+}
 
-	std::vector<cv::Mat> imgsSplit;
-	splitImages(initImgRGB, imgsSplit);
-	m_voBGImgParallel.resize(numProcesses);
+void BackgroundSubtractorViBe::resetMetrics() {
+	std::lock_guard<std::mutex> oLock(m_oMetricsMutex);
+	m_oMetrics = ViBeMetrics();
+}
 
-	m_rectImgs.resize(m_numProcessesParallel);
-	m_outSplit.resize(m_numProcessesParallel);
+void BackgroundSubtractorViBe::setMetricsCallback(std::function<void(const ViBeMetrics&)> lCallback, size_t nFrameInterval) {
+	std::lock_guard<std::mutex> oLock(m_oMetricsMutex);
+	m_lMetricsCallback = std::move(lCallback);
+	m_nMetricsInterval = m_lMetricsCallback ? nFrameInterval : 0;
+}
 
-	int y = 0;
-	int h = m_oImgSize.height / m_numProcessesParallel;
+void BackgroundSubtractorViBe::accumulateFrameMetrics(uint64_t nFrameStartNs, bool bParallel) {
+	using Counter = ViBeStripeMetrics::Counter;
+	using Phase = ViBeStripeMetrics::Phase;
+	const uint64_t nFrameNs = lv::metricsNow() - nFrameStartNs;
+	ViBeStripeMetrics oFrameTotals;
+	uint64_t nMaxStripeNs = 0, nTotalStripeNs = 0;
+	std::unique_lock<std::mutex> oLock(m_oMetricsMutex);
+	// the stripe tasks are done, so their counters can be read & cleared without synchronization
+	for (size_t i = 0; i < m_voStripeMetrics.size(); ++i) {
+		ViBeStripeMetrics& oStripe = m_voStripeMetrics[i];
+		for (size_t c = 0; c < oFrameTotals.anCounters.size(); ++c)
+			oFrameTotals.anCounters[c] += oStripe.anCounters[c];
+		for (size_t p = 0; p < oFrameTotals.anPhaseNs.size(); ++p)
+			oFrameTotals.anPhaseNs[p] += oStripe.anPhaseNs[p];
+		if (bParallel && i < m_voStripes.size()) {
+			const uint64_t nStripeNs = oStripe.anPhaseNs[(size_t)Phase::Stripe];
+			m_oMetrics.oStripeLatency.add(nStripeNs);
+			nMaxStripeNs = std::max(nMaxStripeNs, nStripeNs);
+			nTotalStripeNs += nStripeNs;
+		}
+		oStripe = ViBeStripeMetrics();
+	}
+	++m_oMetrics.nFrames;
+	for (size_t c = 0; c < oFrameTotals.anCounters.size(); ++c)
+		m_oMetrics.anCounters[c] += oFrameTotals.anCounters[c];
+	m_oMetrics.oFrameLatency.add(nFrameNs);
+	m_oMetrics.oClassifyTime.add(oFrameTotals.anPhaseNs[(size_t)Phase::Classify]);
+	m_oMetrics.oUpdateTime.add(oFrameTotals.anPhaseNs[(size_t)Phase::Update]);
+	if (bParallel && nTotalStripeNs > 0) {
+		m_oMetrics.dLastStripeImbalance = (double)nMaxStripeNs * m_voStripes.size() / nTotalStripeNs;
+		m_oMetrics.dMaxStripeImbalance = std::max(m_oMetrics.dMaxStripeImbalance, m_oMetrics.dLastStripeImbalance);
+	}
+	const uint64_t nProcessed = oFrameTotals.anCounters[(size_t)Counter::ClassifiedPixels] + oFrameTotals.anCounters[(size_t)Counter::GatedPixels];
+	m_oMetrics.dLastForegroundRatio = nProcessed ? (double)oFrameTotals.anCounters[(size_t)Counter::ForegroundPixels] / nProcessed : 0;
+	if (m_nMetricsInterval > 0 && (m_oMetrics.nFrames % m_nMetricsInterval) == 0) {
+		// the callback gets its own copy, so it may poll or reset the metrics itself
+		const ViBeMetrics oMetrics = m_oMetrics;
+		const std::function<void(const ViBeMetrics&)> lCallback = m_lMetricsCallback;
+		oLock.unlock();
+		lCallback(oMetrics);
+	}
+}
 
-	for (int np = 0; np < numProcesses; ++np) {
-		m_processSeq[np] = np;
+void BackgroundSubtractorViBe::fillSnapshot(ModelSnapshot& oSnapshot) const {
+	ModelSnapshotHeader& oHeader = oSnapshot.oHeader;
+	oHeader = ModelSnapshotHeader{};
+	oHeader.nModelType = getModelType();
+	oHeader.nLayout = (int32_t)m_oBGModel.layout();
+	oHeader.nUpdateMode = (int32_t)m_eUpdateMode;
+	oHeader.nSampleEncoding = (int32_t)m_eSampleEncoding;
+	oHeader.nSamples = m_nBGSamples;
+	oHeader.nRequiredSamples = m_nRequiredBGSamples;
+	oHeader.nColorDistThreshold = m_nColorDistThreshold;
+	oHeader.nLearningRate = m_learningRate;
+	oHeader.nInputWidth = m_oInputSize.width;
+	oHeader.nInputHeight = m_oInputSize.height;
+	oHeader.nProcessingScale = m_nProcessingScale;
+	oHeader.nRandomSeed = m_nRandomSeed;
+	m_oRNG.getState(oHeader.anRNGState[0], oHeader.anRNGState[1]);
+	oHeader.nStripeCount = m_voRNGParallel.size();
+	oSnapshot.vnStripeRNGStates.resize(m_voRNGParallel.size() * 2);
+	for (size_t i = 0; i < m_voRNGParallel.size(); ++i)
+		m_voRNGParallel[i].getState(oSnapshot.vnStripeRNGStates[i * 2], oSnapshot.vnStripeRNGStates[i * 2 + 1]);
+	oSnapshot.oROIMask = m_oROIMask;
+}
 
-		const cv::Mat& oInitImgRGB = imgsSplit[np];
-		const cv::Size _oImgSize = oInitImgRGB.size();
+void BackgroundSubtractorViBe::updateSnapshot() {
+	if (m_nSnapshotInterval == 0 || ++m_nFramesSinceSnapshot < m_nSnapshotInterval)
+		return;
+	if (m_bSnapshotWriting.load(std::memory_order_acquire))
+		return; // the previous snapshot is still being written; try again on the next frame
+	if (m_oSnapshotWriter.joinable())
+		m_oSnapshotWriter.join();
+	if (m_pSnapshotException) {
+		std::exception_ptr pException = m_pSnapshotException;
+		m_pSnapshotException = nullptr;
+		m_nFramesSinceSnapshot = 0;
+		std::rethrow_exception(pException);
+	}
+	// the model is copied one slice per frame, so a snapshot holds samples from nCopySteps consecutive frames (harmless for a warm restart)
+	const size_t nTotalBytes = m_oBGModel.totalBytes();
+	const size_t nSliceBytes = (nTotalBytes + m_nSnapshotCopySteps - 1) / m_nSnapshotCopySteps;
+	m_oSnapshotStaging.vnModelData.resize(nTotalBytes);
+	const size_t nBegin = std::min(nTotalBytes, m_nSnapshotCopiedSlices * nSliceBytes);
+	const size_t nEnd = std::min(nTotalBytes, nBegin + nSliceBytes);
+	memcpy(m_oSnapshotStaging.vnModelData.data() + nBegin, m_oBGModel.ptr(0, 0) + nBegin, nEnd - nBegin);
+	if (++m_nSnapshotCopiedSlices < m_nSnapshotCopySteps)
+		return;
+	fillSnapshot(m_oSnapshotStaging);
+	m_nFramesSinceSnapshot = 0;
+	m_nSnapshotCopiedSlices = 0;
+	m_bSnapshotWriting.store(true, std::memory_order_release);
+	m_oSnapshotWriter = std::thread([this, sPath = m_sSnapshotPath]() {
+		try {
+			m_oSnapshotStaging.write(sPath);
+		}
+		catch (...) {
+			m_pSnapshotException = std::current_exception();
+		}
+		m_bSnapshotWriting.store(false, std::memory_order_release);
+	});
+}
 
-		m_outSplit[np].create(_oImgSize, CV_8UC1);
-		std::vector<cv::Mat> _voBGImg = std::vector<cv::Mat>(m_nBGSamples);
+void BackgroundSubtractorViBe::initializeModel(const cv::Mat& oInitImg, const cv::Rect& oROI, Pcg32& oRNG) {
+	// compressed encodings only store 8-bit 3ch pixels (checked by the engine)
+	switch (m_eSampleEncoding) {
+		case lv::SampleEncoding::BGR565: initializeModelRegion<3, uint8_t, lv::BGR565Encoding>(oInitImg, oROI, oRNG); return;
+		case lv::SampleEncoding::YUV844: initializeModelRegion<3, uint8_t, lv::YUV844Encoding>(oInitImg, oROI, oRNG); return;
+		case lv::SampleEncoding::BGR332: initializeModelRegion<3, uint8_t, lv::BGR332Encoding>(oInitImg, oROI, oRNG); return;
+		default: break;
+	}
+	switch (m_oBGModel.type()) {
+		case CV_8UC1: initializeModelRegion<1, uint8_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_8UC2: initializeModelRegion<2, uint8_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_8UC3: initializeModelRegion<3, uint8_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_8UC4: initializeModelRegion<4, uint8_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_16UC1: initializeModelRegion<1, uint16_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_16UC2: initializeModelRegion<2, uint16_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_16UC3: initializeModelRegion<3, uint16_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		case CV_16UC4: initializeModelRegion<4, uint16_t, lv::RawEncoding>(oInitImg, oROI, oRNG); break;
+		default: CV_Error(cv::Error::StsError, "unsupported model type");
+	}
+}
 
-		int y_sample, x_sample;
-		for (size_t s = 0; s < m_nBGSamples; s++) {
-			_voBGImg[s].create(_oImgSize, CV_8UC3);
-			_voBGImg[s] = cv::Scalar(0, 0, 0);
-			for (int y_orig = 0; y_orig < _oImgSize.height; y_orig++) {
-				for (int x_orig = 0; x_orig < _oImgSize.width; x_orig++) {
-					lv::getSamplePosition_7x7_std2(Pcg32::fast(), x_sample, y_sample, x_orig, y_orig, 0, _oImgSize);
-					_voBGImg[s].at<cv::Vec3b>(y_orig, x_orig) = oInitImgRGB.at<cv::Vec3b>(y_sample, x_sample);
+template<size_t nChannels, typename TSample, typename TEncoding>
+void BackgroundSubtractorViBe::initializeModelRegion(const cv::Mat& oInitImg, const cv::Rect& oROI, Pcg32& oRNG) {
+	const auto& anOffsets = lv::getSampleOffsetTable_7x7_std2();
+	const size_t nInputPixelStride = oInitImg.elemSize();
+	// byte offsets of the table entries for pixels whose 7x7 neighborhood is inside the image (no clamping needed)
+	std::array<ptrdiff_t, 512> anInnerOffsets;
+	for (size_t i = 0; i < anOffsets.size(); ++i)
+		anInnerOffsets[i] = anOffsets[i][1] * (ptrdiff_t)oInitImg.step[0] + anOffsets[i][0] * (ptrdiff_t)nInputPixelStride;
+	const int nInnerBeginX = std::min(std::max(oROI.x, 3), oROI.x + oROI.width), nInnerEndX = std::max(nInnerBeginX, std::min(oROI.x + oROI.width, m_oImgSize.width - 3));
+	// large planar models are written with streaming stores, since their rows are only read again by the first apply call
+	const bool bPlanar = (m_oBGModel.layout() == SampleModel::Layout::Planar);
+	const bool bStreaming = bPlanar && m_oBGModel.totalBytes() >= s_nStreamingInitMinBytes;
+	std::vector<uint32_t> vnRowRandValues(oROI.width);
+	std::vector<TSample> vnRowSamples(oROI.width * nChannels);
+	// encoded samples of the row (only used with a compressed encoding)
+	const size_t nElemSize = m_oBGModel.elemSize(), nRowBytes = oROI.width * nElemSize;
+	std::vector<uchar> vnRowCodes(TEncoding::s_bRaw ? 0 : nRowBytes);
+	for (size_t s = 0; s < m_nBGSamples; s++) {
+		for (int y_orig = oROI.y; y_orig < oROI.y + oROI.height; y_orig++) {
+			oRNG.fill(vnRowRandValues.data(), vnRowRandValues.size());
+			const uint32_t* const pRandValues = vnRowRandValues.data() - oROI.x;
+			TSample* const pRowSamples = vnRowSamples.data() - oROI.x * nChannels;
+			const auto lSampleClamped = [&](int x_orig) {
+				const auto& anOffset = anOffsets[pRandValues[x_orig] & 511];
+				int x_sample = x_orig + anOffset[0], y_sample = y_orig + anOffset[1];
+				lv::clampImageCoords(x_sample, y_sample, m_oImgSize);
+				memcpy(pRowSamples + x_orig * nChannels, getInputRow(oInitImg, y_sample) + x_sample * nInputPixelStride, sizeof(TSample) * nChannels);
+			};
+			if (y_orig >= 3 && y_orig < m_oImgSize.height - 3) {
+				const uchar* const pInputRow = getInputRow(oInitImg, y_orig);
+				for (int x_orig = oROI.x; x_orig < nInnerBeginX; ++x_orig)
+					lSampleClamped(x_orig);
+				for (int x_orig = nInnerBeginX; x_orig < nInnerEndX; ++x_orig)
+					memcpy(pRowSamples + x_orig * nChannels, pInputRow + x_orig * nInputPixelStride + anInnerOffsets[pRandValues[x_orig] & 511], sizeof(TSample) * nChannels);
+				for (int x_orig = nInnerEndX; x_orig < oROI.x + oROI.width; ++x_orig)
+					lSampleClamped(x_orig);
+			}
+			else {
+				for (int x_orig = oROI.x; x_orig < oROI.x + oROI.width; ++x_orig)
+					lSampleClamped(x_orig);
+			}
+			const uchar* pRowBytes = (const uchar*)vnRowSamples.data();
+			if constexpr (!TEncoding::s_bRaw) {
+				// the sums accumulate the decoded samples, i.e. the values the classification compares against
+				typedef typename TEncoding::TCode TCode;
+				for (int x = 0; x < oROI.width; ++x) {
+					const TCode nCode = TEncoding::encode(&vnRowSamples[x * nChannels]);
+					TEncoding::decode(nCode, &vnRowSamples[x * nChannels]);
+					memcpy(vnRowCodes.data() + x * sizeof(TCode), &nCode, sizeof(TCode));
 				}
+				pRowBytes = vnRowCodes.data();
 			}
+			int32_t* const pSums = m_oSampleSums.ptr<int32_t>(y_orig) + oROI.x * nChannels;
+			if (s == 0)
+				for (size_t i = 0; i < vnRowSamples.size(); ++i)
+					pSums[i] = vnRowSamples[i];
+			else
+				for (size_t i = 0; i < vnRowSamples.size(); ++i)
+					pSums[i] += vnRowSamples[i];
+			if (bStreaming)
+				lv::copyNonTemporal(m_oBGModel.ptr(s, y_orig, oROI.x), pRowBytes, nRowBytes);
+			else if (bPlanar)
+				memcpy(m_oBGModel.ptr(s, y_orig, oROI.x), pRowBytes, nRowBytes);
+			else
+				for (int x = 0; x < oROI.width; ++x)
+					memcpy(m_oBGModel.ptr(s, y_orig, oROI.x + x), pRowBytes + x * nElemSize, nElemSize);
 		}
-		m_voBGImgParallel[np] = _voBGImg;
+	}
+	if (bStreaming)
+		lv::streamFence();
+	for (int y = oROI.y; y < oROI.y + oROI.height; ++y) {
+		const int32_t* const pSums = m_oSampleSums.ptr<int32_t>(y) + oROI.x * nChannels;
+		TSample* const pMean = m_oBGMeanImg.ptr<TSample>(y) + oROI.x * nChannels;
+		for (size_t i = 0; i < oROI.width * nChannels; ++i)
+			pMean[i] = (TSample)((pSums[i] + m_nBGSamples / 2) / m_nBGSamples);
+	}
+}
 
-		// Calculating partition rectangles
-		if (np == (m_numProcessesParallel - 1)) {
-			h = m_oImgSize.height - y;
+void BackgroundSubtractorViBe::initializeSums(const cv::Rect& oROI) {
+	const int nChannels = CV_MAT_CN(m_oBGMeanImg.type());
+	const auto lInitialize = [&]<typename TSample, typename TEncoding>() {
+		TSample anDecoded[4];
+		for (int y = oROI.y; y < oROI.y + oROI.height; ++y) {
+			int32_t* pSums = m_oSampleSums.ptr<int32_t>(y) + oROI.x * nChannels;
+			TSample* pMean = m_oBGMeanImg.ptr<TSample>(y) + oROI.x * nChannels;
+			for (int x = oROI.x; x < oROI.x + oROI.width; ++x, pSums += nChannels, pMean += nChannels) {
+				for (int c = 0; c < nChannels; ++c)
+					pSums[c] = 0;
+				for (size_t s = 0; s < m_nBGSamples; ++s) {
+					const TSample* const pSample = lv::readSample<TSample, TEncoding>(m_oBGModel.ptr(s, y, x), anDecoded);
+					for (int c = 0; c < nChannels; ++c)
+						pSums[c] += pSample[c];
+				}
+				for (int c = 0; c < nChannels; ++c)
+					pMean[c] = (TSample)((pSums[c] + m_nBGSamples / 2) / m_nBGSamples);
+			}
 		}
-		m_rectImgs[np] = cv::Rect(0, y, m_oImgSize.width, h);
-		y += h;
+	};
+	switch (m_eSampleEncoding) {
+		case lv::SampleEncoding::BGR565: lInitialize.operator()<uint8_t, lv::BGR565Encoding>(); break;
+		case lv::SampleEncoding::YUV844: lInitialize.operator()<uint8_t, lv::YUV844Encoding>(); break;
+		case lv::SampleEncoding::BGR332: lInitialize.operator()<uint8_t, lv::BGR332Encoding>(); break;
+		default:
+			if (CV_MAT_DEPTH(m_oBGModel.type()) == CV_8U)
+				lInitialize.operator()<uint8_t, lv::RawEncoding>();
+			else
+				lInitialize.operator()<uint16_t, lv::RawEncoding>();
 	}
-	m_bInitialized = true;
 }
 
-void BackgroundSubtractorViBe_3ch::applyParallel(const cv::Mat& image, cv::Mat& fgmask) {
-	std::for_each(
-		std::execution::par,
-		m_processSeq.begin(),
-		m_processSeq.end(),
-		[&](int np)
-		{
-			const cv::Mat iImg{image(m_rectImgs[np])};
-			applyCmp(iImg, m_voBGImgParallel[np], m_outSplit[np]);
-			m_outSplit[np].copyTo(fgmask(m_rectImgs[np]));
+void BackgroundSubtractorViBe::initializeCommon(const cv::Mat& oInitImg, int nModelType) {
+	latchParams();
+	initializeGeometry(oInitImg.size(), nModelType);
+	m_oBGModel.create(m_oImgSize, m_nBGSamples, lv::getEncodedSampleType(m_eSampleEncoding, nModelType));
+	const cv::Mat oModelInitImg = prepareInput(oInitImg);
+	m_oRNG.seed(m_nRandomSeed);
+	if (m_eUpdateMode == UpdateMode::RandomTables)
+		m_oUpdateTables.initialize(m_learningRate, m_nBGSamples, m_oRNG);
+	for (size_t i = 0; i < m_voStripes.size(); ++i)
+		m_voRNGParallel[i].seed(m_nRandomSeed, i + 1);
+	if (m_pThreadPool)
+		m_pThreadPool->parallelFor(m_voStripes.size(), [&](size_t i) {
+			initializeModel(oModelInitImg, m_voStripes[i], m_voRNGParallel[i]);
 		});
-	//joinImages(m_outSplit, fgmask);
+	else if (m_eUpdateMode == UpdateMode::Reference) // the serial path draws from the stripe streams as well, so both get the same model
+		for (size_t i = 0; i < m_voStripes.size(); ++i)
+			initializeModel(oModelInitImg, m_voStripes[i], m_voRNGParallel[i]);
+	else
+		initializeModel(oModelInitImg, cv::Rect(0, 0, m_oImgSize.width, m_oImgSize.height), m_oRNG);
 }
 
-void BackgroundSubtractorViBe_3ch::applyCmp(const cv::Mat& image, std::vector<cv::Mat>& bgImg, cv::Mat& fgmask) {
-	fgmask = cv::Scalar_<uchar>(0);
-
-	cv::Size _oImgSize = image.size();
-
-	for (int y = 0; y < _oImgSize.height; ++y) {
-		for (int x = 0; x < _oImgSize.width; ++x) {
-			size_t nGoodSamplesCount{0}, 
-				nSampleIdx{0};
-			const cv::Vec3b& in{image.at<cv::Vec3b>(y, x)};
-			while ((nGoodSamplesCount < m_nRequiredBGSamples) && (nSampleIdx < m_nBGSamples)) {
-				const cv::Vec3b& bg{bgImg[nSampleIdx].at<cv::Vec3b>(y, x)};
-				if (L2dist3Squared(in, bg) < m_nColorDistThresholdSquared) {
-					++nGoodSamplesCount;
+void BackgroundSubtractorViBe::initializeGeometry(const cv::Size& oInputSize, int nModelType) {
+	m_oInputSize = oInputSize;
+	const cv::Size oScaledSize = getScaledSize();
+	m_oModelROI = cv::Rect(cv::Point(0, 0), oScaledSize);
+	m_voRowSpans.clear();
+	m_vnRowSpanOffsets.clear();
+	if (!m_oROIMask.empty()) {
+		CV_Assert(m_oROIMask.size() == m_oInputSize);
+		cv::Mat oScaledROIMask = m_oROIMask;
+		if (m_nProcessingScale > 1)
+			cv::resize(m_oROIMask, oScaledROIMask, oScaledSize, 0, 0, cv::INTER_NEAREST);
+		cv::Point oTL(oScaledSize.width, oScaledSize.height), oBR(-1, -1);
+		for (int y = 0; y < oScaledSize.height; ++y) {
+			const uchar* pROIRow = oScaledROIMask.ptr<uchar>(y);
+			for (int x = 0; x < oScaledSize.width; ++x) {
+				if (pROIRow[x]) {
+					oTL = cv::Point(std::min(oTL.x, x), std::min(oTL.y, y));
+					oBR = cv::Point(std::max(oBR.x, x), std::max(oBR.y, y));
 				}
-				++nSampleIdx;
 			}
-			if (nGoodSamplesCount < m_nRequiredBGSamples) {
-				fgmask.at<uchar>(y, x) = UCHAR_MAX;
-			} else {
-				if ((Pcg32::fast() % m_learningRate) == 0) {
-					bgImg[Pcg32::fast() % m_nBGSamples].at<cv::Vec3b>(y, x) = image.at<cv::Vec3b>(y, x);
-				}
-				if ((Pcg32::fast() % m_learningRate) == 0) {
-					int x_rand, y_rand;
-					getNeighborPosition_3x3(x_rand, y_rand, x, y, _oImgSize);
-					bgImg[Pcg32::fast() % m_nBGSamples].at<cv::Vec3b>(y_rand, x_rand) = image.at<cv::Vec3b>(y, x);
+		}
+		CV_Assert(oBR.x >= 0); // the ROI mask must include at least one pixel
+		m_oModelROI = cv::Rect(oTL, oBR + cv::Point(1, 1));
+		for (int y = m_oModelROI.y; y < m_oModelROI.y + m_oModelROI.height; ++y) {
+			const uchar* pROIRow = oScaledROIMask.ptr<uchar>(y) + m_oModelROI.x;
+			m_vnRowSpanOffsets.push_back(m_voRowSpans.size());
+			for (int x = 0; x < m_oModelROI.width;) {
+				if (!pROIRow[x]) {
+					++x;
+					continue;
 				}
+				const int nStart = x;
+				while (x < m_oModelROI.width && pROIRow[x])
+					++x;
+				m_voRowSpans.emplace_back(nStart, x);
 			}
 		}
+		m_vnRowSpanOffsets.push_back(m_voRowSpans.size());
+	}
+	m_oImgSize = m_oModelROI.size();
+	CV_Assert(CV_MAT_DEPTH(nModelType) == CV_8U || CV_MAT_DEPTH(nModelType) == CV_16U);
+	CV_Assert(m_nBGSamples <= (size_t)(INT32_MAX / UINT16_MAX)); // the sample sums must fit in 32-bit signed ints
+	m_oSampleSums.create(m_oImgSize, CV_32SC(CV_MAT_CN(nModelType)));
+	m_oBGMeanImg.create(m_oImgSize, nModelType);
+	if (m_eUpdateMode == UpdateMode::Reference)
+		m_oReferenceMask.create(m_oImgSize, CV_8UC1);
+	else
+		m_oReferenceMask.release();
+	m_nSnapshotCopiedSlices = 0; // a partially copied snapshot no longer matches the model
+	m_voStripes.clear();
+	for (int y = 0; y < m_oImgSize.height; y += BGSVIBE_PARALLEL_STRIPE_HEIGHT) {
+		const int h = std::min(BGSVIBE_PARALLEL_STRIPE_HEIGHT, m_oImgSize.height - y);
+		if (h < 2 && !m_voStripes.empty()) // stripes must be at least two rows high to be processed concurrently
+			m_voStripes.back().height += h;
+		else
+			m_voStripes.emplace_back(0, y, m_oImgSize.width, h);
+	}
+	m_voRNGParallel.resize(m_voStripes.size());
+	m_voStripeMetrics.assign(m_voStripes.size() + 1, ViBeStripeMetrics());
+	m_voCompactScratch.clear(); // the scratch rows are only zeroed outside the model region when allocated
+	m_nTileWidth = m_nRequestedTileWidth;
+	if (m_nTileWidth == BGSVIBE_AUTO_TILE_WIDTH) {
+		// one tile spans a stripe plus the rows above & below it touched by neighbor updates; per pixel, it holds the samples, sums,
+		// mean, input, mask & gating reference
+		const size_t nElemSize = CV_ELEM_SIZE(nModelType);
+		const size_t nSampleSize = CV_ELEM_SIZE(lv::getEncodedSampleType(m_eSampleEncoding, nModelType));
+		const size_t nPixelBytes = m_nBGSamples * nSampleSize + sizeof(int32_t) * CV_MAT_CN(nModelType) + 3 * nElemSize + 1;
+		const size_t nColumnBytes = nPixelBytes * (BGSVIBE_PARALLEL_STRIPE_HEIGHT + 2);
+		m_nTileWidth = std::max(64, (int)(getL2CacheSize() / 2 / nColumnBytes) / 16 * 16);
 	}
+	if (m_nTileWidth >= m_oImgSize.width)
+		m_nTileWidth = m_oImgSize.width; // single tile, but still with the stripe-ordered traversal
+	m_oGatingRefImg.release();
+	m_vnTileGated.clear();
+	m_vnTileForeground.clear();
+	m_vnTileSkippedFrames.clear();
+	if (m_nGatingTileSize > 0) {
+		m_oGatingRefImg.create(m_oImgSize, nModelType);
+		m_nGatingTilesX = (m_oImgSize.width + m_nGatingTileSize - 1) / m_nGatingTileSize;
+		const size_t nTiles = (size_t)m_nGatingTilesX * ((m_oImgSize.height + m_nGatingTileSize - 1) / m_nGatingTileSize);
+		m_vnTileGated.assign(nTiles, 0);
+		m_vnTileForeground.assign(nTiles, 1); // forces the classification of all tiles on the first frame
+		m_vnTileSkippedFrames.assign(nTiles, 0);
+	}
+}
+
+cv::Size BackgroundSubtractorViBe::getScaledSize() const {
+	return cv::Size(std::max(1, m_oInputSize.width / m_nProcessingScale), std::max(1, m_oInputSize.height / m_nProcessingScale));
 }
 
-// void BackgroundSubtractorViBe_3ch::apply(cv::InputArray _image, cv::OutputArray _fgmask, double learningRate) {
-// 	cv::Mat oInputImgRGB = _image.getMat();
-
-// 	//_fgmask.create(m_oImgSize, CV_8UC1); // Creating outside before
-// 	cv::Mat oFGMask = _fgmask.getMat();
-// 	oFGMask = cv::Scalar_<uchar>(0);
-	
-// 	const size_t nLearningRate = (size_t)ceil(learningRate);
-
-// 	for (int y = 0; y < m_oImgSize.height; ++y) {
-// 		for (int x = 0; x < m_oImgSize.width; ++x) {
-// #if BGSVIBE_USE_SC_THRS_VALIDATION
-// 			const size_t nCurrSCColorDistThreshold = (size_t)(m_nColorDistThreshold * BGSVIBE_SINGLECHANNEL_THRESHOLD_DIFF_FACTOR) / 3;
-// #endif //BGSVIBE_USE_SC_THRS_VALIDATION
-// 			size_t nGoodSamplesCount = 0, nSampleIdx = 0;
-// 			while (nGoodSamplesCount < m_nRequiredBGSamples && nSampleIdx < m_nBGSamples) {
-// 				const cv::Vec3b& in = oInputImgRGB.at<cv::Vec3b>(y, x);
-// 				const cv::Vec3b& bg = m_voBGImg[nSampleIdx].at<cv::Vec3b>(y, x);
-// #if BGSVIBE_USE_SC_THRS_VALIDATION
-// 				for (size_t c = 0; c < 3; c++)
-// 					if (lv::L1dist(in[c], bg[c]) > nCurrSCColorDistThreshold)
-// 						goto skip;
-// #endif //BGSVIBE_USE_SC_THRS_VALIDATION
-// #if BGSVIBE_USE_L1_DISTANCE_CHECK
-// 				if (lv::L1dist(in, bg) < m_nColorDistThreshold * 3)
-// #else //(!BGSVIBE_USE_L1_DISTANCE_CHECK)
-// 				//if (lv::L2dist(in, bg) < m_nColorDistThreshold * 3)
-// 				//if (L2dist3(in, bg) < m_nColorDistThreshold * 3)
-// 				if (L2dist3Squared(in, bg) < m_nColorDistThresholdSquared * 3)
-// #endif //(!BGSVIBE_USE_L1_DISTANCE_CHECK)
-// 					nGoodSamplesCount++;
-// #if BGSVIBE_USE_SC_THRS_VALIDATION
-// 				skip :
-// #endif //BGSVIBE_USE_SC_THRS_VALIDATION
-// 				nSampleIdx++;
-// 			}
-// 			if (nGoodSamplesCount < m_nRequiredBGSamples)
-// 				oFGMask.at<uchar>(y, x) = UCHAR_MAX;
-// 			else {
-// 				if ((pcg32_fast() % nLearningRate) == 0)
-// 					m_voBGImg[pcg32_fast() % m_nBGSamples].at<cv::Vec3b>(y, x) = oInputImgRGB.at<cv::Vec3b>(y, x);
-// 				if ((pcg32_fast() % nLearningRate) == 0) {
-// 					int x_rand, y_rand;
-// 					lv::getNeighborPosition_3x3(pcg32_fast(), x_rand, y_rand, x, y, 0, m_oImgSize);
-// 					const size_t s_rand = pcg32_fast() % m_nBGSamples;
-// 					m_voBGImg[s_rand].at<cv::Vec3b>(y_rand, x_rand) = oInputImgRGB.at<cv::Vec3b>(y, x);
-// 				}
-// 			}
-// 		}
-// 	}
-// }
+cv::Mat BackgroundSubtractorViBe::prepareInput(const cv::Mat& oImage) {
+	CV_Assert(oImage.size() == m_oInputSize && oImage.depth() == m_oBGMeanImg.depth() && (oImage.channels() % m_oBGMeanImg.channels()) == 0 &&
+		m_nInputChannelOffset + m_oBGMeanImg.channels() <= (size_t)oImage.channels());
+	if (m_nProcessingScale == 1)
+		return cv::Mat(oImage, m_oModelROI);
+	cv::resize(oImage, m_oScaledInput, getScaledSize(), 0, 0, cv::INTER_AREA);
+	return cv::Mat(m_oScaledInput, m_oModelROI);
+}
+
+cv::Mat BackgroundSubtractorViBe::prepareFGMask(cv::Mat& oFGMask) {
+	oFGMask.create(m_oInputSize, CV_8UC1);
+	cv::Mat& oTarget = (m_nProcessingScale == 1) ? oFGMask : m_oScaledFGMask;
+	oTarget.create(getScaledSize(), CV_8UC1);
+	if (m_oModelROI.size() != oTarget.size()) {
+		// the bands around the model region are never visited by the segmentation
+		const int nBottom = m_oModelROI.y + m_oModelROI.height, nRight = m_oModelROI.x + m_oModelROI.width;
+		cv::Mat(oTarget, cv::Rect(0, 0, oTarget.cols, m_oModelROI.y)).setTo(0);
+		cv::Mat(oTarget, cv::Rect(0, nBottom, oTarget.cols, oTarget.rows - nBottom)).setTo(0);
+		cv::Mat(oTarget, cv::Rect(0, m_oModelROI.y, m_oModelROI.x, m_oModelROI.height)).setTo(0);
+		cv::Mat(oTarget, cv::Rect(nRight, m_oModelROI.y, oTarget.cols - nRight, m_oModelROI.height)).setTo(0);
+	}
+	return cv::Mat(oTarget, m_oModelROI);
+}
+
+void BackgroundSubtractorViBe::finalizeFGMask(cv::Mat& oFGMask) {
+	if (m_nProcessingScale > 1)
+		cv::resize(m_oScaledFGMask, oFGMask, m_oInputSize, 0, 0, cv::INTER_NEAREST);
+}
+
+void BackgroundSubtractorViBe::accumulateGatingRow(const uchar* pFGMaskRow, int y) {
+	uint8_t* const pForeground = m_vnTileForeground.data() + (size_t)(y / m_nGatingTileSize) * m_nGatingTilesX;
+	for (int nTile = 0; nTile < m_nGatingTilesX; ++nTile) {
+		if (pForeground[nTile])
+			continue;
+		const int nEnd = std::min(m_oImgSize.width, (nTile + 1) * m_nGatingTileSize);
+		uchar nAny = 0;
+		for (int x = nTile * m_nGatingTileSize; x < nEnd; ++x)
+			nAny |= pFGMaskRow[x];
+		pForeground[nTile] = (nAny != 0);
+	}
+}
+
+void BackgroundSubtractorViBe::prepareCompactMask(CompactMask& oMask) {
+	CV_Assert((oMask.nFormats & (CompactMask::Bits | CompactMask::Runs | CompactMask::Tiles | CompactMask::Blobs)) != 0 && oMask.nTileSize > 0);
+	oMask.oSize = getScaledSize();
+	oMask.nScale = m_nProcessingScale;
+	oMask.nWordsPerRow = (size_t)(oMask.oSize.width + 63) / 64;
+	if (oMask.needsBits())
+		oMask.vnBits.assign(oMask.nWordsPerRow * oMask.oSize.height, 0);
+	else
+		oMask.vnBits.clear();
+	oMask.voRuns.clear();
+	oMask.vnRowRunOffsets.clear();
+	oMask.voBlobs.clear();
+	oMask.vnRunLabels.clear();
+	if (oMask.needsRuns())
+		m_vnCompactRowRunCounts.assign(oMask.oSize.height, 0);
+	// the unfiltered rows get an extra zero row, used as the neighbor of the model's first & last rows inside the frame
+	if (oMask.eFilter != CompactMask::Filter::None)
+		m_vnCompactRawBits.assign(oMask.nWordsPerRow * (oMask.oSize.height + 1), 0);
+	m_voCompactScratch.resize(m_voStripes.size() + 1);
+	for (CompactScratch& oScratch : m_voCompactScratch) {
+		// the tiled traversal keeps all rows of a stripe (at most BGSVIBE_PARALLEL_STRIPE_HEIGHT+1) until they are committed
+		const int nRows = (m_nTileWidth > 0) ? BGSVIBE_PARALLEL_STRIPE_HEIGHT + 1 : 1;
+		if (oScratch.nRows != nRows || oScratch.vnRow.size() != (size_t)oMask.oSize.width * nRows) {
+			oScratch.nRows = nRows;
+			oScratch.vnRow.assign((size_t)oMask.oSize.width * nRows, 0);
+		}
+		oScratch.vnWords.resize(oMask.nWordsPerRow);
+		oScratch.voRuns.clear();
+	}
+}
+
+void BackgroundSubtractorViBe::encodeCompactRow(CompactMask& oMask, size_t nScratchIdx, int y) {
+	CompactScratch& oScratch = m_voCompactScratch[nScratchIdx];
+	const int nFrameRow = y + m_oModelROI.y;
+	if (oMask.eFilter != CompactMask::Filter::None) {
+		lv::packMaskRow(oScratch.row(y), oMask.oSize.width, m_vnCompactRawBits.data() + (size_t)nFrameRow * oMask.nWordsPerRow);
+		// a row is filtered as soon as the row below it is packed, except for the first & last rows of a stripe, whose neighbors
+		// belong to other stripes (those are left to finalizeCompactMask)
+		const int nBegin = (nScratchIdx < m_voStripes.size()) ? m_voStripes[nScratchIdx].y : 0;
+		const int nEnd = (nScratchIdx < m_voStripes.size()) ? m_voStripes[nScratchIdx].y + m_voStripes[nScratchIdx].height : m_oImgSize.height;
+		if (y - 1 > nBegin || (y - 1 == nBegin && nBegin == 0))
+			filterCompactRow(oMask, y - 1);
+		if (y == nEnd - 1 && nEnd == m_oImgSize.height)
+			filterCompactRow(oMask, y);
+		return;
+	}
+	// stripes own disjoint rows, so they write disjoint words of the packed mask
+	uint64_t* const pWords = oMask.vnBits.empty() ? oScratch.vnWords.data() : oMask.vnBits.data() + (size_t)nFrameRow * oMask.nWordsPerRow;
+	lv::packMaskRow(oScratch.row(y), oMask.oSize.width, pWords);
+	if (oMask.needsRuns())
+		m_vnCompactRowRunCounts[nFrameRow] = CompactMask::appendRowRuns(pWords, oMask.oSize.width, oScratch.voRuns);
+}
+
+void BackgroundSubtractorViBe::filterCompactRow(CompactMask& oMask, int y) {
+	const size_t nWords = oMask.nWordsPerRow;
+	const int nFrameRow = y + m_oModelROI.y;
+	const uint64_t* const pRow = m_vnCompactRawBits.data() + (size_t)nFrameRow * nWords;
+	const uint64_t* const pZeroRow = m_vnCompactRawBits.data() + (size_t)oMask.oSize.height * nWords;
+	// rows outside the model are all background, except past the frame borders, which replicate the border rows
+	const uint64_t* const pUpperRow = (y > 0) ? pRow - nWords : (nFrameRow > 0 ? pZeroRow : pRow);
+	const uint64_t* const pLowerRow = (y + 1 < m_oImgSize.height) ? pRow + nWords : (nFrameRow + 1 < oMask.oSize.height ? pZeroRow : pRow);
+	CompactMask::medianRow3x3(pUpperRow, pRow, pLowerRow, oMask.oSize.width, oMask.vnBits.data() + (size_t)nFrameRow * nWords);
+}
+
+void BackgroundSubtractorViBe::finalizeCompactMask(CompactMask& oMask, bool bParallel) {
+	if (oMask.eFilter != CompactMask::Filter::None) {
+		if (bParallel) {
+			for (const cv::Rect& oStripe : m_voStripes) {
+				if (oStripe.y > 0)
+					filterCompactRow(oMask, oStripe.y);
+				if (oStripe.y + oStripe.height < m_oImgSize.height)
+					filterCompactRow(oMask, oStripe.y + oStripe.height - 1);
+			}
+		}
+		// pixels outside the model region have at most 3 foreground neighbors, so the filter leaves them empty
+		if (oMask.needsRuns())
+			oMask.computeRuns();
+	}
+	else if (oMask.needsRuns()) {
+		// stripes cover consecutive rows, so their runs are concatenated in stripe order (the serial path only fills the last list)
+		for (const CompactScratch& oScratch : m_voCompactScratch)
+			oMask.voRuns.insert(oMask.voRuns.end(), oScratch.voRuns.begin(), oScratch.voRuns.end());
+		oMask.vnRowRunOffsets.resize(oMask.oSize.height + 1);
+		oMask.vnRowRunOffsets[0] = 0;
+		for (int y = 0; y < oMask.oSize.height; ++y)
+			oMask.vnRowRunOffsets[y + 1] = oMask.vnRowRunOffsets[y] + m_vnCompactRowRunCounts[y];
+	}
+	if (oMask.has(CompactMask::Tiles))
+		oMask.computeTileCounts();
+	if (oMask.has(CompactMask::Blobs))
+		oMask.computeBlobs();
+}
+
+void BackgroundSubtractorViBe::forEachStripe(const std::function<void(size_t)>& lStripeFunc) {
+	if (!m_pThreadPool)
+		setNumThreads(std::max(1u, std::thread::hardware_concurrency()));
+	for (size_t nPhase = 0; nPhase < 2; ++nPhase) {
+		m_pThreadPool->parallelFor((m_voStripes.size() + 1 - nPhase) / 2, [&](size_t i) {
+			lStripeFunc(i * 2 + nPhase);
+		});
+	}
+}
@@ -0,0 +1,168 @@
+#include "BackgroundSubtractorViBeYUV.hpp"
+
+namespace {
+	/// model of interleaved chroma pairs (semi-planar UV) or of packed luma+chroma pairs (YUYV)
+	using BackgroundSubtractorViBe_2ch = BackgroundSubtractorViBeEngine<2, uint8_t, lv::L1Distance>;
+
+	inline bool isBayer(PixelFormat eFormat) {
+		return eFormat == PixelFormat::BayerBGGR || eFormat == PixelFormat::BayerRGGB || eFormat == PixelFormat::BayerGBRG || eFormat == PixelFormat::BayerGRBG;
+	}
+}
+
+YUVFrame YUVFrame::wrap(PixelFormat eFormat, const cv::Mat& oBuffer) {
+	YUVFrame oFrame;
+	oFrame.eFormat = eFormat;
+	oFrame.apPlanes[0] = oBuffer.data;
+	oFrame.anStrides[0] = oBuffer.step;
+	if (eFormat == PixelFormat::YUYV || eFormat == PixelFormat::UYVY) {
+		CV_Assert(oBuffer.type() == CV_8UC2);
+		oFrame.oSize = oBuffer.size();
+		return oFrame;
+	}
+	CV_Assert(oBuffer.type() == CV_8UC1);
+	if (isBayer(eFormat)) {
+		oFrame.oSize = oBuffer.size();
+		return oFrame;
+	}
+	CV_Assert((oBuffer.rows % 3) == 0);
+	oFrame.oSize = cv::Size(oBuffer.cols, oBuffer.rows * 2 / 3);
+	const uchar* pChroma = oBuffer.data + oFrame.oSize.height * oBuffer.step;
+	if (eFormat == PixelFormat::NV12 || eFormat == PixelFormat::NV21) {
+		oFrame.apPlanes[1] = pChroma;
+		oFrame.anStrides[1] = oBuffer.step;
+		return oFrame;
+	}
+	// planar chroma is packed at half the luma stride right after the luma rows
+	CV_Assert(oBuffer.isContinuous() && (oBuffer.cols % 2) == 0);
+	const size_t nChromaStride = oBuffer.step / 2;
+	const uchar* pSecondPlane = pChroma + (oFrame.oSize.height / 2) * nChromaStride;
+	oFrame.apPlanes[1] = (eFormat == PixelFormat::I420) ? pChroma : pSecondPlane;
+	oFrame.apPlanes[2] = (eFormat == PixelFormat::I420) ? pSecondPlane : pChroma;
+	oFrame.anStrides[1] = oFrame.anStrides[2] = nChromaStride;
+	return oFrame;
+}
+
+BackgroundSubtractorViBeYUV::BackgroundSubtractorViBeYUV(PixelFormat eFormat, ChromaMode eChromaMode,
+		size_t nColorDistThreshold, size_t nBGSamples, size_t nRequiredBGSamples, size_t learningRate) :
+	m_eFormat(eFormat) {
+	const auto lAddPlane = [&](bool bTwoChannels, int nPlaneIdx, int nRowOffset, size_t nChannelOffset, int nViewType, int nRowStep, int nScale) {
+		PlaneModel oPlane;
+		if (bTwoChannels)
+			oPlane.pModel = std::make_unique<BackgroundSubtractorViBe_2ch>(nColorDistThreshold, nBGSamples, nRequiredBGSamples, learningRate);
+		else
+			oPlane.pModel = std::make_unique<BackgroundSubtractorViBe_1ch>(nColorDistThreshold, nBGSamples, nRequiredBGSamples, learningRate);
+		oPlane.pModel->setInputChannelOffset(nChannelOffset);
+		oPlane.nPlaneIdx = nPlaneIdx;
+		oPlane.nRowOffset = nRowOffset;
+		oPlane.nViewType = nViewType;
+		oPlane.nRowStep = nRowStep;
+		oPlane.nScaleX = oPlane.nScaleY = nScale;
+		m_voPlanes.emplace_back(std::move(oPlane));
+	};
+	const bool bChroma = (eChromaMode == ChromaMode::LumaChroma);
+	switch (eFormat) {
+		case PixelFormat::NV12:
+		case PixelFormat::NV21:
+			lAddPlane(false, 0, 0, 0, CV_8UC1, 1, 1);
+			if (bChroma)
+				lAddPlane(true, 1, 0, 0, CV_8UC2, 1, 2);
+			break;
+		case PixelFormat::I420:
+		case PixelFormat::YV12:
+			lAddPlane(false, 0, 0, 0, CV_8UC1, 1, 1);
+			if (bChroma) {
+				lAddPlane(false, 1, 0, 0, CV_8UC1, 1, 2);
+				lAddPlane(false, 2, 0, 0, CV_8UC1, 1, 2);
+			}
+			break;
+		case PixelFormat::YUYV:
+		case PixelFormat::UYVY:
+			// each (Y, U or V) byte pair is one element of the view; the luma-only model only reads one channel of each element,
+			// the second one for UYVY
+			if (bChroma)
+				lAddPlane(true, 0, 0, 0, CV_8UC2, 1, 1);
+			else
+				lAddPlane(false, 0, 0, (eFormat == PixelFormat::UYVY) ? 1 : 0, CV_8UC2, 1, 1);
+			break;
+		default: {
+			// each Bayer site is a half-resolution view of column pairs skipping every other row, whose model reads the pair's first or
+			// second byte
+			CV_Assert(isBayer(eFormat));
+			const bool bGreenOnDiagonal = (eFormat == PixelFormat::BayerGBRG || eFormat == PixelFormat::BayerGRBG);
+			for (int nSite = 0; nSite < 4; ++nSite) {
+				const int nSiteX = nSite % 2, nSiteY = nSite / 2;
+				const bool bGreen = bGreenOnDiagonal ? (nSiteX == nSiteY) : (nSiteX != nSiteY);
+				if (bChroma || (bGreen && m_voPlanes.empty()))
+					lAddPlane(false, 0, nSiteY, (size_t)nSiteX, CV_8UC2, 2, 2);
+			}
+			break;
+		}
+	}
+}
+
+void BackgroundSubtractorViBeYUV::initialize(const YUVFrame& oInitFrame) {
+	CV_Assert(oInitFrame.eFormat == m_eFormat);
+	m_oFrameSize = oInitFrame.oSize;
+	for (PlaneModel& oPlane : m_voPlanes)
+		oPlane.pModel->initialize(getView(oPlane, oInitFrame));
+}
+
+void BackgroundSubtractorViBeYUV::apply(const YUVFrame& oFrame, cv::Mat& fgmask) {
+	applyPlanes(oFrame, fgmask, false);
+}
+
+void BackgroundSubtractorViBeYUV::initializeParallel(const YUVFrame& oInitFrame, const int numProcesses) {
+	CV_Assert(oInitFrame.eFormat == m_eFormat && numProcesses > 0);
+	m_oFrameSize = oInitFrame.oSize;
+	if (!m_pThreadPool)
+		setThreadPool(std::make_shared<ThreadPool>((size_t)numProcesses));
+	for (PlaneModel& oPlane : m_voPlanes)
+		oPlane.pModel->initializeParallel(getView(oPlane, oInitFrame), numProcesses);
+}
+
+void BackgroundSubtractorViBeYUV::applyParallel(const YUVFrame& oFrame, cv::Mat& fgmask) {
+	applyPlanes(oFrame, fgmask, true);
+}
+
+void BackgroundSubtractorViBeYUV::setRandomSeed(uint64_t nSeed) {
+	// each plane gets its own seed so that identical planes do not draw identical update decisions
+	for (size_t i = 0; i < m_voPlanes.size(); ++i)
+		m_voPlanes[i].pModel->setRandomSeed(nSeed + i);
+}
+
+void BackgroundSubtractorViBeYUV::setThreadPool(std::shared_ptr<ThreadPool> pThreadPool) {
+	m_pThreadPool = pThreadPool;
+	for (PlaneModel& oPlane : m_voPlanes)
+		oPlane.pModel->setThreadPool(pThreadPool);
+}
+
+cv::Mat BackgroundSubtractorViBeYUV::getView(const PlaneModel& oPlane, const YUVFrame& oFrame) const {
+	CV_Assert(oFrame.eFormat == m_eFormat && oFrame.oSize == m_oFrameSize && oFrame.apPlanes[oPlane.nPlaneIdx]);
+	const size_t nStride = oFrame.anStrides[oPlane.nPlaneIdx];
+	const uchar* pData = oFrame.apPlanes[oPlane.nPlaneIdx] + oPlane.nRowOffset * nStride;
+	return cv::Mat(m_oFrameSize.height / oPlane.nScaleY, m_oFrameSize.width / oPlane.nScaleX, oPlane.nViewType, (void*)pData, nStride * oPlane.nRowStep);
+}
+
+void BackgroundSubtractorViBeYUV::applyPlanes(const YUVFrame& oFrame, cv::Mat& fgmask, bool bParallel) {
+	fgmask.create(m_oFrameSize, CV_8UC1);
+	for (size_t i = 0; i < m_voPlanes.size(); ++i) {
+		PlaneModel& oPlane = m_voPlanes[i];
+		const bool bDirect = (i == 0 && oPlane.nScaleX == 1 && oPlane.nScaleY == 1);
+		cv::Mat& oPlaneFGMask = bDirect ? fgmask : oPlane.oFGMask;
+		if (bParallel)
+			oPlane.pModel->applyParallel(getView(oPlane, oFrame), oPlaneFGMask);
+		else
+			oPlane.pModel->apply(getView(oPlane, oFrame), oPlaneFGMask);
+		if (bDirect)
+			continue;
+		// nearest-neighbor upsampling of the plane mask, merged into the output (the first plane overwrites it)
+		for (int y = 0; y < m_oFrameSize.height; ++y) {
+			const uchar* pSrc = oPlaneFGMask.ptr<uchar>(std::min(y / oPlane.nScaleY, oPlaneFGMask.rows - 1));
+			uchar* pDst = fgmask.ptr<uchar>(y);
+			for (int x = 0; x < m_oFrameSize.width; ++x) {
+				const uchar nValue = pSrc[std::min(x / oPlane.nScaleX, oPlaneFGMask.cols - 1)];
+				pDst[x] = (i == 0) ? nValue : (uchar)(pDst[x] | nValue);
+			}
+		}
+	}
+}
@@ -0,0 +1,179 @@
+#include "CompactMask.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+
+namespace {
+	/// adds the left, center & right neighbors of each pixel of a packed word (as a 2-bit sum: bit 0 in nSum0, bit 1 in nSum1)
+	inline void addRowNeighbors(const uint64_t* pRow, size_t w, size_t nWords, int nWidth, uint64_t& nSum0, uint64_t& nSum1) {
+		const uint64_t nCenter = pRow[w];
+		uint64_t nLeft = (nCenter << 1) | (w > 0 ? pRow[w - 1] >> 63 : nCenter & 1);
+		uint64_t nRight = (nCenter >> 1) | (w + 1 < nWords ? pRow[w + 1] << 63 : 0);
+		if (w + 1 == nWords) {
+			// the pixel past the last one replicates it (padding bits are 0)
+			const int nLastBit = (nWidth - 1) % 64;
+			nRight |= ((nCenter >> nLastBit) & 1) << nLastBit;
+		}
+		nSum0 = nLeft ^ nCenter ^ nRight;
+		nSum1 = (nLeft & nCenter) | (nRight & (nLeft ^ nCenter));
+	}
+
+	/// returns the index of the first bit at or after nBegin (and before nEnd) that equals bValue, or nEnd if there is none
+	int findBit(const uint64_t* pWords, int nBegin, int nEnd, bool bValue) {
+		const uint64_t nFlip = bValue ? 0 : ~uint64_t(0);
+		int x = nBegin;
+		while (x < nEnd) {
+			const uint64_t nWord = (pWords[x / 64] ^ nFlip) >> (x % 64);
+			if (nWord)
+				return std::min(nEnd, x + std::countr_zero(nWord));
+			x = (x / 64 + 1) * 64;
+		}
+		return nEnd;
+	}
+}
+
+void CompactMask::unpack(cv::Mat& oMask) const {
+	CV_Assert(has(Bits) || has(Tiles) || has(Runs));
+	oMask.create(oSize, CV_8UC1);
+	if (!has(Bits) && !has(Tiles)) {
+		oMask = cv::Scalar(0);
+		for (int y = 0; y < oSize.height; ++y) {
+			uchar* pRow = oMask.ptr<uchar>(y);
+			for (size_t i = vnRowRunOffsets[y]; i < vnRowRunOffsets[y + 1]; ++i)
+				memset(pRow + voRuns[i].start, UCHAR_MAX, voRuns[i].size());
+		}
+		return;
+	}
+	for (int y = 0; y < oSize.height; ++y) {
+		const uint64_t* pWords = row(y);
+		uchar* pRow = oMask.ptr<uchar>(y);
+		for (int x = 0; x < oSize.width; ++x)
+			pRow[x] = ((pWords[x / 64] >> (x % 64)) & 1) ? UCHAR_MAX : 0;
+	}
+}
+
+size_t CompactMask::appendRowRuns(const uint64_t* pWords, int nWidth, std::vector<cv::Range>& voRuns) {
+	size_t nRuns = 0;
+	for (int x = findBit(pWords, 0, nWidth, true); x < nWidth; x = findBit(pWords, x, nWidth, true)) {
+		const int nStart = x;
+		x = findBit(pWords, x, nWidth, false);
+		voRuns.emplace_back(nStart, x);
+		++nRuns;
+	}
+	return nRuns;
+}
+
+void CompactMask::computeRuns() {
+	voRuns.clear();
+	vnRowRunOffsets.resize(oSize.height + 1);
+	vnRowRunOffsets[0] = 0;
+	for (int y = 0; y < oSize.height; ++y)
+		vnRowRunOffsets[y + 1] = vnRowRunOffsets[y] + appendRowRuns(row(y), oSize.width, voRuns);
+}
+
+void CompactMask::computeTileCounts() {
+	CV_Assert(nTileSize > 0 && vnBits.size() == nWordsPerRow * (size_t)oSize.height);
+	const int nTilesX = (oSize.width + nTileSize - 1) / nTileSize;
+	oTileCounts.create((oSize.height + nTileSize - 1) / nTileSize, nTilesX, CV_32SC1);
+	oTileCounts = cv::Scalar(0);
+	for (int y = 0; y < oSize.height; ++y) {
+		const uint64_t* pWords = row(y);
+		int32_t* pCounts = oTileCounts.ptr<int32_t>(y / nTileSize);
+		for (int tx = 0; tx < nTilesX; ++tx) {
+			// counts the bits of [nBegin,nEnd) word by word
+			const int nBegin = tx * nTileSize, nEnd = std::min(oSize.width, nBegin + nTileSize);
+			for (int x = nBegin; x < nEnd;) {
+				const int nBits = std::min(nEnd - x, 64 - x % 64);
+				const uint64_t nMask = (nBits == 64) ? ~uint64_t(0) : ((uint64_t(1) << nBits) - 1);
+				pCounts[tx] += std::popcount((pWords[x / 64] >> (x % 64)) & nMask);
+				x += nBits;
+			}
+		}
+	}
+}
+
+void CompactMask::computeBlobs() {
+	CV_Assert(vnRowRunOffsets.size() == (size_t)oSize.height + 1);
+	// union-find over the runs (vnRunLabels holds the parent of each run until the labels are assigned)
+	vnRunLabels.resize(voRuns.size());
+	for (size_t i = 0; i < voRuns.size(); ++i)
+		vnRunLabels[i] = (int32_t)i;
+	const auto lFind = [&](int32_t i) {
+		while (vnRunLabels[i] != i)
+			i = vnRunLabels[i] = vnRunLabels[vnRunLabels[i]];
+		return i;
+	};
+	for (int y = 1; y < oSize.height; ++y) {
+		size_t i = vnRowRunOffsets[y - 1], j = vnRowRunOffsets[y];
+		while (i < vnRowRunOffsets[y] && j < vnRowRunOffsets[y + 1]) {
+			// runs of consecutive rows are 8-connected if they overlap once extended by one pixel
+			if (voRuns[i].start <= voRuns[j].end && voRuns[j].start <= voRuns[i].end) {
+				const int32_t nRootA = lFind((int32_t)i), nRootB = lFind((int32_t)j);
+				// the smaller run index stays the root, so roots are the first runs of their components in raster order
+				vnRunLabels[std::max(nRootA, nRootB)] = std::min(nRootA, nRootB);
+			}
+			if (voRuns[i].end <= voRuns[j].end)
+				++i;
+			else
+				++j;
+		}
+	}
+	// parents always precede their children, so a single forward pass flattens all trees
+	for (size_t i = 0; i < voRuns.size(); ++i)
+		vnRunLabels[i] = vnRunLabels[vnRunLabels[i]];
+	voBlobs.clear();
+	std::vector<cv::Point2d> voSums;
+	for (int y = 0; y < oSize.height; ++y) {
+		for (size_t i = vnRowRunOffsets[y]; i < vnRowRunOffsets[y + 1]; ++i) {
+			// roots are the first runs of their components, so their label is already assigned when the other runs are visited
+			const int32_t nRoot = vnRunLabels[i];
+			vnRunLabels[i] = (nRoot == (int32_t)i) ? (int32_t)voBlobs.size() : vnRunLabels[nRoot];
+			if (nRoot == (int32_t)i) {
+				voBlobs.push_back(Blob{cv::Rect(voRuns[i].start, y, 0, 1), 0, cv::Point2f()});
+				voSums.emplace_back(0, 0);
+			}
+			Blob& oBlob = voBlobs[vnRunLabels[i]];
+			const cv::Range& oRun = voRuns[i];
+			const int nLeft = std::min(oBlob.oBBox.x, oRun.start), nRight = std::max(oBlob.oBBox.x + oBlob.oBBox.width, oRun.end);
+			oBlob.oBBox = cv::Rect(nLeft, oBlob.oBBox.y, nRight - nLeft, y + 1 - oBlob.oBBox.y);
+			oBlob.nArea += oRun.size();
+			voSums[vnRunLabels[i]].x += 0.5 * (oRun.start + oRun.end - 1) * oRun.size();
+			voSums[vnRunLabels[i]].y += (double)y * oRun.size();
+		}
+	}
+	// drops the small components & renumbers the others
+	std::vector<int32_t> vnNewLabels(voBlobs.size(), -1);
+	size_t nKept = 0;
+	for (size_t b = 0; b < voBlobs.size(); ++b) {
+		if (voBlobs[b].nArea < nMinBlobArea)
+			continue;
+		voBlobs[b].oCentroid = cv::Point2f((float)(voSums[b].x / voBlobs[b].nArea), (float)(voSums[b].y / voBlobs[b].nArea));
+		voBlobs[nKept] = voBlobs[b];
+		vnNewLabels[b] = (int32_t)nKept++;
+	}
+	voBlobs.resize(nKept);
+	for (int32_t& nLabel : vnRunLabels)
+		nLabel = vnNewLabels[nLabel];
+}
+
+void CompactMask::medianRow3x3(const uint64_t* pUpperRow, const uint64_t* pRow, const uint64_t* pLowerRow, int nWidth, uint64_t* pOutput) {
+	const size_t nWords = (size_t)(nWidth + 63) / 64;
+	for (size_t w = 0; w < nWords; ++w) {
+		uint64_t a0, a1, b0, b1, c0, c1;
+		addRowNeighbors(pUpperRow, w, nWords, nWidth, a0, a1);
+		addRowNeighbors(pRow, w, nWords, nWidth, b0, b1);
+		addRowNeighbors(pLowerRow, w, nWords, nWidth, c0, c1);
+		// adds the three 2-bit sums into a 4-bit one (t = a + b, u = t + c)
+		const uint64_t t0 = a0 ^ b0, k0 = a0 & b0;
+		const uint64_t t1 = a1 ^ b1 ^ k0, t2 = (a1 & b1) | (k0 & (a1 ^ b1));
+		const uint64_t u0 = t0 ^ c0, k1 = t0 & c0;
+		const uint64_t u1 = t1 ^ c1 ^ k1, k2 = (t1 & c1) | (k1 & (t1 ^ c1));
+		const uint64_t u2 = t2 ^ k2, u3 = t2 & k2;
+		// foreground if at least 5 of the 9 neighbors are
+		pOutput[w] = u3 | (u2 & (u1 | u0));
+	}
+	if (nWidth % 64)
+		pOutput[nWords - 1] &= (uint64_t(1) << (nWidth % 64)) - 1;
+}
@@ -0,0 +1,126 @@
+#include "ModelSnapshot.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const char s_acSnapshotMagic[8] = {'B', 'G', 'S', 'V', 'I', 'B', 'E', '\0'};
+
+	inline uint64_t alignSection(uint64_t nOffset) {
+		return (nOffset + ModelSnapshotHeader::s_nSectionAlign - 1) & ~(ModelSnapshotHeader::s_nSectionAlign - 1);
+	}
+
+	/// returns whether a section is aligned and lies within a file of the given size (written so that untrusted values cannot overflow)
+	inline bool isSectionValid(uint64_t nOffset, uint64_t nBytes, uint64_t nFileBytes) {
+		return (nOffset % ModelSnapshotHeader::s_nSectionAlign) == 0 && nOffset <= nFileBytes && nBytes <= nFileBytes - nOffset;
+	}
+
+	/// writes a section at its offset, zero-padding the gap since the previous one
+	void writeSection(FILE* pFile, uint64_t& nPosition, uint64_t nOffset, const void* pData, uint64_t nBytes) {
+		static const char s_acPadding[ModelSnapshotHeader::s_nSectionAlign] = {};
+		while (nPosition < nOffset) {
+			const uint64_t nPadding = std::min<uint64_t>(nOffset - nPosition, sizeof(s_acPadding));
+			if (fwrite(s_acPadding, 1, nPadding, pFile) != nPadding)
+				CV_Error(cv::Error::StsError, "could not write model snapshot");
+			nPosition += nPadding;
+		}
+		if (nBytes > 0 && fwrite(pData, 1, nBytes, pFile) != nBytes)
+			CV_Error(cv::Error::StsError, "could not write model snapshot");
+		nPosition += nBytes;
+	}
+}
+
+void ModelSnapshotHeader::layoutSections() {
+	memcpy(acMagic, s_acSnapshotMagic, sizeof(acMagic));
+	nVersion = s_nVersion;
+	nHeaderBytes = sizeof(ModelSnapshotHeader);
+	nStripeRNGOffset = alignSection(sizeof(ModelSnapshotHeader));
+	nROIMaskOffset = alignSection(nStripeRNGOffset + nStripeRNGBytes);
+	nModelOffset = alignSection(nROIMaskOffset + nROIMaskBytes);
+	nFileBytes = nModelOffset + nModelBytes;
+}
+
+bool ModelSnapshotHeader::isValid(uint64_t nActualFileBytes) const {
+	return nActualFileBytes >= sizeof(ModelSnapshotHeader) && memcmp(acMagic, s_acSnapshotMagic, sizeof(acMagic)) == 0 &&
+		nVersion == s_nVersion && nHeaderBytes == sizeof(ModelSnapshotHeader) && nFileBytes == nActualFileBytes &&
+		nStripeCount <= nFileBytes / (2 * sizeof(uint64_t)) && nStripeRNGBytes == nStripeCount * 2 * sizeof(uint64_t) &&
+		isSectionValid(nStripeRNGOffset, nStripeRNGBytes, nFileBytes) && isSectionValid(nROIMaskOffset, nROIMaskBytes, nFileBytes) &&
+		isSectionValid(nModelOffset, nModelBytes, nFileBytes);
+}
+
+void ModelSnapshot::write(const std::string& sPath) {
+	oHeader.nStripeRNGBytes = vnStripeRNGStates.size() * sizeof(uint64_t);
+	oHeader.nROIMaskBytes = oROIMask.empty() ? 0 : oROIMask.total();
+	oHeader.nModelBytes = vnModelData.size();
+	oHeader.layoutSections();
+	CV_Assert(oROIMask.empty() || oROIMask.isContinuous());
+	const std::string sTempPath = sPath + ".tmp";
+	FILE* pFile = fopen(sTempPath.c_str(), "wb");
+	if (pFile == nullptr)
+		CV_Error(cv::Error::StsError, "could not open model snapshot file for writing: " + sTempPath);
+	try {
+		uint64_t nPosition = 0;
+		writeSection(pFile, nPosition, 0, &oHeader, sizeof(oHeader));
+		writeSection(pFile, nPosition, oHeader.nStripeRNGOffset, vnStripeRNGStates.data(), oHeader.nStripeRNGBytes);
+		writeSection(pFile, nPosition, oHeader.nROIMaskOffset, oROIMask.data, oHeader.nROIMaskBytes);
+		writeSection(pFile, nPosition, oHeader.nModelOffset, vnModelData.data(), oHeader.nModelBytes);
+	}
+	catch (...) {
+		fclose(pFile);
+		std::remove(sTempPath.c_str());
+		throw;
+	}
+	if (fclose(pFile) != 0)
+		CV_Error(cv::Error::StsError, "could not write model snapshot: " + sTempPath);
+#ifdef _WIN32
+	std::remove(sPath.c_str()); // rename does not replace existing files on windows
+#endif
+	if (std::rename(sTempPath.c_str(), sPath.c_str()) != 0)
+		CV_Error(cv::Error::StsError, "could not rename model snapshot to " + sPath);
+}
+
+MappedModelSnapshot MappedModelSnapshot::open(const std::string& sPath) {
+	MappedModelSnapshot oSnapshot;
+	uint64_t nFileBytes;
+#ifdef _WIN32
+	// no mapping here; the file is read in an aligned buffer instead
+	std::ifstream oFile(sPath, std::ios::binary | std::ios::ate);
+	if (!oFile)
+		CV_Error(cv::Error::StsError, "could not open model snapshot: " + sPath);
+	nFileBytes = (uint64_t)oFile.tellg();
+	oSnapshot.pData = (uchar*)cv::fastMalloc(std::max<uint64_t>(nFileBytes, 1));
+	oSnapshot.pMapping = std::shared_ptr<void>(oSnapshot.pData, [](void* p) {cv::fastFree(p);});
+	oFile.seekg(0);
+	if (!oFile.read((char*)oSnapshot.pData, nFileBytes))
+		CV_Error(cv::Error::StsError, "could not read model snapshot: " + sPath);
+#else
+	const int nFD = ::open(sPath.c_str(), O_RDONLY);
+	if (nFD < 0)
+		CV_Error(cv::Error::StsError, "could not open model snapshot: " + sPath);
+	struct stat oStat;
+	if (fstat(nFD, &oStat) != 0 || oStat.st_size <= 0) {
+		::close(nFD);
+		CV_Error(cv::Error::StsError, "could not read model snapshot: " + sPath);
+	}
+	nFileBytes = (uint64_t)oStat.st_size;
+	void* pMapping = mmap(nullptr, nFileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, nFD, 0);
+	::close(nFD);
+	if (pMapping == MAP_FAILED)
+		CV_Error(cv::Error::StsError, "could not map model snapshot: " + sPath);
+	oSnapshot.pData = (uchar*)pMapping;
+	oSnapshot.pMapping = std::shared_ptr<void>(pMapping, [nFileBytes](void* p) {munmap(p, nFileBytes);});
+#endif
+	oSnapshot.pHeader = (const ModelSnapshotHeader*)oSnapshot.pData;
+	if (!oSnapshot.pHeader->isValid(nFileBytes))
+		CV_Error(cv::Error::StsError, "invalid or incompatible model snapshot: " + sPath);
+	return oSnapshot;
+}
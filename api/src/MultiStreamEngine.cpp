@@ -0,0 +1,177 @@
+#include "MultiStreamEngine.hpp"
+
+MultiStreamEngine::MultiStreamEngine(std::shared_ptr<ThreadPool> pThreadPool) :
+	m_pThreadPool(pThreadPool ? std::move(pThreadPool) : std::make_shared<ThreadPool>()),
+	m_nNextStreamId(0),
+	m_nInFlight(0) {}
+
+MultiStreamEngine::~MultiStreamEngine() {
+	std::unique_lock<std::mutex> oLock(m_oMutex);
+	for (auto& oPair : m_mpStreams) {
+		oPair.second->bRemoved = true;
+		oPair.second->voPending.clear();
+	}
+	m_oIdleCond.wait(oLock, [&]() {
+		for (const auto& oPair : m_mpStreams)
+			if (oPair.second->nCopying > 0)
+				return false;
+		return m_nInFlight == 0;
+	});
+}
+
+MultiStreamEngine::StreamId MultiStreamEngine::addStream(std::unique_ptr<BackgroundSubtractorViBe> pSubtractor, const cv::Mat& oInitFrame,
+		ResultCallback lCallback, double dDeadline, size_t nQueueDepth) {
+	CV_Assert(pSubtractor && !oInitFrame.empty() && lCallback && dDeadline >= 0 && nQueueDepth > 0);
+	auto pStream = std::make_shared<Stream>();
+	pSubtractor->setThreadPool(m_pThreadPool);
+	pSubtractor->initializeParallel(oInitFrame, (int)m_pThreadPool->size());
+	pStream->pSubtractor = std::move(pSubtractor);
+	pStream->lCallback = std::move(lCallback);
+	pStream->oDeadline = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dDeadline));
+	pStream->voFrames.resize(nQueueDepth + 1);
+	for (size_t i = 0; i < pStream->voFrames.size(); ++i) {
+		pStream->voFrames[i].create(oInitFrame.size(), oInitFrame.type());
+		pStream->vnFreeSlots.push_back(i);
+	}
+	pStream->oFGMask.create(oInitFrame.size(), CV_8UC1);
+	std::lock_guard<std::mutex> oLock(m_oMutex);
+	pStream->nId = m_nNextStreamId++;
+	m_mpStreams[pStream->nId] = pStream;
+	return pStream->nId;
+}
+
+void MultiStreamEngine::removeStream(StreamId nStreamId) {
+	std::unique_lock<std::mutex> oLock(m_oMutex);
+	const std::shared_ptr<Stream> pStream = getStream(nStreamId);
+	pStream->bRemoved = true;
+	pStream->voPending.clear();
+	m_oIdleCond.wait(oLock, [&]() {return !pStream->bBusy && pStream->nCopying == 0;});
+	m_mpStreams.erase(nStreamId);
+}
+
+bool MultiStreamEngine::pushFrame(StreamId nStreamId, const cv::Mat& oFrame) {
+	std::shared_ptr<Stream> pStream;
+	size_t nSlotIdx;
+	bool bDropped = false;
+	{
+		std::lock_guard<std::mutex> oLock(m_oMutex);
+		pStream = getStream(nStreamId);
+		CV_Assert(oFrame.size() == pStream->voFrames[0].size() && oFrame.type() == pStream->voFrames[0].type());
+		if (pStream->vnFreeSlots.empty()) {
+			// queue overflow: the oldest pending frame makes room for the newest one
+			CV_Assert(!pStream->voPending.empty());
+			pStream->vnFreeSlots.push_back(pStream->voPending.front().nSlotIdx);
+			pStream->voPending.pop_front();
+			++pStream->oStats.nDropped;
+			bDropped = true;
+		}
+		nSlotIdx = pStream->vnFreeSlots.back();
+		pStream->vnFreeSlots.pop_back();
+		++pStream->nCopying;
+	}
+	// the slot is reserved, so the copy can happen outside of the lock
+	oFrame.copyTo(pStream->voFrames[nSlotIdx]);
+	std::lock_guard<std::mutex> oLock(m_oMutex);
+	--pStream->nCopying;
+	if (pStream->bRemoved) {
+		pStream->vnFreeSlots.push_back(nSlotIdx);
+		m_oIdleCond.notify_all();
+		return !bDropped;
+	}
+	const Clock::time_point tArrival = Clock::now();
+	const Clock::time_point tDeadline = (pStream->oDeadline > Clock::duration::zero()) ? tArrival + pStream->oDeadline : Clock::time_point::max();
+	pStream->voPending.push_back(PendingFrame{nSlotIdx, pStream->nNextFrameIdx++, tArrival, tDeadline});
+	schedule();
+	return !bDropped;
+}
+
+void MultiStreamEngine::flush() {
+	std::unique_lock<std::mutex> oLock(m_oMutex);
+	m_oIdleCond.wait(oLock, [&]() {
+		for (const auto& oPair : m_mpStreams)
+			if (!oPair.second->voPending.empty() || oPair.second->nCopying > 0)
+				return false;
+		return m_nInFlight == 0;
+	});
+	if (m_pException) {
+		std::exception_ptr pException = m_pException;
+		m_pException = nullptr;
+		std::rethrow_exception(pException);
+	}
+}
+
+MultiStreamEngine::StreamStats MultiStreamEngine::getStats(StreamId nStreamId) const {
+	std::lock_guard<std::mutex> oLock(m_oMutex);
+	return getStream(nStreamId)->oStats;
+}
+
+size_t MultiStreamEngine::getStreamCount() const {
+	std::lock_guard<std::mutex> oLock(m_oMutex);
+	return m_mpStreams.size();
+}
+
+void MultiStreamEngine::schedule() {
+	const Clock::time_point tNow = Clock::now();
+	while (m_nInFlight < m_pThreadPool->size()) {
+		Stream* pNext = nullptr;
+		for (auto& oPair : m_mpStreams) {
+			Stream& oStream = *oPair.second;
+			if (oStream.bBusy || oStream.voPending.empty())
+				continue;
+			// a frame already past its deadline is skipped when a newer one is waiting on the same stream
+			while (oStream.voPending.size() > 1 && oStream.voPending.front().tDeadline < tNow) {
+				oStream.vnFreeSlots.push_back(oStream.voPending.front().nSlotIdx);
+				oStream.voPending.pop_front();
+				++oStream.oStats.nDropped;
+			}
+			const PendingFrame& oFrame = oStream.voPending.front();
+			if (!pNext || oFrame.tDeadline < pNext->voPending.front().tDeadline ||
+					(oFrame.tDeadline == pNext->voPending.front().tDeadline && oFrame.tArrival < pNext->voPending.front().tArrival))
+				pNext = &oStream;
+		}
+		if (!pNext)
+			return;
+		const PendingFrame oFrame = pNext->voPending.front();
+		pNext->voPending.pop_front();
+		pNext->bBusy = true;
+		++m_nInFlight;
+		m_pThreadPool->submit([this, pStream = m_mpStreams[pNext->nId], oFrame]() {
+			process(pStream, oFrame);
+		});
+	}
+}
+
+void MultiStreamEngine::process(const std::shared_ptr<Stream>& pStream, const PendingFrame& oFrame) {
+	std::exception_ptr pException;
+	bool bDeadlineMissed = false;
+	double dLatency = 0;
+	try {
+		// the stripes of this frame are queued on the shared pool, interleaved with those of the other in-flight streams (while waiting,
+		// this worker only helps with its own stripes, so another stream's frame never runs nested under this one)
+		pStream->pSubtractor->applyParallel(pStream->voFrames[oFrame.nSlotIdx], pStream->oFGMask);
+		const Clock::time_point tDone = Clock::now();
+		dLatency = std::chrono::duration<double>(tDone - oFrame.tArrival).count();
+		bDeadlineMissed = tDone > oFrame.tDeadline;
+		pStream->lCallback(pStream->nId, FrameResult{oFrame.nFrameIdx, pStream->oFGMask, dLatency, bDeadlineMissed});
+	}
+	catch (...) {
+		pException = std::current_exception();
+	}
+	std::lock_guard<std::mutex> oLock(m_oMutex);
+	if (pException && !m_pException)
+		m_pException = pException;
+	++pStream->oStats.nProcessed;
+	pStream->oStats.nDeadlineMisses += bDeadlineMissed ? 1 : 0;
+	pStream->oStats.dMaxLatency = std::max(pStream->oStats.dMaxLatency, dLatency);
+	pStream->vnFreeSlots.push_back(oFrame.nSlotIdx);
+	pStream->bBusy = false;
+	--m_nInFlight;
+	schedule();
+	m_oIdleCond.notify_all();
+}
+
+const std::shared_ptr<MultiStreamEngine::Stream>& MultiStreamEngine::getStream(StreamId nStreamId) const {
+	const auto oIter = m_mpStreams.find(nStreamId);
+	CV_Assert(oIter != m_mpStreams.end() && !oIter->second->bRemoved);
+	return oIter->second;
+}
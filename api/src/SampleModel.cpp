@@ -0,0 +1,87 @@
+#include "SampleModel.hpp"
+
+#include <utility>
+
+SampleModel::SampleModel(Layout eLayout) :
+	m_eLayout(eLayout),
+	m_nSamples(0),
+	m_nType(CV_8UC1),
+	m_nElemSize(0),
+	m_nSampleStride(0),
+	m_nPixelStride(0),
+	m_nRowStride(0),
+	m_nTotalBytes(0),
+	m_pData(nullptr) {}
+
+SampleModel::~SampleModel() {
+	release();
+}
+
+void SampleModel::create(const cv::Size& oSize, size_t nSamples, int nType) {
+	const size_t nPrevTotalBytes = m_nTotalBytes;
+	if (m_pOwner)
+		release();
+	setGeometry(oSize, nSamples, nType);
+	if (m_pData == nullptr || m_nTotalBytes != nPrevTotalBytes) {
+		if (m_pData != nullptr)
+			cv::fastFree(m_pData);
+		m_pData = (uchar*)cv::fastMalloc(m_nTotalBytes);
+	}
+}
+
+void SampleModel::attach(uchar* pData, size_t nBytes, const cv::Size& oSize, size_t nSamples, int nType, std::shared_ptr<void> pOwner) {
+	CV_Assert(pData != nullptr && pOwner);
+	release();
+	setGeometry(oSize, nSamples, nType);
+	CV_Assert(nBytes == m_nTotalBytes);
+	m_pData = pData;
+	m_pOwner = std::move(pOwner);
+}
+
+void SampleModel::release() {
+	if (m_pOwner)
+		m_pOwner.reset();
+	else if (m_pData != nullptr)
+		cv::fastFree(m_pData);
+	m_pData = nullptr;
+	m_nTotalBytes = 0;
+}
+
+void SampleModel::swap(SampleModel& oOther) {
+	CV_Assert(m_eLayout == oOther.m_eLayout);
+	std::swap(m_oSize, oOther.m_oSize);
+	std::swap(m_nSamples, oOther.m_nSamples);
+	std::swap(m_nType, oOther.m_nType);
+	std::swap(m_nElemSize, oOther.m_nElemSize);
+	std::swap(m_nSampleStride, oOther.m_nSampleStride);
+	std::swap(m_nPixelStride, oOther.m_nPixelStride);
+	std::swap(m_nRowStride, oOther.m_nRowStride);
+	std::swap(m_nTotalBytes, oOther.m_nTotalBytes);
+	std::swap(m_pData, oOther.m_pData);
+	std::swap(m_pOwner, oOther.m_pOwner);
+}
+
+void SampleModel::setGeometry(const cv::Size& oSize, size_t nSamples, int nType) {
+	CV_Assert(oSize.width > 0 && oSize.height > 0 && nSamples > 0);
+	m_nElemSize = (size_t)CV_ELEM_SIZE(nType);
+	if (m_eLayout == Layout::Planar) {
+		// each plane starts on its own cache line so the vectorized kernels see identically aligned rows
+		m_nPixelStride = m_nElemSize;
+		m_nRowStride = m_nPixelStride * oSize.width;
+		m_nSampleStride = cv::alignSize(m_nRowStride * oSize.height, CV_MALLOC_ALIGN);
+		m_nTotalBytes = m_nSampleStride * nSamples;
+	} else {
+		m_nSampleStride = m_nElemSize;
+		m_nPixelStride = m_nSampleStride * nSamples;
+		m_nRowStride = m_nPixelStride * oSize.width;
+		m_nTotalBytes = m_nRowStride * oSize.height;
+	}
+	m_oSize = oSize;
+	m_nSamples = nSamples;
+	m_nType = nType;
+}
+
+cv::Mat SampleModel::plane(size_t nSampleIdx) const {
+	CV_Assert(m_eLayout == Layout::Planar && nSampleIdx < m_nSamples && !empty());
+	return cv::Mat(m_oSize, m_nType, (void*)ptr(nSampleIdx, 0), m_nRowStride);
+}
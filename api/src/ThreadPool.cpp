@@ -0,0 +1,135 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+	/// pool & queue index of the worker running on the current thread (if any)
+	thread_local const ThreadPool* s_pCurrentPool = nullptr;
+	thread_local size_t s_nCurrentWorkerIdx = 0;
+}
+
+ThreadPool::ThreadPool(size_t nThreads) :
+	m_nQueuedTasks(0),
+	m_nNextQueueIdx(0),
+	m_bStopping(false) {
+	if (nThreads == 0)
+		nThreads = std::max(1u, std::thread::hardware_concurrency());
+	m_vpQueues.reserve(nThreads);
+	for (size_t t = 0; t < nThreads; ++t)
+		m_vpQueues.emplace_back(std::make_unique<WorkerQueue>());
+	m_voThreads.reserve(nThreads);
+	for (size_t t = 0; t < nThreads; ++t)
+		m_voThreads.emplace_back(&ThreadPool::workerLoop, this, t);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> oLock(m_oWakeMutex);
+		m_bStopping = true;
+	}
+	m_oWakeCond.notify_all();
+	for (std::thread& oThread : m_voThreads)
+		oThread.join();
+}
+
+void ThreadPool::submit(std::function<void()> lTask) {
+	const size_t nQueueIdx = (s_pCurrentPool == this) ? s_nCurrentWorkerIdx : (m_nNextQueueIdx++ % m_vpQueues.size());
+	push(nQueueIdx, nullptr, std::move(lTask));
+}
+
+void ThreadPool::parallelFor(size_t nTasks, const std::function<void(size_t)>& lTask) {
+	if (nTasks == 0)
+		return;
+	struct Completion {
+		std::atomic<size_t> nRemaining;
+		std::mutex oMutex;
+		std::condition_variable oCond;
+		std::exception_ptr pException;
+	};
+	auto pCompletion = std::make_shared<Completion>();
+	pCompletion->nRemaining = nTasks;
+	// contiguous blocks of task indices go to each queue to keep neighboring work on the same worker unless stolen
+	const size_t nQueues = m_vpQueues.size();
+	for (size_t i = 0; i < nTasks; ++i) {
+		push((i * nQueues) / nTasks, pCompletion.get(), [pCompletion, &lTask, i]() {
+			try {
+				lTask(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> oLock(pCompletion->oMutex);
+				if (!pCompletion->pException)
+					pCompletion->pException = std::current_exception();
+			}
+			if (--pCompletion->nRemaining == 0) {
+				std::lock_guard<std::mutex> oLock(pCompletion->oMutex);
+				pCompletion->oCond.notify_all();
+			}
+		});
+	}
+	const size_t nOwnQueueIdx = (s_pCurrentPool == this) ? s_nCurrentWorkerIdx : 0;
+	while (pCompletion->nRemaining > 0) {
+		// only this call's tasks are helped with, since any other one (e.g. a whole frame submitted to the pool) would delay its return
+		if (!tryRunOne(nOwnQueueIdx, pCompletion.get())) {
+			std::unique_lock<std::mutex> oLock(pCompletion->oMutex);
+			pCompletion->oCond.wait(oLock, [&]() {return pCompletion->nRemaining == 0;});
+		}
+	}
+	if (pCompletion->pException)
+		std::rethrow_exception(pCompletion->pException);
+}
+
+void ThreadPool::push(size_t nQueueIdx, const void* pBatch, std::function<void()>&& lTask) {
+	{
+		std::lock_guard<std::mutex> oLock(m_vpQueues[nQueueIdx]->oMutex);
+		m_vpQueues[nQueueIdx]->oTasks.push_back(Task{pBatch, std::move(lTask)});
+	}
+	{
+		// the counter is bumped under the wake mutex so that a worker about to sleep cannot miss it
+		std::lock_guard<std::mutex> oLock(m_oWakeMutex);
+		++m_nQueuedTasks;
+	}
+	m_oWakeCond.notify_one();
+}
+
+bool ThreadPool::tryRunOne(size_t nQueueIdx, const void* pBatch) {
+	std::function<void()> lTask;
+	const size_t nQueues = m_vpQueues.size();
+	const auto lIsEligible = [pBatch](const Task& oTask) {return !pBatch || oTask.pBatch == pBatch;};
+	for (size_t n = 0; n < nQueues && !lTask; ++n) {
+		WorkerQueue& oQueue = *m_vpQueues[(nQueueIdx + n) % nQueues];
+		std::lock_guard<std::mutex> oLock(oQueue.oMutex);
+		if (n == 0) {
+			const auto oIter = std::find_if(oQueue.oTasks.begin(), oQueue.oTasks.end(), lIsEligible);
+			if (oIter == oQueue.oTasks.end())
+				continue;
+			lTask = std::move(oIter->lFunc);
+			oQueue.oTasks.erase(oIter);
+		}
+		else {
+			const auto oIter = std::find_if(oQueue.oTasks.rbegin(), oQueue.oTasks.rend(), lIsEligible);
+			if (oIter == oQueue.oTasks.rend())
+				continue;
+			lTask = std::move(oIter->lFunc);
+			oQueue.oTasks.erase(std::next(oIter).base());
+		}
+	}
+	if (!lTask)
+		return false;
+	--m_nQueuedTasks;
+	lTask();
+	return true;
+}
+
+void ThreadPool::workerLoop(size_t nWorkerIdx) {
+	s_pCurrentPool = this;
+	s_nCurrentWorkerIdx = nWorkerIdx;
+	while (true) {
+		if (tryRunOne(nWorkerIdx))
+			continue;
+		std::unique_lock<std::mutex> oLock(m_oWakeMutex);
+		m_oWakeCond.wait(oLock, [&]() {return m_bStopping || m_nQueuedTasks > 0;});
+		if (m_bStopping && m_nQueuedTasks == 0)
+			return;
+	}
+}
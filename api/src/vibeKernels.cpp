@@ -0,0 +1,175 @@
+#include "vibeKernels.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BGSVIBE_DISPATCH_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace {
+
+	/// instruction sets supported by the CPU (and enabled by the OS, for the wider registers)
+	struct CpuFeatures {
+		bool bSSE2{false}, bSSE4_2{false}, bAVX2{false}, bAVX512{false}, bNEON{false};
+	};
+
+#if defined(BGSVIBE_DISPATCH_X86)
+	void cpuid(uint32_t nLeaf, uint32_t nSubLeaf, uint32_t (&anRegs)[4]) {
+#if defined(_MSC_VER)
+		int anInfo[4];
+		__cpuidex(anInfo, (int)nLeaf, (int)nSubLeaf);
+		for (int i = 0; i < 4; ++i)
+			anRegs[i] = (uint32_t)anInfo[i];
+#else
+		__cpuid_count(nLeaf, nSubLeaf, anRegs[0], anRegs[1], anRegs[2], anRegs[3]);
+#endif
+	}
+
+	/// returns the register states saved by the OS on context switches (XCR0)
+	uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t nLow, nHigh;
+		__asm__ volatile("xgetbv" : "=a"(nLow), "=d"(nHigh) : "c"(0));
+		return ((uint64_t)nHigh << 32) | nLow;
+#endif
+	}
+#endif
+
+	CpuFeatures queryCpuFeatures() {
+		CpuFeatures oFeatures;
+#if defined(BGSVIBE_DISPATCH_X86)
+		uint32_t anRegs[4]; // eax, ebx, ecx, edx
+		cpuid(0, 0, anRegs);
+		const uint32_t nMaxLeaf = anRegs[0];
+		if (nMaxLeaf < 1)
+			return oFeatures;
+		cpuid(1, 0, anRegs);
+		const auto lBit = [&](int nReg, int nBit) {return ((anRegs[nReg] >> nBit) & 1) != 0;};
+		oFeatures.bSSE2 = lBit(3, 26);
+		oFeatures.bSSE4_2 = lBit(2, 9) && lBit(2, 19) && lBit(2, 20); // SSSE3, SSE4.1 & SSE4.2
+		const bool bAVX = lBit(2, 28);
+		// the AVX & AVX-512 registers are only usable if the OS saves them (XMM, YMM, then opmask & ZMM states)
+		const uint64_t nXCR0 = lBit(2, 27) ? xgetbv0() : 0;
+		const bool bYMMState = (nXCR0 & 0x06) == 0x06, bZMMState = (nXCR0 & 0xE6) == 0xE6;
+		if (nMaxLeaf >= 7) {
+			cpuid(7, 0, anRegs);
+			oFeatures.bAVX2 = bAVX && bYMMState && lBit(1, 5);
+			oFeatures.bAVX512 = oFeatures.bAVX2 && bZMMState && lBit(1, 16) && lBit(1, 30); // AVX512F & AVX512BW
+		}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+		oFeatures.bNEON = true; // mandatory in ARMv8-A
+#elif defined(__arm__) && defined(__linux__)
+		oFeatures.bNEON = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+		return oFeatures;
+	}
+
+	const CpuFeatures& getCpuFeatures() {
+		static const CpuFeatures s_oFeatures = queryCpuFeatures();
+		return s_oFeatures;
+	}
+
+	/// returns the kernel table of the given variant, or null if it was not built
+	const lv::KernelTable* getBuiltKernelTable(lv::KernelIsa eIsa) {
+		switch (eIsa) {
+			case lv::KernelIsa::Scalar:
+				return &lv::impl::g_oKernelTable_Scalar;
+#if defined(BGSVIBE_BUILD_KERNEL_SSE2)
+			case lv::KernelIsa::SSE2:
+				return &lv::impl::g_oKernelTable_SSE2;
+#endif
+#if defined(BGSVIBE_BUILD_KERNEL_SSE4_2)
+			case lv::KernelIsa::SSE4_2:
+				return &lv::impl::g_oKernelTable_SSE4_2;
+#endif
+#if defined(BGSVIBE_BUILD_KERNEL_AVX2)
+			case lv::KernelIsa::AVX2:
+				return &lv::impl::g_oKernelTable_AVX2;
+#endif
+#if defined(BGSVIBE_BUILD_KERNEL_AVX512)
+			case lv::KernelIsa::AVX512:
+				return &lv::impl::g_oKernelTable_AVX512;
+#endif
+#if defined(BGSVIBE_BUILD_KERNEL_NEON)
+			case lv::KernelIsa::NEON:
+				return &lv::impl::g_oKernelTable_NEON;
+#endif
+			default:
+				return nullptr;
+		}
+	}
+
+	bool isSupportedByCpu(lv::KernelIsa eIsa) {
+		const CpuFeatures& oFeatures = getCpuFeatures();
+		switch (eIsa) {
+			case lv::KernelIsa::Scalar: return true;
+			case lv::KernelIsa::SSE2: return oFeatures.bSSE2;
+			case lv::KernelIsa::SSE4_2: return oFeatures.bSSE4_2;
+			case lv::KernelIsa::AVX2: return oFeatures.bAVX2;
+			case lv::KernelIsa::AVX512: return oFeatures.bAVX512;
+			case lv::KernelIsa::NEON: return oFeatures.bNEON;
+			default: return false;
+		}
+	}
+
+	/// picks the variant requested by BGSVIBE_KERNEL_ISA if it is available, and the best available one otherwise
+	const lv::KernelTable* selectKernelTable() {
+		if (const char* sRequested = std::getenv("BGSVIBE_KERNEL_ISA"))
+			for (int n = 0; n < (int)lv::KernelIsa::Count; ++n)
+				if (std::strcmp(sRequested, lv::getKernelIsaName((lv::KernelIsa)n)) == 0 && lv::isKernelIsaAvailable((lv::KernelIsa)n))
+					return getBuiltKernelTable((lv::KernelIsa)n);
+		// variants are declared from the least to the most capable one
+		for (int n = (int)lv::KernelIsa::Count - 1; n > 0; --n)
+			if (lv::isKernelIsaAvailable((lv::KernelIsa)n))
+				return getBuiltKernelTable((lv::KernelIsa)n);
+		return &lv::impl::g_oKernelTable_Scalar;
+	}
+
+	std::atomic<const lv::KernelTable*>& getActiveKernelTable() {
+		static std::atomic<const lv::KernelTable*> s_pTable{selectKernelTable()};
+		return s_pTable;
+	}
+}
+
+const lv::KernelTable& lv::getKernelTable() {
+	return *getActiveKernelTable().load(std::memory_order_relaxed);
+}
+
+lv::KernelIsa lv::getKernelIsa() {
+	return getKernelTable().eIsa;
+}
+
+bool lv::isKernelIsaAvailable(KernelIsa eIsa) {
+	return getBuiltKernelTable(eIsa) != nullptr && isSupportedByCpu(eIsa);
+}
+
+bool lv::setKernelIsa(KernelIsa eIsa) {
+	if (!isKernelIsaAvailable(eIsa))
+		return false;
+	getActiveKernelTable().store(getBuiltKernelTable(eIsa), std::memory_order_relaxed);
+	return true;
+}
+
+const char* lv::getKernelIsaName(KernelIsa eIsa) {
+	switch (eIsa) {
+		case KernelIsa::Scalar: return "scalar";
+		case KernelIsa::SSE2: return "sse2";
+		case KernelIsa::SSE4_2: return "sse4.2";
+		case KernelIsa::AVX2: return "avx2";
+		case KernelIsa::AVX512: return "avx512";
+		case KernelIsa::NEON: return "neon";
+		default: return "unknown";
+	}
+}
@@ -0,0 +1,5 @@
+// AVX2 variant of the row kernels (see 'vibeKernelsImpl.hpp'), built with the AVX2 flags of the dispatch variants of 'cmake/checks/simd'
+#define BGSVIBE_KERNEL_AVX2 1
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_AVX2 = makeKernelTable(lv::KernelIsa::AVX2);
@@ -0,0 +1,5 @@
+// AVX-512 variant of the row kernels (see 'vibeKernelsImpl.hpp'), built with the AVX512 flags of the dispatch variants of 'cmake/checks/simd'
+#define BGSVIBE_KERNEL_AVX512 1
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_AVX512 = makeKernelTable(lv::KernelIsa::AVX512);
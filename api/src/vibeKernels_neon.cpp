@@ -0,0 +1,5 @@
+// NEON variant of the row kernels (see 'vibeKernelsImpl.hpp'), built with the NEON flags of the dispatch variants of 'cmake/checks/simd'
+#define BGSVIBE_KERNEL_NEON 1
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_NEON = makeKernelTable(lv::KernelIsa::NEON);
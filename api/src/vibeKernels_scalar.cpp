@@ -0,0 +1,4 @@
+// scalar variant of the row kernels (see 'vibeKernelsImpl.hpp'), always built with the baseline flags of the target
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_Scalar = makeKernelTable(lv::KernelIsa::Scalar);
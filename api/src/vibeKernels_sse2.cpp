@@ -0,0 +1,5 @@
+// SSE2 variant of the row kernels (see 'vibeKernelsImpl.hpp'), built with the SSE2 flags of the dispatch variants of 'cmake/checks/simd'
+#define BGSVIBE_KERNEL_SSE2 1
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_SSE2 = makeKernelTable(lv::KernelIsa::SSE2);
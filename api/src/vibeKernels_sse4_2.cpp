@@ -0,0 +1,5 @@
+// SSE4.2 variant of the row kernels (see 'vibeKernelsImpl.hpp'), built with the SSE4_2 flags of the dispatch variants of 'cmake/checks/simd'
+#define BGSVIBE_KERNEL_SSE4_2 1
+#include "vibeKernelsImpl.hpp"
+
+const lv::KernelTable lv::impl::g_oKernelTable_SSE4_2 = makeKernelTable(lv::KernelIsa::SSE4_2);
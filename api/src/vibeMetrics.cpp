@@ -0,0 +1,33 @@
+#include "vibeMetrics.hpp"
+
+#include <iomanip>
+
+namespace {
+	void printLatency(std::ostream& os, const char* sName, const lv::LatencyHistogram& oHistogram) {
+		os << "  " << std::left << std::setw(16) << sName << std::right << std::fixed << std::setprecision(3)
+		   << "mean " << std::setw(9) << oHistogram.meanNs() * 1e-6 << " ms   p50 " << std::setw(9) << oHistogram.percentileNs(0.5) * 1e-6
+		   << " ms   p99 " << std::setw(9) << oHistogram.percentileNs(0.99) * 1e-6 << " ms   max " << std::setw(9) << oHistogram.nMaxNs * 1e-6 << " ms\n";
+	}
+}
+
+void ViBeMetrics::print(std::ostream& os) const {
+	if (!s_bEnabled) {
+		os << "ViBe metrics: not compiled in (build with USE_METRICS)\n";
+		return;
+	}
+	using Counter = ViBeStripeMetrics::Counter;
+	const uint64_t nClassified = get(Counter::ClassifiedPixels);
+	os << "ViBe metrics over " << nFrames << " frames:\n";
+	printLatency(os, "frame", oFrameLatency);
+	printLatency(os, "classify (cpu)", oClassifyTime);
+	printLatency(os, "update (cpu)", oUpdateTime);
+	if (oStripeLatency.nCount > 0) {
+		printLatency(os, "stripe", oStripeLatency);
+		os << "  stripe imbalance: last " << std::setprecision(2) << dLastStripeImbalance << "   max " << dMaxStripeImbalance << "\n";
+	}
+	os << "  pixels: " << nClassified << " classified, " << get(Counter::GatedPixels) << " gated, " << get(Counter::ForegroundPixels) << " foreground (last frame ratio "
+	   << std::setprecision(4) << dLastForegroundRatio << ")\n"
+	   << "  updates: " << get(Counter::SelfUpdates) << " self, " << get(Counter::NeighborUpdates) << " neighbor, "
+	   << get(Counter::ReclassifiedPixels) << " re-classified pixels\n"
+	   << "  samples tested per pixel: " << std::setprecision(2) << samplesTestedPerPixel() << "\n";
+}
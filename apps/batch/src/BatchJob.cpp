@@ -0,0 +1,231 @@
+#include "BatchJob.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "profiling.hpp"
+
+namespace {
+    /// file extensions read from image directories (lower case)
+    const char* const s_asImageExtensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".ppm", ".pgm", ".webp"};
+
+    /// returns the name under which the outputs of an input are written (file name without extension, or directory name)
+    std::string getInputName(const std::string& sInput) {
+        std::filesystem::path oPath = std::filesystem::path(sInput).lexically_normal();
+        if (oPath.filename().empty())
+            oPath = oPath.parent_path();
+        return FrameSource::isImageDirectory(sInput) ? oPath.filename().string() : oPath.stem().string();
+    }
+}
+
+FrameSource::FrameSource(const std::string& sPath) :
+    m_nNextImageIdx(0) {
+    if (isImageDirectory(sPath)) {
+        for (const std::filesystem::directory_entry& oEntry : std::filesystem::directory_iterator(sPath)) {
+            if (!oEntry.is_regular_file())
+                continue;
+            std::string sExtension = oEntry.path().extension().string();
+            std::transform(sExtension.begin(), sExtension.end(), sExtension.begin(), [](unsigned char c) {return (char)std::tolower(c);});
+            if (std::find(std::begin(s_asImageExtensions), std::end(s_asImageExtensions), sExtension) != std::end(s_asImageExtensions))
+                m_vsImagePaths.push_back(oEntry.path().string());
+        }
+        if (m_vsImagePaths.empty())
+            CV_Error(cv::Error::StsError, "no image found in input directory: " + sPath);
+        std::sort(m_vsImagePaths.begin(), m_vsImagePaths.end());
+    }
+    else if (!m_oCapture.open(sPath))
+        CV_Error(cv::Error::StsError, "could not open input video: " + sPath);
+}
+
+bool FrameSource::read(cv::Mat& oFrame) {
+    if (m_vsImagePaths.empty()) {
+        // the frame buffer is reused as long as the video keeps the same size & type
+        if (!m_oCapture.read(oFrame) || oFrame.empty())
+            return false;
+    }
+    else {
+        if (m_nNextImageIdx >= m_vsImagePaths.size())
+            return false;
+        const std::string& sImagePath = m_vsImagePaths[m_nNextImageIdx++];
+        oFrame = cv::imread(sImagePath, cv::IMREAD_COLOR);
+        if (oFrame.empty())
+            CV_Error(cv::Error::StsError, "could not decode input image: " + sImagePath);
+    }
+    normalize(oFrame);
+    return true;
+}
+
+bool FrameSource::isImageDirectory(const std::string& sPath) {
+    std::error_code oError;
+    return std::filesystem::is_directory(sPath, oError);
+}
+
+void FrameSource::normalize(cv::Mat& oFrame) {
+    if (oFrame.type() != CV_8UC3) {
+        if (oFrame.depth() != CV_8U || (oFrame.channels() != 1 && oFrame.channels() != 4))
+            CV_Error(cv::Error::StsError, "unsupported input frame type (only 8-bit gray, BGR & BGRA frames are accepted)");
+        cv::cvtColor(oFrame, m_oConverted, oFrame.channels() == 1 ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR);
+        std::swap(oFrame, m_oConverted);
+    }
+    if (m_oSize.area() == 0)
+        m_oSize = oFrame.size();
+    else if (oFrame.size() != m_oSize) {
+        cv::resize(oFrame, m_oConverted, m_oSize, 0, 0, cv::INTER_AREA);
+        std::swap(oFrame, m_oConverted);
+    }
+}
+
+BatchJob::BatchJob(const std::string& sInput, const BatchSettings& oSettings, std::shared_ptr<ThreadPool> pThreadPool) :
+    m_sInput(sInput),
+    m_oSettings(oSettings),
+    m_pThreadPool(std::move(pThreadPool)),
+    m_voSlots(oSettings.nPrefetch + 1),
+    m_oFreeSlots(oSettings.nPrefetch + 1),
+    m_oDecodedSlots(oSettings.nPrefetch + 1),
+    m_bStopRequested(false) {
+    CV_Assert(oSettings.nPrefetch > 0 && m_pThreadPool);
+}
+
+BatchResult BatchJob::run() {
+    BatchResult oResult;
+    oResult.sInput = m_sInput;
+    const double dStart = getAbsoluteTime();
+    try {
+        FrameSource oSource(m_sInput);
+        if (m_oSettings.eOutput != BatchSettings::Output::None) {
+            m_sOutputStem = (std::filesystem::path(m_oSettings.sOutputDir) / getInputName(m_sInput)).string();
+            if (m_oSettings.eOutput == BatchSettings::Output::Masks)
+                std::filesystem::create_directories(m_sOutputStem);
+            else {
+                std::filesystem::create_directories(m_oSettings.sOutputDir);
+                m_oBlobFile.open(m_sOutputStem + ".csv");
+                if (!m_oBlobFile)
+                    CV_Error(cv::Error::StsError, "could not open blob output file: " + m_sOutputStem + ".csv");
+                m_oBlobFile << "frame,x,y,width,height,area,centroid_x,centroid_y\n";
+            }
+        }
+        for (size_t i = 0; i < m_voSlots.size(); ++i)
+            m_oFreeSlots.tryPush(i);
+        m_bStopRequested = false;
+        m_pPrefetchException = nullptr;
+        std::thread oPrefetchThread(&BatchJob::prefetchLoop, this, std::ref(oSource));
+        std::exception_ptr pException;
+        try {
+            processLoop(oResult);
+        }
+        catch (...) {
+            pException = std::current_exception();
+        }
+        oPrefetchThread.join();
+        if (!pException)
+            pException = m_pPrefetchException;
+        if (m_oBlobFile.is_open())
+            m_oBlobFile.close();
+        if (pException)
+            std::rethrow_exception(pException);
+    }
+    catch (const std::exception& oException) {
+        oResult.sError = oException.what();
+    }
+    oResult.dElapsed = getAbsoluteTime() - dStart;
+    return oResult;
+}
+
+void BatchJob::prefetchLoop(FrameSource& oSource) {
+    for (size_t nFrameIdx = 0;; ++nFrameIdx) {
+        const size_t nIdx = m_oFreeSlots.popWait();
+        FrameSlot& oSlot = m_voSlots[nIdx];
+        oSlot.bLast = m_bStopRequested || (m_oSettings.nMaxFrames > 0 && nFrameIdx >= m_oSettings.nMaxFrames);
+        if (!oSlot.bLast) {
+            try {
+                oSlot.bLast = !oSource.read(oSlot.oFrame);
+            }
+            catch (...) {
+                m_pPrefetchException = std::current_exception();
+                oSlot.bLast = true;
+            }
+        }
+        const bool bLast = oSlot.bLast;
+        m_oDecodedSlots.pushWait(nIdx);
+        if (bLast)
+            return;
+    }
+}
+
+void BatchJob::processLoop(BatchResult& oResult) {
+    std::unique_ptr<BackgroundSubtractorViBe_3ch> pSubtractor;
+    cv::Mat oFGMask;
+    CompactMask oMask;
+    oMask.nFormats = CompactMask::Blobs;
+    oMask.eFilter = m_oSettings.bMedian ? CompactMask::Filter::Median3x3 : CompactMask::Filter::None;
+    oMask.nMinBlobArea = m_oSettings.nMinBlobArea;
+    std::exception_ptr pException;
+    for (size_t nFrameIdx = 0;; ++nFrameIdx) {
+        const double dWaitStart = getAbsoluteTime();
+        const size_t nIdx = m_oDecodedSlots.popWait();
+        FrameSlot& oSlot = m_voSlots[nIdx];
+        if (oSlot.bLast)
+            break;
+        // after an error, the remaining frames are drained without being processed so that the prefetch thread can exit
+        if (!pException) {
+            try {
+                const double dSubtractStart = getAbsoluteTime();
+                oResult.dDecodeWait += dSubtractStart - dWaitStart;
+                if (!pSubtractor) {
+                    // the first frame initializes the model, and is segmented as well so that every frame gets an output
+                    pSubtractor = std::make_unique<BackgroundSubtractorViBe_3ch>(m_oSettings.nColorDistThreshold, m_oSettings.nSamples,
+                        m_oSettings.nRequired, m_oSettings.nLearningRate);
+                    pSubtractor->setThreadPool(m_pThreadPool);
+                    pSubtractor->setProcessingScale(m_oSettings.nProcessingScale);
+                    pSubtractor->initializeParallel(oSlot.oFrame, (int)m_pThreadPool->size());
+                    oResult.oSize = oSlot.oFrame.size();
+                }
+                if (m_oSettings.eOutput == BatchSettings::Output::Blobs)
+                    pSubtractor->applyParallel(oSlot.oFrame, oMask);
+                else
+                    pSubtractor->applyParallel(oSlot.oFrame, oFGMask);
+                const double dWriteStart = getAbsoluteTime();
+                oResult.dSubtract += dWriteStart - dSubtractStart;
+                if (m_oSettings.eOutput == BatchSettings::Output::Masks)
+                    writeMask(nFrameIdx, oFGMask);
+                else if (m_oSettings.eOutput == BatchSettings::Output::Blobs)
+                    writeBlobs(nFrameIdx, oMask);
+                oResult.dWrite += getAbsoluteTime() - dWriteStart;
+                ++oResult.nFrames;
+            }
+            catch (...) {
+                pException = std::current_exception();
+                m_bStopRequested = true;
+            }
+        }
+        m_oFreeSlots.pushWait(nIdx);
+    }
+    if (pException)
+        std::rethrow_exception(pException);
+}
+
+void BatchJob::writeMask(size_t nFrameIdx, const cv::Mat& oFGMask) {
+    char acFileName[32];
+    snprintf(acFileName, sizeof(acFileName), "%06zu.png", nFrameIdx);
+    const std::string sPath = (std::filesystem::path(m_sOutputStem) / acFileName).string();
+    // masks compress well even at the fastest level, which keeps the encoder from becoming the bottleneck
+    if (!cv::imwrite(sPath, oFGMask, {cv::IMWRITE_PNG_COMPRESSION, 1}))
+        CV_Error(cv::Error::StsError, "could not write mask: " + sPath);
+}
+
+void BatchJob::writeBlobs(size_t nFrameIdx, const CompactMask& oMask) {
+    // blobs are found at processing resolution, and written in full-resolution coordinates
+    const int nScale = oMask.nScale;
+    for (const CompactMask::Blob& oBlob : oMask.voBlobs)
+        m_oBlobFile << nFrameIdx << ',' << oBlob.oBBox.x * nScale << ',' << oBlob.oBBox.y * nScale << ',' << oBlob.oBBox.width * nScale << ','
+                    << oBlob.oBBox.height * nScale << ',' << oBlob.nArea * nScale * nScale << ',' << (oBlob.oCentroid.x + 0.5f) * nScale - 0.5f << ','
+                    << (oBlob.oCentroid.y + 0.5f) * nScale - 0.5f << '\n';
+    if (!m_oBlobFile)
+        CV_Error(cv::Error::StsError, "could not write blobs: " + m_sOutputStem + ".csv");
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/videoio.hpp>
+
+#include "api.hpp"
+#include "SpscRing.hpp"
+
+/// settings shared by all the inputs of a batch
+struct BatchSettings {
+    /// what is written for every processed frame
+    enum class Output {
+        /// nothing (timing only)
+        None,
+        /// one 0/255 PNG mask per frame, in '<output dir>/<input name>/'
+        Masks,
+        /// one CSV line per blob (frame, full-resolution bounding box, area & centroid), in '<output dir>/<input name>.csv'
+        Blobs,
+    };
+
+    Output eOutput{Output::None};
+    std::string sOutputDir;
+    size_t nColorDistThreshold{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD};
+    size_t nSamples{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_NB_BG_SAMPLES};
+    size_t nRequired{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES};
+    size_t nLearningRate{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_LEARNING_RATE};
+    int nProcessingScale{1};
+    /// applies the 3x3 median filter to the blob masks
+    bool bMedian{false};
+    int nMinBlobArea{1};
+    /// number of decoded frames queued ahead of the subtractor, per input
+    size_t nPrefetch{4};
+    /// number of frames to process per input (0 = all)
+    size_t nMaxFrames{0};
+};
+
+/// frames of one input: a video file (anything cv::VideoCapture opens) or a directory of images (read in file name order); all frames
+/// are converted to CV_8UC3 and resized to the size of the first one
+class FrameSource {
+public:
+    /// opens the given path; throws if it cannot be read
+    explicit FrameSource(const std::string& sPath);
+    /// decodes the next frame into oFrame (reusing its buffer when possible); returns false at the end of the input
+    bool read(cv::Mat& oFrame);
+
+    /// returns whether the given path names a directory of images (as opposed to a video file)
+    static bool isImageDirectory(const std::string& sPath);
+
+private:
+    /// converts a decoded frame to the type & size of the first one (in place)
+    void normalize(cv::Mat& oFrame);
+
+    cv::VideoCapture m_oCapture;
+    /// images of the directory, in file name order (empty for a video file)
+    std::vector<std::string> m_vsImagePaths;
+    size_t m_nNextImageIdx;
+    cv::Size m_oSize;
+    /// conversion buffer (swapped with the frame, so both buffers are reused)
+    cv::Mat m_oConverted;
+};
+
+/// timings of one processed input (in seconds)
+struct BatchResult {
+    std::string sInput;
+    size_t nFrames{0};
+    cv::Size oSize;
+    /// wall time from the start of the decoding to the last written output
+    double dElapsed{0};
+    /// time spent waiting for the prefetch thread, in the subtractor, and writing the outputs
+    double dDecodeWait{0};
+    double dSubtract{0};
+    double dWrite{0};
+    /// empty unless the input failed
+    std::string sError;
+
+    inline double fps() const {return dElapsed > 0 ? nFrames / dElapsed : 0;}
+};
+
+/// one input processed by its own subtractor, whose stripes run on the shared pool; frames are decoded ahead by a prefetch thread into
+/// preallocated slots exchanged through lock-free rings, so the subtractor only waits on the decoder when it is the bottleneck
+class BatchJob {
+public:
+    /// full constructor; the job does nothing until run is called
+    BatchJob(const std::string& sInput, const BatchSettings& oSettings, std::shared_ptr<ThreadPool> pThreadPool);
+    /// processes the whole input on the calling thread (errors are reported in the result instead of being thrown)
+    BatchResult run();
+
+private:
+    /// frame buffer travelling between the prefetch thread & the subtractor
+    struct FrameSlot {
+        cv::Mat oFrame;
+        /// marks the end of the input (no frame attached)
+        bool bLast{false};
+    };
+
+    void prefetchLoop(FrameSource& oSource);
+    /// segments all prefetched frames & writes their outputs
+    void processLoop(BatchResult& oResult);
+    void writeMask(size_t nFrameIdx, const cv::Mat& oFGMask);
+    void writeBlobs(size_t nFrameIdx, const CompactMask& oMask);
+
+    const std::string m_sInput;
+    const BatchSettings& m_oSettings;
+    std::shared_ptr<ThreadPool> m_pThreadPool;
+    std::vector<FrameSlot> m_voSlots;
+    /// slot indices ready to be filled by the prefetch thread
+    SpscRing<size_t> m_oFreeSlots;
+    /// slot indices holding a decoded frame
+    SpscRing<size_t> m_oDecodedSlots;
+    std::atomic<bool> m_bStopRequested;
+    /// error raised by the prefetch thread (rethrown once the frames decoded before it are processed)
+    std::exception_ptr m_pPrefetchException;
+    /// output location of this input ('<output dir>/<input name>', without extension)
+    std::string m_sOutputStem;
+    std::ofstream m_oBlobFile;
+};
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "api.hpp"
+#include "AppUtils.hpp"
+#include "profiling.hpp"
+#include "vibeKernels.hpp"
+#include "BatchJob.hpp"
+
+const char* keys =
+{
+    "{help h | | show help message}"
+    "{inputs i | | comma-separated video files and/or image directories to process}"
+    "{list l | | text file listing one input per line (added to --inputs)}"
+    "{output o | | output directory (required unless --format=none)}"
+    "{format f | none | what to write for every frame: none, masks (PNG per frame) or blobs (CSV per input)}"
+    "{jobs j | 2 | number of inputs processed at once}"
+    "{threads t | 0 | number of worker threads of the shared pool (0 = all hardware threads)}"
+    "{prefetch | 4 | number of frames decoded ahead of the subtractor, per input}"
+    "{frames | 0 | number of frames to process per input (0 = all)}"
+    "{threshold | 20 | color distance threshold (R)}"
+    "{samples | 20 | number of samples per pixel (N)}"
+    "{required | 2 | required number of matching samples (#_min)}"
+    "{rate | 10 | learning rate}"
+    "{scale | 1 | processing scale (1, 2 or 4)}"
+    "{median | | apply a 3x3 median filter to the blob masks}"
+    "{min_blob_area | 1 | smallest blob written (in processing resolution pixels)}"
+};
+
+namespace {
+    void printResult(std::ostream& os, const BatchResult& oResult) {
+        os << "  " << oResult.sInput << ": ";
+        if (!oResult.sError.empty()) {
+            os << "FAILED after " << oResult.nFrames << " frames (" << oResult.sError << ")\n";
+            return;
+        }
+        os << oResult.nFrames << " frames " << oResult.oSize.width << "x" << oResult.oSize.height << std::fixed << std::setprecision(2)
+           << ", " << oResult.dElapsed << " s, " << oResult.fps() << " fps (decode wait " << oResult.dDecodeWait * 1000 / std::max<size_t>(1, oResult.nFrames)
+           << " ms, subtract " << oResult.dSubtract * 1000 / std::max<size_t>(1, oResult.nFrames) << " ms, write "
+           << oResult.dWrite * 1000 / std::max<size_t>(1, oResult.nFrames) << " ms per frame)\n";
+    }
+}
+
+static void help(const char** argv)
+{
+    std::cout << "\nThis runs the ViBe subtractor over recorded videos and image directories without any display, several inputs at once\n"
+        "Usage: \n\t" << argv[0] << " --inputs=<path>,... [--list=<file>] [--output=<dir>] [--format=none|masks|blobs] [--jobs=<n>]"
+        " [--threads=<n>] [--prefetch=<n>] [--frames=<n>] [--threshold=<n>] [--samples=<n>] [--required=<n>] [--rate=<n>] [--scale=<n>]"
+        " [--median] [--min_blob_area=<n>]\n";
+}
+
+int main(int argc, const char** argv) {
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help"))
+    {
+        help(argv);
+        return 0;
+    }
+
+    std::vector<std::string> inputs;
+    if (parser.has("inputs"))
+        inputs = splitList(parser.get<std::string>("inputs"));
+    if (parser.has("list"))
+    {
+        std::ifstream list(parser.get<std::string>("list"));
+        if (!list)
+        {
+            std::cerr << "***Could not open input list***\n";
+            return -1;
+        }
+        std::string line;
+        while (std::getline(list, line))
+            if (!line.empty() && line[0] != '#')
+                inputs.push_back(line);
+    }
+    if (inputs.empty())
+    {
+        help(argv);
+        std::cerr << "***No input given***\n";
+        return -1;
+    }
+
+    BatchSettings settings;
+    const std::string format = parser.get<std::string>("format");
+    if (format == "masks")
+        settings.eOutput = BatchSettings::Output::Masks;
+    else if (format == "blobs")
+        settings.eOutput = BatchSettings::Output::Blobs;
+    else if (format != "none")
+    {
+        std::cerr << "***Unknown output format: " << format << "***\n";
+        return -1;
+    }
+    if (settings.eOutput != BatchSettings::Output::None)
+    {
+        if (!parser.has("output"))
+        {
+            std::cerr << "***An output directory is needed to write " << format << "***\n";
+            return -1;
+        }
+        settings.sOutputDir = parser.get<std::string>("output");
+    }
+    settings.nColorDistThreshold = (size_t)std::max(0, parser.get<int>("threshold"));
+    settings.nSamples = (size_t)std::max(1, parser.get<int>("samples"));
+    settings.nRequired = (size_t)std::max(1, parser.get<int>("required"));
+    settings.nLearningRate = (size_t)std::max(1, parser.get<int>("rate"));
+    settings.nProcessingScale = parser.get<int>("scale");
+    settings.bMedian = parser.has("median");
+    settings.nMinBlobArea = std::max(1, parser.get<int>("min_blob_area"));
+    settings.nPrefetch = (size_t)std::max(1, parser.get<int>("prefetch"));
+    settings.nMaxFrames = (size_t)std::max(0, parser.get<int>("frames"));
+    if (settings.nProcessingScale != 1 && settings.nProcessingScale != 2 && settings.nProcessingScale != 4)
+    {
+        std::cerr << "***The processing scale must be 1, 2 or 4***\n";
+        return -1;
+    }
+    const size_t jobs = std::min(inputs.size(), (size_t)std::max(1, parser.get<int>("jobs")));
+
+    // all inputs share one pool: each job drives its own subtractor from its own thread, and the stripes of all the frames in flight
+    // interleave on the pool's queues
+    auto pool = std::make_shared<ThreadPool>((size_t)std::max(0, parser.get<int>("threads")));
+    std::cout << "Classification kernels: " << lv::getClassificationKernelName() << "\n";
+    std::cout << "Processing " << inputs.size() << " inputs, " << jobs << " at once, on " << pool->size() << " worker threads\n";
+
+    std::vector<BatchResult> results(inputs.size());
+    std::atomic<size_t> nextInput(0);
+    const double start = getAbsoluteTime();
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < jobs; ++i)
+        workers.emplace_back([&]() {
+            for (size_t idx = nextInput++; idx < inputs.size(); idx = nextInput++)
+                results[idx] = BatchJob(inputs[idx], settings, pool).run();
+        });
+    for (std::thread& worker : workers)
+        worker.join();
+    const double elapsed = getAbsoluteTime() - start;
+
+    size_t totalFrames = 0, failures = 0;
+    std::cout << "Per input:\n";
+    for (const BatchResult& result : results)
+    {
+        printResult(std::cout, result);
+        totalFrames += result.nFrames;
+        failures += result.sError.empty() ? 0 : 1;
+    }
+    std::cout << "Total: " << totalFrames << " frames in " << std::fixed << std::setprecision(2) << elapsed << " s, "
+              << (elapsed > 0 ? totalFrames / elapsed : 0) << " fps aggregate";
+    if (failures)
+        std::cout << ", " << failures << " failed input(s)";
+    std::cout << "\n";
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#include "BenchWorkload.hpp"
+
+#include <algorithm>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "SyntheticScene.hpp"
+
+BenchWorkload BenchWorkload::synthetic(const cv::Size& oSize, size_t nFrames, uint32_t nSeed) {
+    BenchWorkload oWorkload;
+    oWorkload.m_oSize = oSize;
+    oWorkload.m_sSource = "synthetic";
+    oWorkload.m_voFrames = generateSyntheticScene(oSize, std::min(nFrames, s_nMaxFrames), nSeed);
+    return oWorkload;
+}
+
+BenchWorkload BenchWorkload::recorded(const std::string& sPath, const cv::Size& oSize, size_t nFrames) {
+    CV_Assert(nFrames > 0);
+    cv::VideoCapture oCapture(sPath);
+    if (!oCapture.isOpened())
+        CV_Error(cv::Error::StsError, "could not open benchmark input: " + sPath);
+    BenchWorkload oWorkload;
+    oWorkload.m_sSource = sPath;
+    cv::Mat oFrame;
+    while (oWorkload.m_voFrames.size() < std::min(nFrames, s_nMaxFrames) && oCapture.read(oFrame) && !oFrame.empty()) {
+        if (oFrame.type() != CV_8UC3)
+            CV_Error(cv::Error::StsError, "benchmark input frames must be CV_8UC3: " + sPath);
+        if (oWorkload.m_voFrames.empty())
+            oWorkload.m_oSize = oSize.area() > 0 ? oSize : oFrame.size();
+        cv::Mat oResized;
+        if (oFrame.size() != oWorkload.m_oSize)
+            cv::resize(oFrame, oResized, oWorkload.m_oSize, 0, 0, cv::INTER_AREA);
+        else
+            oResized = oFrame.clone();
+        oWorkload.m_voFrames.push_back(oResized);
+    }
+    if (oWorkload.m_voFrames.empty())
+        CV_Error(cv::Error::StsError, "could not read any frame from benchmark input: " + sPath);
+    return oWorkload;
+}
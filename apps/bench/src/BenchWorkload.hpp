@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/// fixed set of CV_8UC3 frames replayed by the benchmarks; frames are generated or decoded (and resized) before any timing starts,
+/// so neither capture nor decoding is ever measured
+class BenchWorkload {
+public:
+    /// maximum number of distinct frames kept in memory; longer runs cycle through them
+    static const size_t s_nMaxFrames{32};
+
+    /// generates a synthetic scene: textured static background, sensor noise, slow illumination drift and a few moving objects
+    /// (deterministic for a given seed)
+    static BenchWorkload synthetic(const cv::Size& oSize, size_t nFrames, uint32_t nSeed = 42);
+    /// decodes the first frames of a recorded video, resized to the given size (native size if empty)
+    static BenchWorkload recorded(const std::string& sPath, const cv::Size& oSize, size_t nFrames);
+
+    /// returns the size of the workload frames
+    inline const cv::Size& size() const {return m_oSize;}
+    /// returns the number of distinct frames
+    inline size_t count() const {return m_voFrames.size();}
+    /// returns the frame to use at the given step (cycling over the stored frames)
+    inline const cv::Mat& frame(size_t nStep) const {return m_voFrames[nStep % m_voFrames.size()];}
+    /// returns a short description of the workload source
+    inline const std::string& source() const {return m_sSource;}
+
+private:
+    cv::Size m_oSize;
+    std::vector<cv::Mat> m_voFrames;
+    std::string m_sSource;
+};
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "api.hpp"
+#include "AppUtils.hpp"
+#include "vibeKernels.hpp"
+#include "BenchWorkload.hpp"
+
+const char* keys =
+{
+    "{help h | | show help message}"
+    "{input i | | video file replayed instead of the synthetic workload}"
+    "{output o | | JSON output file (default: standard output)}"
+    "{resolutions | | comma-separated frame sizes (default: 320x240,640x480,1280x720, or the native size of --input)}"
+    "{samples | 20 | comma-separated sample counts (N)}"
+    "{required | 2 | comma-separated required matching sample counts (#_min)}"
+    "{rates | 10 | comma-separated learning rates}"
+    "{threads | 1,2,4 | comma-separated thread counts for the parallel paths (the first one is the scaling baseline)}"
+    "{frames | 60 | number of timed frames per configuration}"
+    "{warmup | 5 | number of untimed frames before each timed run}"
+};
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    /// per-call durations of one benchmarked function (in seconds)
+    struct Timings {
+        std::vector<double> vdSeconds;
+
+        template<typename TFunc>
+        inline void measure(TFunc&& lFunc) {
+            const Clock::time_point tStart = Clock::now();
+            lFunc();
+            vdSeconds.push_back(std::chrono::duration<double>(Clock::now() - tStart).count());
+        }
+        inline double mean() const {
+            double dTotal = 0;
+            for (double d : vdSeconds)
+                dTotal += d;
+            return vdSeconds.empty() ? 0 : dTotal / vdSeconds.size();
+        }
+        inline double median() const {
+            if (vdSeconds.empty())
+                return 0;
+            std::vector<double> vdSorted = vdSeconds;
+            std::nth_element(vdSorted.begin(), vdSorted.begin() + vdSorted.size() / 2, vdSorted.end());
+            return vdSorted[vdSorted.size() / 2];
+        }
+        inline double max() const {
+            return vdSeconds.empty() ? 0 : *std::max_element(vdSeconds.begin(), vdSeconds.end());
+        }
+    };
+
+    struct Config {
+        size_t nSamples, nRequired, nLearningRate;
+    };
+
+    std::vector<size_t> parseCounts(const std::string& sList) {
+        std::vector<size_t> vnCounts;
+        for (const std::string& sItem : splitList(sList))
+            vnCounts.push_back((size_t)std::stoul(sItem));
+        CV_Assert(!vnCounts.empty());
+        return vnCounts;
+    }
+
+    std::vector<cv::Size> parseSizes(const std::string& sList) {
+        std::vector<cv::Size> voSizes;
+        for (const std::string& sItem : splitList(sList)) {
+            const size_t nSep = sItem.find('x');
+            CV_Assert(nSep != std::string::npos);
+            voSizes.emplace_back(std::stoi(sItem.substr(0, nSep)), std::stoi(sItem.substr(nSep + 1)));
+        }
+        return voSizes;
+    }
+
+    /// writes the timings of one call type as a JSON object (per-pixel cost, throughput & latency distribution)
+    void writeTimings(std::ostream& os, const Timings& oTimings, const cv::Size& oSize) {
+        const double dMean = oTimings.mean();
+        os << "{\"ns_per_pixel\": " << dMean * 1e9 / oSize.area() << ", \"fps\": " << (dMean > 0 ? 1.0 / dMean : 0)
+           << ", \"mean_ms\": " << dMean * 1e3 << ", \"median_ms\": " << oTimings.median() * 1e3 << ", \"max_ms\": " << oTimings.max() * 1e3 << "}";
+    }
+
+    /// benchmarks one parameter configuration on one workload and appends its JSON record to os
+    void runConfig(std::ostream& os, const BenchWorkload& oWorkload, const Config& oConfig, const std::vector<size_t>& vnThreads,
+            size_t nFrames, size_t nWarmup) {
+        const cv::Size& oSize = oWorkload.size();
+        cv::Mat oFGMask, oBGImage;
+        Timings oInitTimings, oApplyTimings, oBGImageTimings;
+        {
+            BackgroundSubtractorViBe_3ch oSubtractor(BackgroundSubtractorViBe::BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD, oConfig.nSamples, oConfig.nRequired, oConfig.nLearningRate);
+            oInitTimings.measure([&]() {oSubtractor.initialize(oWorkload.frame(0));});
+            for (size_t t = 0; t < nWarmup; ++t)
+                oSubtractor.apply(oWorkload.frame(t + 1), oFGMask);
+            for (size_t t = 0; t < nFrames; ++t)
+                oApplyTimings.measure([&]() {oSubtractor.apply(oWorkload.frame(nWarmup + t + 1), oFGMask);});
+            for (size_t t = 0; t < std::max<size_t>(1, nFrames / 4); ++t)
+                oBGImageTimings.measure([&]() {oSubtractor.getBackgroundImage(oBGImage);});
+        }
+        os << "    {\"width\": " << oSize.width << ", \"height\": " << oSize.height << ", \"samples\": " << oConfig.nSamples
+           << ", \"required\": " << oConfig.nRequired << ", \"learning_rate\": " << oConfig.nLearningRate << ",\n"
+           << "     \"initialize\": ";
+        writeTimings(os, oInitTimings, oSize);
+        os << ",\n     \"apply\": ";
+        writeTimings(os, oApplyTimings, oSize);
+        os << ",\n     \"get_background_image\": ";
+        writeTimings(os, oBGImageTimings, oSize);
+        os << ",\n     \"parallel\": [";
+        double dBaselineMean = 0;
+        for (size_t i = 0; i < vnThreads.size(); ++i) {
+            Timings oParallelInitTimings, oParallelApplyTimings;
+            BackgroundSubtractorViBe_3ch oSubtractor(BackgroundSubtractorViBe::BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD, oConfig.nSamples, oConfig.nRequired, oConfig.nLearningRate);
+            oSubtractor.setNumThreads(vnThreads[i]);
+            oParallelInitTimings.measure([&]() {oSubtractor.initializeParallel(oWorkload.frame(0), (int)vnThreads[i]);});
+            for (size_t t = 0; t < nWarmup; ++t)
+                oSubtractor.applyParallel(oWorkload.frame(t + 1), oFGMask);
+            for (size_t t = 0; t < nFrames; ++t)
+                oParallelApplyTimings.measure([&]() {oSubtractor.applyParallel(oWorkload.frame(nWarmup + t + 1), oFGMask);});
+            const double dMean = oParallelApplyTimings.mean();
+            if (i == 0)
+                dBaselineMean = dMean;
+            // scaling is relative to the first thread count of the list
+            const double dSpeedup = dMean > 0 ? dBaselineMean / dMean : 0;
+            os << (i ? ",\n" : "\n") << "       {\"threads\": " << vnThreads[i] << ", \"initialize\": ";
+            writeTimings(os, oParallelInitTimings, oSize);
+            os << ", \"apply\": ";
+            writeTimings(os, oParallelApplyTimings, oSize);
+            os << ", \"speedup\": " << dSpeedup << ", \"efficiency\": " << dSpeedup * vnThreads[0] / vnThreads[i] << "}";
+        }
+        os << "]}";
+    }
+}
+
+static void help(const char** argv)
+{
+    std::cout << "\nThis benchmarks the ViBe subtractor on replayed frames and prints the results as JSON\n"
+        "Usage: \n\t" << argv[0] << " [--input=<video file>] [--output=<json file>] [--resolutions=WxH,...] [--samples=n,...]"
+        " [--required=n,...] [--rates=n,...] [--threads=n,...] [--frames=<n>] [--warmup=<n>]\n";
+}
+
+int main(int argc, const char** argv) {
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help"))
+    {
+        help(argv);
+        return 0;
+    }
+
+    const std::string input = parser.has("input") ? parser.get<std::string>("input") : std::string();
+    // a recorded input keeps its native size unless resolutions are requested explicitly
+    std::vector<cv::Size> resolutions;
+    if (parser.has("resolutions"))
+        resolutions = parseSizes(parser.get<std::string>("resolutions"));
+    else if (input.empty())
+        resolutions = parseSizes("320x240,640x480,1280x720");
+    else
+        resolutions = {cv::Size()};
+    const std::vector<size_t> samples = parseCounts(parser.get<std::string>("samples"));
+    const std::vector<size_t> required = parseCounts(parser.get<std::string>("required"));
+    const std::vector<size_t> rates = parseCounts(parser.get<std::string>("rates"));
+    const std::vector<size_t> threads = parseCounts(parser.get<std::string>("threads"));
+    const size_t frames = (size_t)std::max(1, parser.get<int>("frames"));
+    const size_t warmup = (size_t)std::max(0, parser.get<int>("warmup"));
+
+    std::ofstream file;
+    if (parser.has("output"))
+    {
+        file.open(parser.get<std::string>("output"));
+        if (!file)
+        {
+            std::cerr << "***Could not open output file***\n";
+            return -1;
+        }
+    }
+    std::ostream& os = file.is_open() ? file : std::cout;
+
+    os << "{\n  \"meta\": {\"kernel\": \"" << lv::getClassificationKernelName() << "\", \"hardware_threads\": " << std::thread::hardware_concurrency()
+       << ", \"frames\": " << frames << ", \"warmup\": " << warmup << ", \"workload\": \"" << (input.empty() ? "synthetic" : "recorded") << "\"},\n"
+       << "  \"results\": [\n";
+    bool first = true;
+    try
+    {
+        for (const cv::Size& resolution : resolutions)
+        {
+            const BenchWorkload workload = input.empty() ? BenchWorkload::synthetic(resolution, frames + warmup + 1)
+                                                         : BenchWorkload::recorded(input, resolution, frames + warmup + 1);
+            for (size_t nSamples : samples)
+                for (size_t nRequired : required)
+                    for (size_t nRate : rates)
+                    {
+                        if (nRequired > nSamples)
+                            continue;
+                        if (!first)
+                            os << ",\n";
+                        first = false;
+                        runConfig(os, workload, Config{nSamples, nRequired, nRate}, threads, frames, warmup);
+                        os.flush();
+                    }
+        }
+    }
+    catch (const cv::Exception& e)
+    {
+        std::cerr << "***Benchmark failed: " << e.what() << "***\n";
+        return -1;
+    }
+    os << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// splits a comma-separated command line list (empty items are skipped)
+std::vector<std::string> splitList(const std::string& sList);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/// generates nFrames CV_8UC3 frames of a synthetic scene: textured static background, sensor noise, slow illumination drift (spread over
+/// the generated frames) and a few moving objects covering roughly a tenth of the frame, so that both the background and foreground paths
+/// are exercised; with bEmptyFirstFrame, the objects only appear from the second frame on (e.g. so that the model is initialized on the
+/// background alone); deterministic for a given seed
+std::vector<cv::Mat> generateSyntheticScene(const cv::Size& oSize, size_t nFrames, uint32_t nSeed, bool bEmptyFirstFrame = false);
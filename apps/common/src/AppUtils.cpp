@@ -0,0 +1,13 @@
+#include "AppUtils.hpp"
+
+#include <sstream>
+
+std::vector<std::string> splitList(const std::string& sList) {
+    std::vector<std::string> vsItems;
+    std::stringstream oStream(sList);
+    std::string sItem;
+    while (std::getline(oStream, sItem, ','))
+        if (!sItem.empty())
+            vsItems.push_back(sItem);
+    return vsItems;
+}
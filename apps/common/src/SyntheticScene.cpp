@@ -0,0 +1,57 @@
+#include "SyntheticScene.hpp"
+
+#include <algorithm>
+#include <random>
+
+std::vector<cv::Mat> generateSyntheticScene(const cv::Size& oSize, size_t nFrames, uint32_t nSeed, bool bEmptyFirstFrame) {
+    CV_Assert(oSize.width > 0 && oSize.height > 0 && nFrames > 0);
+    std::mt19937 oRNG(nSeed);
+    cv::Mat oBackground(oSize, CV_8UC3);
+    for (int y = 0; y < oSize.height; ++y) {
+        uchar* pRow = oBackground.ptr<uchar>(y);
+        for (int x = 0; x < oSize.width; ++x) {
+            pRow[x * 3 + 0] = (uchar)((x * 255) / oSize.width);
+            pRow[x * 3 + 1] = (uchar)((y * 255) / oSize.height);
+            pRow[x * 3 + 2] = (uchar)(((x / 8 + y / 8) % 2) ? 160 : 96);
+        }
+    }
+    struct MovingObject {
+        cv::Rect oRect;
+        cv::Point oVelocity;
+        uchar anColor[3];
+    };
+    std::vector<MovingObject> voObjects(4);
+    for (MovingObject& oObject : voObjects) {
+        const int nWidth = std::max(1, oSize.width / 6), nHeight = std::max(1, oSize.height / 6);
+        oObject.oRect = cv::Rect((int)(oRNG() % oSize.width), (int)(oRNG() % oSize.height), nWidth, nHeight);
+        oObject.oVelocity = cv::Point((int)(oRNG() % 9) - 4, (int)(oRNG() % 9) - 4);
+        for (uchar& nColor : oObject.anColor)
+            nColor = (uchar)(oRNG() % 256);
+    }
+    std::vector<cv::Mat> voFrames;
+    for (size_t t = 0; t < nFrames; ++t) {
+        cv::Mat oFrame(oSize, CV_8UC3);
+        const int nDrift = (int)(8 * t / nFrames);
+        for (int y = 0; y < oSize.height; ++y) {
+            const uchar* pBGRow = oBackground.ptr<uchar>(y);
+            uchar* pRow = oFrame.ptr<uchar>(y);
+            for (int x = 0; x < oSize.width * 3; ++x)
+                pRow[x] = (uchar)std::clamp((int)pBGRow[x] + nDrift + (int)(oRNG() % 9) - 4, 0, 255);
+        }
+        if (t > 0 || !bEmptyFirstFrame) {
+            for (MovingObject& oObject : voObjects) {
+                const cv::Rect oVisible = oObject.oRect & cv::Rect(0, 0, oSize.width, oSize.height);
+                for (int y = oVisible.y; y < oVisible.y + oVisible.height; ++y) {
+                    uchar* pRow = oFrame.ptr<uchar>(y);
+                    for (int x = oVisible.x; x < oVisible.x + oVisible.width; ++x)
+                        for (int c = 0; c < 3; ++c)
+                            pRow[x * 3 + c] = oObject.anColor[c];
+                }
+                oObject.oRect.x = (oObject.oRect.x + oObject.oVelocity.x + oSize.width) % oSize.width;
+                oObject.oRect.y = (oObject.oRect.y + oObject.oVelocity.y + oSize.height) % oSize.height;
+            }
+        }
+        voFrames.push_back(oFrame);
+    }
+    return voFrames;
+}
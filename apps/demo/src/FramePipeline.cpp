@@ -0,0 +1,107 @@
+#include "FramePipeline.hpp"
+
+#include <iomanip>
+#include <thread>
+
+#include "profiling.hpp"
+
+namespace {
+    void printStage(std::ostream& os, const char* sName, const StageStats& oStats) {
+        os << "  " << std::left << std::setw(16) << sName << std::right << std::fixed << std::setprecision(2)
+           << "mean " << std::setw(8) << oStats.mean() * 1000 << " ms   max " << std::setw(8) << oStats.dMax * 1000 << " ms\n";
+    }
+}
+
+FramePipeline::FramePipeline(cv::VideoCapture& oCapture, BackgroundSubtractorViBe& oSubtractor, size_t nSlots) :
+    m_oCapture(oCapture),
+    m_oSubtractor(oSubtractor),
+    m_voSlots(nSlots),
+    m_oFreeSlots(nSlots),
+    m_oCapturedSlots(nSlots),
+    m_oSegmentedSlots(nSlots),
+    m_bStopRequested(false),
+    m_dRunStart(0),
+    m_dLastConsumeEnd(0) {
+    CV_Assert(nSlots >= 2);
+}
+
+void FramePipeline::run(const cv::Size& oFrameSize, int nFrameType, const ConsumeFunc& lConsume, size_t nMaxFrames) {
+    for (size_t i = 0; i < m_voSlots.size(); ++i) {
+        m_voSlots[i].oFrame.create(oFrameSize, nFrameType);
+        m_voSlots[i].oFGMask.create(oFrameSize, CV_8UC1);
+        m_oFreeSlots.tryPush(i);
+    }
+    m_bStopRequested = false;
+    m_dRunStart = m_dLastConsumeEnd = getAbsoluteTime();
+    std::thread oCaptureThread(&FramePipeline::captureLoop, this, nMaxFrames);
+    std::thread oSubtractThread(&FramePipeline::subtractLoop, this);
+    while (true) {
+        const size_t nIdx = m_oSegmentedSlots.popWait();
+        FrameSlot& oSlot = m_voSlots[nIdx];
+        if (oSlot.bLast)
+            break;
+        // once a stop was requested, the remaining frames are drained without being consumed so that the other stages can exit
+        if (!m_bStopRequested) {
+            const double dConsumeStart = getAbsoluteTime();
+            if (!lConsume(oSlot))
+                m_bStopRequested = true;
+            m_dLastConsumeEnd = getAbsoluteTime();
+            m_oCaptureStats.add(oSlot.dCaptureEnd - oSlot.dCaptureStart);
+            m_oSubtractQueueStats.add(oSlot.dSubtractStart - oSlot.dCaptureEnd);
+            m_oSubtractStats.add(oSlot.dSubtractEnd - oSlot.dSubtractStart);
+            m_oConsumeQueueStats.add(dConsumeStart - oSlot.dSubtractEnd);
+            m_oConsumeStats.add(m_dLastConsumeEnd - dConsumeStart);
+            m_oEndToEndStats.add(m_dLastConsumeEnd - oSlot.dCaptureStart);
+        }
+        m_oFreeSlots.pushWait(nIdx);
+    }
+    oCaptureThread.join();
+    oSubtractThread.join();
+}
+
+void FramePipeline::printStats(std::ostream& os) const {
+    const double dElapsed = m_dLastConsumeEnd - m_dRunStart;
+    os << "Pipeline: " << m_oEndToEndStats.nCount << " frames, "
+       << std::fixed << std::setprecision(2) << (dElapsed > 0 ? m_oEndToEndStats.nCount / dElapsed : 0) << " fps sustained\n";
+    printStage(os, "capture", m_oCaptureStats);
+    printStage(os, "wait (subtract)", m_oSubtractQueueStats);
+    printStage(os, "subtract", m_oSubtractStats);
+    printStage(os, "wait (consume)", m_oConsumeQueueStats);
+    printStage(os, "consume", m_oConsumeStats);
+    printStage(os, "end-to-end", m_oEndToEndStats);
+}
+
+void FramePipeline::captureLoop(size_t nMaxFrames) {
+    for (size_t nFrameIdx = 0;; ++nFrameIdx) {
+        const size_t nIdx = m_oFreeSlots.popWait();
+        FrameSlot& oSlot = m_voSlots[nIdx];
+        oSlot.bLast = m_bStopRequested || (nMaxFrames > 0 && nFrameIdx >= nMaxFrames);
+        if (!oSlot.bLast) {
+            oSlot.dCaptureStart = getAbsoluteTime();
+            // the slot buffer is reused as long as the capture keeps the same size & type
+            oSlot.bLast = !m_oCapture.read(oSlot.oFrame) || oSlot.oFrame.empty();
+            oSlot.dCaptureEnd = getAbsoluteTime();
+            oSlot.nFrameIdx = nFrameIdx;
+        }
+        const bool bLast = oSlot.bLast;
+        m_oCapturedSlots.pushWait(nIdx);
+        if (bLast)
+            return;
+    }
+}
+
+void FramePipeline::subtractLoop() {
+    while (true) {
+        const size_t nIdx = m_oCapturedSlots.popWait();
+        FrameSlot& oSlot = m_voSlots[nIdx];
+        const bool bLast = oSlot.bLast; // the slot belongs to the consumer as soon as it is pushed
+        if (!bLast) {
+            oSlot.dSubtractStart = getAbsoluteTime();
+            m_oSubtractor.applyParallel(oSlot.oFrame, oSlot.oFGMask);
+            oSlot.dSubtractEnd = getAbsoluteTime();
+        }
+        m_oSegmentedSlots.pushWait(nIdx);
+        if (bLast)
+            return;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/videoio.hpp>
+
+#include "api.hpp"
+#include "SpscRing.hpp"
+
+/// frame buffers & timestamps travelling through the pipeline; all slots are allocated once and recycled
+struct FrameSlot {
+    cv::Mat oFrame;
+    cv::Mat oFGMask;
+    size_t nFrameIdx{0};
+    double dCaptureStart{0};
+    double dCaptureEnd{0};
+    double dSubtractStart{0};
+    double dSubtractEnd{0};
+    /// marks the end of the stream (no frame attached)
+    bool bLast{false};
+};
+
+/// latency accumulator for one pipeline stage (in seconds)
+struct StageStats {
+    size_t nCount{0};
+    double dTotal{0};
+    double dMax{0};
+
+    inline void add(double dDuration) {
+        ++nCount;
+        dTotal += dDuration;
+        dMax = std::max(dMax, dDuration);
+    }
+    inline double mean() const {return nCount ? dTotal / nCount : 0;}
+};
+
+/// capture -> subtract -> consume runtime; capture and subtraction each run on their own thread, the consumer runs on the
+/// calling thread (so that it may own the GUI), and the stages exchange preallocated frame slots through lock-free rings; a stage
+/// waiting on its ring sleeps (e.g. the subtraction & consumer threads while the capture blocks on the camera), so that it does not
+/// take CPU time from the subtractor's workers and skew the measured throughput
+class FramePipeline {
+public:
+    /// called on the thread running the pipeline for every segmented frame; returns false to stop the pipeline
+    using ConsumeFunc = std::function<bool(const FrameSlot&)>;
+
+    /// full constructor; nSlots bounds the number of frames in flight
+    FramePipeline(cv::VideoCapture& oCapture, BackgroundSubtractorViBe& oSubtractor, size_t nSlots = 4);
+    /// runs until the capture ends, nMaxFrames frames were consumed (0 = no limit) or lConsume returns false
+    void run(const cv::Size& oFrameSize, int nFrameType, const ConsumeFunc& lConsume, size_t nMaxFrames = 0);
+    /// prints the per-stage latencies & the end-to-end throughput measured so far
+    void printStats(std::ostream& os) const;
+
+private:
+    void captureLoop(size_t nMaxFrames);
+    void subtractLoop();
+
+    cv::VideoCapture& m_oCapture;
+    BackgroundSubtractorViBe& m_oSubtractor;
+    std::vector<FrameSlot> m_voSlots;
+    /// slot indices ready to be filled by the capture stage
+    SpscRing<size_t> m_oFreeSlots;
+    /// slot indices holding a captured frame
+    SpscRing<size_t> m_oCapturedSlots;
+    /// slot indices holding a segmented frame
+    SpscRing<size_t> m_oSegmentedSlots;
+    std::atomic<bool> m_bStopRequested;
+    /// stage statistics (only touched by the consumer thread, from the slot timestamps)
+    StageStats m_oCaptureStats, m_oSubtractQueueStats, m_oSubtractStats, m_oConsumeQueueStats, m_oConsumeStats, m_oEndToEndStats;
+    double m_dRunStart;
+    double m_dLastConsumeEnd;
+};
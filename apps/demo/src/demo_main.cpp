@@ -5,10 +5,17 @@
 
 #include "api.hpp"
 #include "profiling.hpp"
+#include "FramePipeline.hpp"
 
 const char* keys =
 {
     "{help h | | show help message}{@camera_number| 0 | camera number}"
+    "{input i | | video file to read instead of the camera}"
+    "{headless | | do not open a window (frames are only counted)}"
+    "{frames | 0 | number of frames to process (0 = until the input ends)}"
+    "{threads | 4 | number of worker threads used by the subtractor}"
+    "{slots | 4 | number of frames in flight between the pipeline stages}"
+    "{reorder | | move each pixel's matching samples to the front of its list (adaptive sample ordering)}"
 };
 
 static void help(const char** argv)
@@ -16,17 +23,17 @@ static void help(const char** argv)
     std::cout << "\nThis is a demo to test Background Subtracting\n"
         "This reads from video camera (0 by default, or the camera number the user enters)\n";
         "Usage: \n\t";
-    std::cout << argv[0] << " [camera number]\n";
+    std::cout << argv[0] << " [camera number] [--input=<video file>] [--headless] [--frames=<n>] [--threads=<n>] [--slots=<n>] [--reorder]\n";
 }
 
 int main(int argc, const char** argv) {
-    int learningRate = 10;
     cv::VideoCapture cap;
     BackgroundSubtractorViBe_3ch vibe;
     cv::CommandLineParser parser(argc, argv, keys);
 
     double freq = initFrequency();
     std::cout << "Current frequency: " << freq << "\n";
+    std::cout << "Classification kernels: " << lv::getClassificationKernelName() << "\n";
 
     if (parser.has("help"))
     {
@@ -34,8 +41,14 @@ int main(int argc, const char** argv) {
         return 0;
     }
 
-    int camNum = parser.get<int>(0);
-    cap.open(camNum);
+    const bool headless = parser.has("headless");
+    const size_t maxFrames = (size_t)std::max(0, parser.get<int>("frames"));
+    const int numThreads = std::max(1, parser.get<int>("threads"));
+    const size_t numSlots = (size_t)std::max(2, parser.get<int>("slots"));
+    if (parser.has("input"))
+        cap.open(parser.get<std::string>("input"));
+    else
+        cap.open(parser.get<int>(0));
     if (!cap.isOpened())
     {
         help(argv);
@@ -50,50 +63,42 @@ int main(int argc, const char** argv) {
 
     std::cout << "Capture size: " << (int)frameWidth << " x " << (int)frameHeight << std::endl;
 
-    cv::namedWindow("ViBe Demo", 0);
-
-    cv::Mat frame, vibeMask;
-    long numFrames = 0;
-    double totalTime = 0;
+    if (!headless)
+        cv::namedWindow("ViBe Demo", 0);
 
+    cv::Mat frame;
     cap >> frame;
     if (frame.type() != CV_8UC3) {
         std::cout << "Image type not supported" << std::endl;
         return -1;
     }
-    vibeMask.create(frame.size(), CV_8UC1);
-    cv::imshow("ViBe Demo", frame);
+    if (!headless)
+        cv::imshow("ViBe Demo", frame);
 
-    //vibe.initialize(frame);
-    vibe.initializeParallel(frame, 4);
+    vibe.setSampleReordering(parser.has("reorder"));
+    vibe.initializeParallel(frame, numThreads);
 
+    // capture, subtraction and display each run on their own thread, so the subtractor no longer idles while the camera
+    // decodes or the GUI blocks; the consumer below runs on the main thread since it owns the window
+    FramePipeline pipeline(cap, vibe, numSlots);
     std::cout << "Enter loop" << std::endl;
-    while (true) {
-        cap >> frame;
-        if (frame.empty()) {
-            std::cout << "No image\n";
-            break;
-        }
-
-        double startTime = getAbsoluteTime();
-        // vibe.apply(frame, vibeMask);
-        vibe.applyParallel(frame, vibeMask);
-        double endTime = getAbsoluteTime();
-        totalTime += endTime - startTime;
-        ++numFrames;
-
-        if (numFrames % 100 == 0) {
-            std::cout << "Framerate: " << (numFrames / totalTime) << "fps" << std::endl;
-        }
-        cv::imshow("ViBe Demo", vibeMask);
-
-        char c = (char)cv::waitKey(10);
+    pipeline.run(frame.size(), frame.type(), [&](const FrameSlot& slot) {
+        if ((slot.nFrameIdx + 1) % 100 == 0)
+            pipeline.printStats(std::cout);
+        if (headless)
+            return true;
+        cv::imshow("ViBe Demo", slot.oFGMask);
+        char c = (char)cv::waitKey(1);
         if (c == 27) {
             std::cout << "Escape key pressed" << std::endl;
-            break;
+            return false;
         }
-    }
+        return true;
+    }, maxFrames);
     std::cout << "Exit loop\n" << std::endl;
+    pipeline.printStats(std::cout);
+    if (ViBeMetrics::s_bEnabled)
+        vibe.getMetrics().print(std::cout);
 
     return 0;
 }
@@ -0,0 +1,157 @@
+#include "RegressionRunner.hpp"
+
+#include <memory>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "SyntheticScene.hpp"
+
+namespace {
+    /// creates the subtractor storing its samples with the given encoding
+    std::unique_ptr<BackgroundSubtractorViBe> createSubtractor(const RegressionSettings& oSettings, const RegressionVariant& oVariant) {
+        const size_t nR = oSettings.nColorDistThreshold, nN = oSettings.nSamples, nMin = oSettings.nRequired, nRate = oSettings.nLearningRate;
+        switch (oVariant.eEncoding) {
+            case lv::SampleEncoding::BGR565:
+                return std::make_unique<BackgroundSubtractorViBe_3chBGR565>(nR, nN, nMin, nRate, oVariant.eLayout, oVariant.eUpdateMode);
+            case lv::SampleEncoding::YUV844:
+                return std::make_unique<BackgroundSubtractorViBe_3chYUV844>(nR, nN, nMin, nRate, oVariant.eLayout, oVariant.eUpdateMode);
+            case lv::SampleEncoding::BGR332:
+                return std::make_unique<BackgroundSubtractorViBe_3chBGR332>(nR, nN, nMin, nRate, oVariant.eLayout, oVariant.eUpdateMode);
+            default:
+                return std::make_unique<BackgroundSubtractorViBe_3ch>(nR, nN, nMin, nRate, oVariant.eLayout, oVariant.eUpdateMode);
+        }
+    }
+
+    /// restores the kernels in use when it goes out of scope
+    struct KernelIsaGuard {
+        const lv::KernelIsa eIsa{lv::getKernelIsa()};
+        ~KernelIsaGuard() {lv::setKernelIsa(eIsa);}
+    };
+}
+
+RegressionSequence RegressionSequence::synthetic(const cv::Size& oSize, size_t nFrames, uint32_t nSeed) {
+    CV_Assert(nFrames > 1);
+    RegressionSequence oSequence;
+    oSequence.m_oSize = oSize;
+    oSequence.m_sSource = "synthetic";
+    // the first frame initializes the model, and is kept free of objects
+    oSequence.m_voFrames = generateSyntheticScene(oSize, nFrames, nSeed, true);
+    return oSequence;
+}
+
+RegressionSequence RegressionSequence::recorded(const std::string& sPath, size_t nFrames) {
+    CV_Assert(nFrames > 1);
+    cv::VideoCapture oCapture(sPath);
+    if (!oCapture.isOpened())
+        CV_Error(cv::Error::StsError, "could not open regression input: " + sPath);
+    RegressionSequence oSequence;
+    oSequence.m_sSource = sPath;
+    cv::Mat oFrame;
+    while (oSequence.m_voFrames.size() < nFrames && oCapture.read(oFrame) && !oFrame.empty()) {
+        if (oFrame.type() != CV_8UC3)
+            CV_Error(cv::Error::StsError, "regression input frames must be CV_8UC3: " + sPath);
+        if (oSequence.m_voFrames.empty())
+            oSequence.m_oSize = oFrame.size();
+        else if (oFrame.size() != oSequence.m_oSize)
+            CV_Error(cv::Error::StsError, "regression input frames must all have the same size: " + sPath);
+        oSequence.m_voFrames.push_back(oFrame.clone());
+    }
+    if (oSequence.m_voFrames.size() < 2)
+        CV_Error(cv::Error::StsError, "regression input needs at least two frames: " + sPath);
+    return oSequence;
+}
+
+RegressionVariant getBaselineVariant(const RegressionVariant& oVariant) {
+    RegressionVariant oBaseline;
+    if (oVariant.eCheck == RegressionVariant::Check::Exact)
+        oBaseline.eUpdateMode = oVariant.eUpdateMode;
+    return oBaseline;
+}
+
+std::vector<cv::Mat> runRegressionVariant(const RegressionSequence& oSequence, const RegressionSettings& oSettings, const RegressionVariant& oVariant) {
+    KernelIsaGuard oIsaGuard;
+    if (!lv::setKernelIsa(oVariant.eIsa))
+        CV_Error(cv::Error::StsError, std::string("kernel variant not available: ") + lv::getKernelIsaName(oVariant.eIsa));
+    std::unique_ptr<BackgroundSubtractorViBe> pSubtractor = createSubtractor(oSettings, oVariant);
+    pSubtractor->setRandomSeed(oSettings.nSeed);
+    pSubtractor->setProcessingScale(oVariant.nProcessingScale);
+    pSubtractor->setTileWidth(oVariant.nTileWidth);
+    if (oVariant.nGatingTileSize > 0)
+        pSubtractor->setChangeGating(oVariant.nGatingTileSize, 4, 8);
+    pSubtractor->setSampleReordering(oVariant.bReorderSamples);
+    if (oVariant.nThreads > 0)
+        pSubtractor->initializeParallel(oSequence.frame(0), (int)oVariant.nThreads);
+    else
+        pSubtractor->initialize(oSequence.frame(0));
+    std::vector<cv::Mat> voMasks;
+    CompactMask oCompactMask;
+    cv::Mat oScaledMask;
+    for (size_t t = 1; t < oSequence.count(); ++t) {
+        cv::Mat oMask;
+        if (!oVariant.bCompact) {
+            if (oVariant.nThreads > 0)
+                pSubtractor->applyParallel(oSequence.frame(t), oMask);
+            else
+                pSubtractor->apply(oSequence.frame(t), oMask);
+        }
+        else {
+            if (oVariant.nThreads > 0)
+                pSubtractor->applyParallel(oSequence.frame(t), oCompactMask);
+            else
+                pSubtractor->apply(oSequence.frame(t), oCompactMask);
+            // compact masks are at processing resolution, and are upsampled the same way as the regular ones
+            oCompactMask.unpack(oScaledMask);
+            if (oCompactMask.nScale > 1)
+                cv::resize(oScaledMask, oMask, oSequence.size(), 0, 0, cv::INTER_NEAREST);
+            else
+                oMask = oScaledMask.clone();
+        }
+        voMasks.push_back(oMask);
+    }
+    return voMasks;
+}
+
+RegressionResult compareRegressionMasks(const RegressionVariant& oVariant, const std::vector<cv::Mat>& voBaseline,
+        const std::vector<cv::Mat>& voMasks, double dMinFMeasure) {
+    CV_Assert(voBaseline.size() == voMasks.size());
+    RegressionResult oResult;
+    oResult.sName = oVariant.sName;
+    oResult.eCheck = oVariant.eCheck;
+    size_t nTruePositives = 0, nFalsePositives = 0, nFalseNegatives = 0;
+    for (size_t t = 0; t < voMasks.size(); ++t) {
+        const cv::Mat& oBaseline = voBaseline[t];
+        const cv::Mat& oMask = voMasks[t];
+        CV_Assert(oBaseline.size() == oMask.size() && oBaseline.type() == CV_8UC1 && oMask.type() == CV_8UC1);
+        size_t nMismatches = 0;
+        for (int y = 0; y < oMask.rows; ++y) {
+            const uchar* pBaselineRow = oBaseline.ptr<uchar>(y);
+            const uchar* pMaskRow = oMask.ptr<uchar>(y);
+            for (int x = 0; x < oMask.cols; ++x) {
+                const bool bBaseline = pBaselineRow[x] != 0, bMask = pMaskRow[x] != 0;
+                nTruePositives += bBaseline && bMask;
+                nFalsePositives += !bBaseline && bMask;
+                nFalseNegatives += bBaseline && !bMask;
+                nMismatches += pBaselineRow[x] != pMaskRow[x];
+            }
+        }
+        if (nMismatches > 0 && oResult.nFirstMismatch < 0)
+            oResult.nFirstMismatch = (int)t + 1;
+        oResult.nMismatchedPixels += nMismatches;
+    }
+    const size_t nDenominator = 2 * nTruePositives + nFalsePositives + nFalseNegatives;
+    oResult.dFMeasure = nDenominator > 0 ? (2.0 * nTruePositives) / nDenominator : 1.0;
+    oResult.bPassed = (oVariant.eCheck == RegressionVariant::Check::Exact) ? oResult.nMismatchedPixels == 0 : oResult.dFMeasure >= dMinFMeasure;
+    return oResult;
+}
+
+uint64_t hashMask(const cv::Mat& oMask) {
+    uint64_t nHash = 0xcbf29ce484222325u;
+    const size_t nRowBytes = oMask.cols * oMask.elemSize();
+    for (int y = 0; y < oMask.rows; ++y) {
+        const uchar* pRow = oMask.ptr<uchar>(y);
+        for (size_t x = 0; x < nRowBytes; ++x)
+            nHash = (nHash ^ pRow[x]) * 0x100000001b3u;
+    }
+    return nHash;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "api.hpp"
+#include "vibeKernels.hpp"
+
+/// CV_8UC3 frames replayed by the reference and by every variant; frames are generated or decoded once, up front, so that all runs
+/// see the exact same pixels
+class RegressionSequence {
+public:
+    /// generates a synthetic scene: textured static background, sensor noise, slow illumination drift and a few moving objects
+    /// (deterministic for a given seed; all frames are distinct)
+    static RegressionSequence synthetic(const cv::Size& oSize, size_t nFrames, uint32_t nSeed);
+    /// decodes the first frames of a recording (anything cv::VideoCapture opens, e.g. a video file or an 'img_%04d.png' sequence)
+    static RegressionSequence recorded(const std::string& sPath, size_t nFrames);
+
+    /// returns the size of the frames
+    inline const cv::Size& size() const {return m_oSize;}
+    /// returns the number of frames (the first one initializes the model, the others are segmented)
+    inline size_t count() const {return m_voFrames.size();}
+    inline const cv::Mat& frame(size_t nIdx) const {return m_voFrames[nIdx];}
+    /// returns a short description of the sequence source
+    inline const std::string& source() const {return m_sSource;}
+
+private:
+    cv::Size m_oSize;
+    std::vector<cv::Mat> m_voFrames;
+    std::string m_sSource;
+};
+
+/// parameters shared by the reference run and all the variants
+struct RegressionSettings {
+    uint64_t nSeed{Pcg32::s_nDefaultSeed};
+    size_t nColorDistThreshold{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_COLOR_DIST_THRESHOLD};
+    size_t nSamples{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_NB_BG_SAMPLES};
+    size_t nRequired{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_REQUIRED_NB_BG_SAMPLES};
+    size_t nLearningRate{BackgroundSubtractorViBe::BGSVIBE_DEFAULT_LEARNING_RATE};
+};
+
+/// configuration of the subtractor for one run; the default one is the reference (deterministic update, scalar kernels, serial apply)
+struct RegressionVariant {
+    /// how the masks of a variant are compared to those of its baseline (see getBaselineVariant)
+    enum class Check {
+        /// every mask must be bit-exact w.r.t. the scalar serial run of the same update mode (paths which only change how the same
+        /// computation is scheduled)
+        Exact,
+        /// the foreground F-measure over the whole sequence must reach a minimum (paths which change the random decisions or the samples)
+        FMeasure,
+    };
+
+    std::string sName{"reference"};
+    Check eCheck{Check::Exact};
+    BackgroundSubtractorViBe::UpdateMode eUpdateMode{BackgroundSubtractorViBe::UpdateMode::Reference};
+    SampleModel::Layout eLayout{SampleModel::Layout::Planar};
+    lv::SampleEncoding eEncoding{lv::SampleEncoding::Raw};
+    lv::KernelIsa eIsa{lv::KernelIsa::Scalar};
+    /// worker threads of the parallel paths (0 = serial apply)
+    size_t nThreads{0};
+    int nTileWidth{0};
+    int nGatingTileSize{0};
+    bool bReorderSamples{false};
+    int nProcessingScale{1};
+    /// produces the masks through the compact path (packed bits, unpacked afterwards)
+    bool bCompact{false};
+    /// only run when named by a --variants prefix (for variants known to fall short of the default checks)
+    bool bOptIn{false};
+};
+
+/// outcome of one variant
+struct RegressionResult {
+    std::string sName;
+    RegressionVariant::Check eCheck{RegressionVariant::Check::Exact};
+    /// first segmented frame whose mask differs from the baseline one (-1 if none), and number of differing pixels over all frames
+    int nFirstMismatch{-1};
+    size_t nMismatchedPixels{0};
+    /// foreground F-measure w.r.t. the baseline masks (1 when neither has any foreground)
+    double dFMeasure{1};
+    bool bPassed{false};
+    /// empty unless the variant could not run
+    std::string sError;
+};
+
+/// returns the run the masks of a variant are compared to: the scalar serial run with the same update mode for Exact checks, the
+/// reference for FMeasure ones (baselines only differ by their update mode)
+RegressionVariant getBaselineVariant(const RegressionVariant& oVariant);
+
+/// runs a variant over the whole sequence (the first frame initializes the model) and returns the full-resolution 0/255 mask of each
+/// segmented frame; the kernels in use before the call are restored afterwards
+std::vector<cv::Mat> runRegressionVariant(const RegressionSequence& oSequence, const RegressionSettings& oSettings, const RegressionVariant& oVariant);
+
+/// compares the masks of a variant to those of its baseline, as requested by the variant's check (dMinFMeasure is only used by FMeasure)
+RegressionResult compareRegressionMasks(const RegressionVariant& oVariant, const std::vector<cv::Mat>& voBaseline,
+    const std::vector<cv::Mat>& voMasks, double dMinFMeasure);
+
+/// returns the 64-bit FNV-1a hash of a mask's pixels (row by row, padding excluded)
+uint64_t hashMask(const cv::Mat& oMask);
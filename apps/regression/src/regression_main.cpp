@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "api.hpp"
+#include "AppUtils.hpp"
+#include "vibeKernels.hpp"
+#include "RegressionRunner.hpp"
+
+const char* keys =
+{
+    "{help h | | show help message}"
+    "{input i | | recording replayed instead of the synthetic sequence (video file or image sequence pattern)}"
+    "{size | 320x240 | frame size of the synthetic sequence}"
+    "{frames | 60 | number of frames (the first one initializes the model)}"
+    "{seed | | random seed of the subtractors (default: the library's), also used for the synthetic sequence}"
+    "{mode m | all | checks to run: exact (bit-exact variants), fmeasure (statistical variants) or all}"
+    "{min_f | 0.85 | minimum foreground F-measure of the statistical variants}"
+    "{variants | | comma-separated prefixes of the variant names to run (default: all but encoding:bgr332)}"
+    "{golden | | file holding the per-frame mask hashes of the reference run, checked unless --update_golden is given}"
+    "{update_golden | | (re)writes the golden file from the reference run}"
+    "{threshold | 20 | color distance threshold (R)}"
+    "{samples | 20 | number of samples per pixel (N)}"
+    "{required | 2 | required number of matching samples (#_min)}"
+    "{rate | 10 | learning rate}"
+};
+
+namespace {
+    using UpdateMode = BackgroundSubtractorViBe::UpdateMode;
+    using Check = RegressionVariant::Check;
+
+    /// returns all the variants compared to the reference; the optimized paths run with the kernels picked at startup
+    std::vector<RegressionVariant> makeVariants(lv::KernelIsa eBestIsa) {
+        std::vector<RegressionVariant> voVariants;
+        const auto lAdd = [&](const std::string& sName, Check eCheck) -> RegressionVariant& {
+            RegressionVariant& oVariant = voVariants.emplace_back();
+            oVariant.sName = sName;
+            oVariant.eCheck = eCheck;
+            oVariant.eIsa = eBestIsa;
+            return oVariant;
+        };
+        // the reference update only depends on the seed, the frame & the pixel position, so the scheduling of the work must not matter
+        for (int i = (int)lv::KernelIsa::Scalar + 1; i < (int)lv::KernelIsa::Count; ++i)
+            if (lv::isKernelIsaAvailable((lv::KernelIsa)i))
+                lAdd(std::string("isa:") + lv::getKernelIsaName((lv::KernelIsa)i), Check::Exact).eIsa = (lv::KernelIsa)i;
+        for (size_t nThreads : {1, 2, 4})
+            lAdd("parallel:" + std::to_string(nThreads), Check::Exact).nThreads = nThreads;
+        lAdd("layout:interleaved", Check::Exact).eLayout = SampleModel::Layout::Interleaved;
+        lAdd("tile:32", Check::Exact).nTileWidth = 32;
+        lAdd("tile:auto", Check::Exact).nTileWidth = BackgroundSubtractorViBe::BGSVIBE_AUTO_TILE_WIDTH;
+        lAdd("compact", Check::Exact).bCompact = true;
+        RegressionVariant& oCompactParallel = lAdd("compact:parallel:4", Check::Exact);
+        oCompactParallel.bCompact = true;
+        oCompactParallel.nThreads = 4;
+        // the serial stochastic & table updates draw their decisions in raster order from the classification results, so the kernels, the
+        // layout & the mask format must not change them either (compared to the scalar serial run of the same mode)
+        const std::pair<const char*, UpdateMode> aUpdateModes[] = {{"stochastic", UpdateMode::Stochastic}, {"tables", UpdateMode::RandomTables}};
+        for (const auto& [sMode, eMode] : aUpdateModes) {
+            const std::string sPrefix = std::string("update:") + sMode + ":";
+            for (int i = (int)lv::KernelIsa::Scalar + 1; i < (int)lv::KernelIsa::Count; ++i) {
+                if (!lv::isKernelIsaAvailable((lv::KernelIsa)i))
+                    continue;
+                RegressionVariant& oVariant = lAdd(sPrefix + "isa:" + lv::getKernelIsaName((lv::KernelIsa)i), Check::Exact);
+                oVariant.eIsa = (lv::KernelIsa)i;
+                oVariant.eUpdateMode = eMode;
+            }
+            RegressionVariant& oInterleaved = lAdd(sPrefix + "layout:interleaved", Check::Exact);
+            oInterleaved.eLayout = SampleModel::Layout::Interleaved;
+            oInterleaved.eUpdateMode = eMode;
+            RegressionVariant& oCompact = lAdd(sPrefix + "compact", Check::Exact);
+            oCompact.bCompact = true;
+            oCompact.eUpdateMode = eMode;
+        }
+        // these change which samples get replaced, what is classified or the stored sample values, so only the segmentation quality is compared
+        lAdd("reorder", Check::FMeasure).bReorderSamples = true;
+        lAdd("gating:8", Check::FMeasure).nGatingTileSize = 8;
+        lAdd("encoding:bgr565", Check::FMeasure).eEncoding = lv::SampleEncoding::BGR565;
+        lAdd("encoding:yuv844", Check::FMeasure).eEncoding = lv::SampleEncoding::YUV844;
+        // BGR332's quantization error (up to 49 in L2) is close to the default threshold, so its masks are not expected to reach the
+        // default F-measure (see vibeEncodings.hpp); it is only checked on request, typically along with a larger --threshold
+        RegressionVariant& oBGR332 = lAdd("encoding:bgr332", Check::FMeasure);
+        oBGR332.eEncoding = lv::SampleEncoding::BGR332;
+        oBGR332.bOptIn = true;
+        lAdd("scale:2", Check::FMeasure).nProcessingScale = 2;
+        lAdd("update:stochastic", Check::FMeasure).eUpdateMode = UpdateMode::Stochastic;
+        RegressionVariant& oStochasticParallel = lAdd("update:stochastic:parallel:4", Check::FMeasure);
+        oStochasticParallel.eUpdateMode = UpdateMode::Stochastic;
+        oStochasticParallel.nThreads = 4;
+        RegressionVariant& oStochasticTiled = lAdd("update:stochastic:tile:auto", Check::FMeasure);
+        oStochasticTiled.eUpdateMode = UpdateMode::Stochastic;
+        oStochasticTiled.nTileWidth = BackgroundSubtractorViBe::BGSVIBE_AUTO_TILE_WIDTH;
+        lAdd("update:tables", Check::FMeasure).eUpdateMode = UpdateMode::RandomTables;
+        return voVariants;
+    }
+
+    /// writes the per-frame mask hashes of the reference run
+    bool writeGolden(const std::string& sPath, const std::vector<uint64_t>& vnHashes) {
+        std::ofstream oFile(sPath);
+        for (size_t t = 0; t < vnHashes.size(); ++t)
+            oFile << (t + 1) << ' ' << std::hex << std::setw(16) << std::setfill('0') << vnHashes[t] << std::dec << '\n';
+        return (bool)oFile;
+    }
+
+    /// checks the per-frame mask hashes of the reference run against a golden file; returns an empty string on success
+    std::string checkGolden(const std::string& sPath, const std::vector<uint64_t>& vnHashes) {
+        std::ifstream oFile(sPath);
+        if (!oFile)
+            return "could not open golden file " + sPath;
+        std::vector<uint64_t> vnGolden;
+        size_t nFrameIdx;
+        std::string sHash;
+        while (oFile >> nFrameIdx >> sHash)
+            vnGolden.push_back(std::stoull(sHash, nullptr, 16));
+        if (vnGolden.size() != vnHashes.size())
+            return "golden file holds " + std::to_string(vnGolden.size()) + " frames, the reference run produced " + std::to_string(vnHashes.size());
+        for (size_t t = 0; t < vnHashes.size(); ++t)
+            if (vnGolden[t] != vnHashes[t])
+                return "reference mask of frame " + std::to_string(t + 1) + " differs from the golden one";
+        return std::string();
+    }
+
+    void printResult(std::ostream& os, const RegressionResult& oResult) {
+        os << "  " << std::left << std::setw(40) << oResult.sName << std::right << (oResult.bPassed ? "ok    " : "FAILED");
+        if (!oResult.sError.empty()) {
+            os << " (" << oResult.sError << ")\n";
+            return;
+        }
+        os << "  " << (oResult.eCheck == Check::Exact ? "exact   " : "fmeasure") << "  F=" << std::fixed << std::setprecision(4) << oResult.dFMeasure
+           << "  " << oResult.nMismatchedPixels << " differing pixels";
+        if (oResult.nFirstMismatch >= 0)
+            os << " (first in frame " << oResult.nFirstMismatch << ")";
+        os << "\n";
+    }
+}
+
+static void help(const char** argv)
+{
+    std::cout << "\nThis compares the optimized paths of the ViBe subtractor to its deterministic reference (scalar kernels, serial apply,\n"
+        "per-pixel random streams): scheduling variants must give masks bit-exact with the scalar serial run of their update mode, the others\n"
+        "a minimum foreground F-measure\n"
+        "Usage: \n\t" << argv[0] << " [--input=<video>] [--size=<w>x<h>] [--frames=<n>] [--seed=<n>] [--mode=exact|fmeasure|all] [--min_f=<f>]"
+        " [--variants=<prefix>,...] [--golden=<file> [--update_golden]] [--threshold=<n>] [--samples=<n>] [--required=<n>] [--rate=<n>]\n";
+}
+
+int main(int argc, const char** argv) {
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help"))
+    {
+        help(argv);
+        return 0;
+    }
+
+    RegressionSettings settings;
+    if (parser.has("seed"))
+        settings.nSeed = std::stoull(parser.get<std::string>("seed"), nullptr, 0);
+    settings.nColorDistThreshold = (size_t)std::max(0, parser.get<int>("threshold"));
+    settings.nSamples = (size_t)std::max(1, parser.get<int>("samples"));
+    settings.nRequired = (size_t)std::max(1, parser.get<int>("required"));
+    settings.nLearningRate = (size_t)std::max(1, parser.get<int>("rate"));
+    const size_t frames = (size_t)std::max(2, parser.get<int>("frames"));
+    const std::string mode = parser.get<std::string>("mode");
+    if (mode != "exact" && mode != "fmeasure" && mode != "all")
+    {
+        std::cerr << "***Unknown mode: " << mode << "***\n";
+        return -1;
+    }
+    const double minF = parser.get<double>("min_f");
+    const std::vector<std::string> filters = splitList(parser.get<std::string>("variants"));
+
+    RegressionSequence sequence;
+    try
+    {
+        if (parser.has("input"))
+            sequence = RegressionSequence::recorded(parser.get<std::string>("input"), frames);
+        else
+        {
+            cv::Size size;
+            if (std::sscanf(parser.get<std::string>("size").c_str(), "%dx%d", &size.width, &size.height) != 2 || size.area() <= 0)
+            {
+                std::cerr << "***Invalid synthetic frame size***\n";
+                return -1;
+            }
+            sequence = RegressionSequence::synthetic(size, frames, (uint32_t)settings.nSeed);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "***" << e.what() << "***\n";
+        return -1;
+    }
+
+    const lv::KernelIsa bestIsa = lv::getKernelIsa();
+    std::cout << "Sequence: " << sequence.source() << ", " << sequence.count() << " frames " << sequence.size().width << "x" << sequence.size().height
+              << ", seed 0x" << std::hex << settings.nSeed << std::dec << "\n";
+    std::cout << "Optimized paths use the " << lv::getKernelIsaName(bestIsa) << " kernels\n";
+
+    size_t failures = 0;
+    const std::vector<cv::Mat> reference = runRegressionVariant(sequence, settings, RegressionVariant());
+    if (parser.has("golden"))
+    {
+        const std::string golden = parser.get<std::string>("golden");
+        std::vector<uint64_t> hashes;
+        for (const cv::Mat& mask : reference)
+            hashes.push_back(hashMask(mask));
+        if (parser.has("update_golden"))
+        {
+            if (!writeGolden(golden, hashes))
+            {
+                std::cerr << "***Could not write golden file " << golden << "***\n";
+                return -1;
+            }
+            std::cout << "Golden file written: " << golden << "\n";
+        }
+        else
+        {
+            const std::string error = checkGolden(golden, hashes);
+            std::cout << "Reference vs golden: " << (error.empty() ? "ok" : "FAILED (" + error + ")") << "\n";
+            failures += error.empty() ? 0 : 1;
+        }
+    }
+
+    // baseline masks of the exact checks, per update mode (computed on first use)
+    std::map<UpdateMode, std::vector<cv::Mat>> baselines{{UpdateMode::Reference, reference}};
+    std::cout << "Variants:\n";
+    size_t runs = 0;
+    for (const RegressionVariant& variant : makeVariants(bestIsa))
+    {
+        if ((mode == "exact" && variant.eCheck != Check::Exact) || (mode == "fmeasure" && variant.eCheck != Check::FMeasure))
+            continue;
+        const bool named = std::any_of(filters.begin(), filters.end(), [&](const std::string& filter) {return variant.sName.rfind(filter, 0) == 0;});
+        if ((!filters.empty() || variant.bOptIn) && !named)
+            continue;
+        RegressionResult result;
+        try
+        {
+            const RegressionVariant baseline = getBaselineVariant(variant);
+            auto baselineIter = baselines.find(baseline.eUpdateMode);
+            if (baselineIter == baselines.end())
+                baselineIter = baselines.emplace(baseline.eUpdateMode, runRegressionVariant(sequence, settings, baseline)).first;
+            result = compareRegressionMasks(variant, baselineIter->second, runRegressionVariant(sequence, settings, variant), minF);
+        }
+        catch (const std::exception& e)
+        {
+            result.sName = variant.sName;
+            result.eCheck = variant.eCheck;
+            result.sError = e.what();
+        }
+        printResult(std::cout, result);
+        failures += result.bPassed ? 0 : 1;
+        ++runs;
+    }
+    std::cout << runs << " variants run, " << failures << " failure(s)\n";
+
+    return failures ? 1 : 0;
+}